@@ -20,10 +20,12 @@
 #include <gtk/gtk.h>
 #include <arpa/inet.h>
 
-#include <wdsp.h>             // only needed for GetWDSPVersion
+#include <wdsp.h>             // only needed for GetWDSPVersion and get_impulse_cache_stats
 
+#include "audio.h"
 #include "discovered.h"
 #include "new_menu.h"
+#include "new_protocol.h"
 #include "radio.h"
 #include "version.h"
 
@@ -84,18 +86,48 @@ void about_menu(GtkWidget *parent) {
   gtk_widget_set_name(label, "small_button");
   gtk_grid_attach(GTK_GRID(grid), label, 1, row, 19, 1);
   row++;
+  int cache_entries;
+  long cache_hits, cache_misses;
+  get_impulse_cache_stats(&cache_entries, &cache_hits, &cache_misses);
   snprintf(text, sizeof(text), "Build Version: %s\n"
                                "  (Commit %s, Date: %s)\n"
-                               "  WDSP Version: %d.%02d",
+                               "  WDSP Version: %d.%02d\n"
+                               "  Impulse cache: %d entries, %ld hits, %ld misses",
            build_version,
            build_commit,
            build_date,
-           GetWDSPVersion() / 100, GetWDSPVersion() % 100);
+           GetWDSPVersion() / 100, GetWDSPVersion() % 100,
+           cache_entries, cache_hits, cache_misses);
   label = gtk_label_new(text);
   gtk_widget_set_halign(label, GTK_ALIGN_START);
   gtk_widget_set_name(label, "small_button");
   gtk_grid_attach(GTK_GRID(grid), label, 1, row, 19, 1);
   row++;
+  //
+  // Latency and underrun/overrun counters of the local audio streams
+  //
+  AUDIO_STATS stats;
+  int len = 0;
+
+  for (int i = 0; i < receivers; i++) {
+    if (audio_get_output_stats(receiver[i], &stats) == 0) {
+      len += snprintf(text + len, sizeof(text) - len, "%s  RX%d: latency %.0f msec, %d underruns, %d overruns",
+                      len ? "\n" : "Local Audio:\n", i + 1, stats.latency, stats.underruns, stats.overruns);
+    }
+  }
+
+  if (can_transmit && audio_get_input_stats(transmitter, &stats) == 0) {
+    len += snprintf(text + len, sizeof(text) - len, "%s  Mic: latency %.0f msec, %d underruns, %d overruns",
+                    len ? "\n" : "Local Audio:\n", stats.latency, stats.underruns, stats.overruns);
+  }
+
+  if (len > 0) {
+    label = gtk_label_new(text);
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_widget_set_name(label, "small_button");
+    gtk_grid_attach(GTK_GRID(grid), label, 1, row, 19, 1);
+    row++;
+  }
 
   switch (radio->protocol) {
   case ORIGINAL_PROTOCOL:
@@ -145,6 +177,19 @@ void about_menu(GtkWidget *parent) {
 #endif
   }
 
+  if (radio->protocol == NEW_PROTOCOL && !radio_is_remote) {
+    //
+    // Size and high water mark of the network buffer pool
+    //
+    int num_buf, high_water;
+    new_protocol_buffer_stats(&num_buf, &high_water);
+    len = strlen(text);
+
+    if (len > 0 && text[len - 1] == '\n') { len--; }
+
+    snprintf(text + len, sizeof(text) - len, "\n  Network buffers: %d, high water mark %d", num_buf, high_water);
+  }
+
   label = gtk_label_new(text);
   gtk_widget_set_name(label, "small_button");
   gtk_widget_set_halign(label, GTK_ALIGN_START);
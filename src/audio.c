@@ -41,35 +41,18 @@
 #include "vfo.h"
 
 //
-// Some important parameters
-// Note that we keep the rx audio buffers at half-filling so
-// we can use a larger latency there.
-//
+// The DSP side and the CW side tone latency management are in audio_engine.c.
+// The output is opened in blocking mode with a small ALSA buffer
+// (AUDIO_DEVICE_LATENCY), and a device thread moves the RX audio
+// from the ring buffer to ALSA.
 //
 #define inp_latency  125000
-#define out_latency  200000
-
-//
-// ALSA loopback devices, when connected to digimode programs, sometimes
-// deliver audio in large chungs, so we need a large ring buffer as well
-//
-#define MICRINGLEN 6000
-
-static const int inp_buffer_size = 256;
-static const int out_buffer_size = 256;
-
-static const int out_buflen = 48 * (out_latency / 1000);   // Length of ALSA buffer (200 msec) in samples
-static const int out_maxlen = 44 * (out_latency / 1000);   // High-Water (183 msec) in samples
-
-static const int cw_low_water  =  816;                     // low water mark for CW (17 msec)
-static const int cw_mid_water  =  960;                     // target water mark for CW (20 msec)
-static const int cw_high_water = 1104;                     // high water mark for CW (23 msec)
 
 //
 // TODO: include SND_PCM_FORMAT_IEC958_SUBFRAME_LE, such that ALSA
 //       can directly play on HDMI monitors. Implementation is not
 //       super-easy since this case must then also be considered in
-//       audio_write.
+//       the conversion in rx_audio_thread().
 //
 #define FORMATS 3
 static snd_pcm_format_t formats[4] = {
@@ -80,6 +63,7 @@ static snd_pcm_format_t formats[4] = {
 };
 
 static void *tx_audio_thread(void *arg);
+static void *rx_audio_thread(void *arg);
 
 int n_input_devices;
 int n_output_devices;
@@ -88,7 +72,7 @@ AUDIO_DEVICE input_devices[MAX_AUDIO_DEVICES];
 AUDIO_DEVICE output_devices[MAX_AUDIO_DEVICES];
 
 int audio_open_output(RECEIVER *rx) {
-  unsigned int rate = 48000;
+  unsigned int rate = AUDIO_RATE;
   unsigned int channels = 2;
   int soft_resample = 1;
   char hw[128];
@@ -110,12 +94,13 @@ int audio_open_output(RECEIVER *rx) {
   // such that audio_close_output() can safely be called
   //
   rx->audio_handle = NULL;
-  rx->audio_buffer = NULL;
+  rx->audio_ring = NULL;
+  rx->audio_thread_id = NULL;
 
   for (int i = 0; i < FORMATS; i++) {
     int err;
 
-    if ((err = snd_pcm_open (&rx->audio_handle, hw, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK)) < 0) {
+    if ((err = snd_pcm_open (&rx->audio_handle, hw, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
       t_print("%s: cannot open audio device %s (%s)\n", __FUNCTION__,
               hw,
               snd_strerror (err));
@@ -123,7 +108,7 @@ int audio_open_output(RECEIVER *rx) {
     }
 
     if ((err = snd_pcm_set_params (rx->audio_handle, formats[i], SND_PCM_ACCESS_RW_INTERLEAVED, channels, rate,
-                                   soft_resample, out_latency)) < 0) {
+                                   soft_resample, 1000 * AUDIO_DEVICE_LATENCY)) < 0) {
       t_print("%s: could not set params for %s\n", __FUNCTION__, snd_pcm_format_name(formats[i]));
       snd_pcm_close(rx->audio_handle);
       continue;
@@ -142,42 +127,30 @@ int audio_open_output(RECEIVER *rx) {
     return -1;
   }
 
-  rx->audio_buffer_offset = 0;
-
-  switch (rx->audio_format) {
-  case SND_PCM_FORMAT_S16_LE:
-    rx->audio_buffer = g_new(int16_t, 2 * out_buffer_size);
-    break;
-
-  case SND_PCM_FORMAT_S32_LE:
-    rx->audio_buffer = g_new(int32_t, 2 * out_buffer_size);
-    break;
-
-  case SND_PCM_FORMAT_FLOAT_LE:
-    rx->audio_buffer = g_new(float, 2 * out_buffer_size);
-    break;
-
-  default:
-    t_print("%s: unknown sound format\n", __FUNCTION__);
-    rx->audio_buffer = NULL;
-    break;
-  }
+  rx->audio_ring = audio_ring_new(AUDIO_OUT_RING_SIZE, 2, 1);
+  rx->cwaudio = 0;
+  rx->cwcount = 0;
+  rx->audio_running = TRUE;
+  GError *error;
+  rx->audio_thread_id = g_thread_try_new("RxAudioOut", rx_audio_thread, rx, &error);
 
-  if (rx->audio_buffer == NULL) {
+  if (!rx->audio_thread_id) {
+    t_print("%s: g_thread_new failed on RxAudioOut: %s\n", __FUNCTION__, error->message);
+    rx->audio_running = FALSE;
     snd_pcm_close(rx->audio_handle);
     rx->audio_handle = NULL;
+    audio_ring_free(rx->audio_ring);
+    rx->audio_ring = NULL;
     g_mutex_unlock(&rx->audio_mutex);
     return -1;
   }
 
-  rx->cwaudio = 0;
-  rx->cwcount = 0;
   g_mutex_unlock(&rx->audio_mutex);
   return 0;
 }
 
 int audio_open_input(TRANSMITTER *tx) {
-  unsigned int rate = 48000;
+  unsigned int rate = AUDIO_RATE;
   unsigned int channels = 1;
   int soft_resample = 1;
   char hw[128];
@@ -198,7 +171,7 @@ int audio_open_input(TRANSMITTER *tx) {
   // variables are NULL such that audio_close_input() can safely
   // be called.
   //
-  tx->audio_buffer = NULL;
+  tx->audio_ring = NULL;
   tx->audio_thread_id = NULL;
   tx->audio_handle = NULL;
   g_mutex_lock(&tx->audio_mutex);
@@ -236,16 +209,7 @@ int audio_open_input(TRANSMITTER *tx) {
 
   t_print("%s: format=%d\n", __FUNCTION__, tx->audio_format);
   t_print("%s: allocating ring buffer\n", __FUNCTION__);
-  tx->audio_buffer = (float *) g_new(float, MICRINGLEN);
-  tx->audio_buffer_outpt = tx->audio_buffer_inpt = 0;
-
-  if (tx->audio_buffer == NULL) {
-    snd_pcm_close(tx->audio_handle);
-    tx->audio_handle = NULL;
-    g_mutex_unlock(&tx->audio_mutex);
-    return -1;
-  }
-
+  tx->audio_ring = audio_ring_new(AUDIO_MIC_RING_SIZE, 1, 0);
   GError *error;
   tx->audio_thread_id = g_thread_try_new("TxAudioIn", tx_audio_thread, tx, &error);
 
@@ -253,8 +217,8 @@ int audio_open_input(TRANSMITTER *tx) {
     t_print("%s: g_thread_new failed on TxAudioIn: %s\n", __FUNCTION__, error->message);
     snd_pcm_close(tx->audio_handle);
     tx->audio_handle = NULL;
-    g_free(tx->audio_buffer);
-    tx->audio_buffer = NULL;
+    audio_ring_free(tx->audio_ring);
+    tx->audio_ring = NULL;
     g_mutex_unlock(&tx->audio_mutex);
     return -1;
   }
@@ -265,16 +229,26 @@ int audio_open_input(TRANSMITTER *tx) {
 
 void audio_close_output(RECEIVER *rx) {
   t_print("%s: RX%d:%s\n", __FUNCTION__, rx->id + 1, rx->audio_name);
+  rx->audio_running = FALSE;
   g_mutex_lock(&rx->audio_mutex);
 
+  if (rx->audio_thread_id != NULL) {
+    //
+    // wait for the device thread to terminate, then destroy
+    // the ring buffer, such that it cannot vanish in that thread
+    //
+    g_thread_join(rx->audio_thread_id);
+    rx->audio_thread_id = NULL;
+  }
+
   if (rx->audio_handle != NULL) {
     snd_pcm_close (rx->audio_handle);
     rx->audio_handle = NULL;
   }
 
-  if (rx->audio_buffer != NULL) {
-    g_free(rx->audio_buffer);
-    rx->audio_buffer = NULL;
+  if (rx->audio_ring != NULL) {
+    audio_ring_free(rx->audio_ring);
+    rx->audio_ring = NULL;
   }
 
   g_mutex_unlock(&rx->audio_mutex);
@@ -295,300 +269,77 @@ void audio_close_input(TRANSMITTER *tx) {
     tx->audio_handle = NULL;
   }
 
-  if (tx->audio_buffer != NULL) {
-    g_free(tx->audio_buffer);
+  if (tx->audio_ring != NULL) {
+    audio_ring_free(tx->audio_ring);
+    tx->audio_ring = NULL;
   }
 
   g_mutex_unlock(&tx->audio_mutex);
 }
 
 //
-// tx_audio_write() is called from the transmitter thread
-// when transmitting and not doing duplex.
-// Its main use is the CW side tone, so to minimize
-// sidetone latency, hold the ALSA buffer
-// at low filling, between cw_low_water and cw_high_water.
-//
-// Note that when sending the buffer, delay "jumps" by the buffer size
+// RX audio device thread: move blocks from the ring buffer to ALSA.
+// Since the device is opened in blocking mode, snd_pcm_writei() paces
+// this thread. If the ring buffer runs empty, silence is sent.
 //
-
-int tx_audio_write(RECEIVER *rx, float sample) {
-  snd_pcm_sframes_t delay;
-  g_mutex_lock(&rx->audio_mutex);
-
-  if (rx->audio_handle != NULL && rx->audio_buffer != NULL) {
-    if (rx->cwaudio == 0) {
-      //
-      // This happens when we come here for the first time after a
-      // RX/TX transision. Rewind output buffer, that is, discard
-      // the most recent output samples.
-      // In principle, we should apply a fade-out on the samples
-      // still remaining in the output buffer. In the portaudio
-      // module this is easy because we do the buffering and
-      // use callbacks to actually deliver the audio data.
-      // Callbacks with ALSA are not considered "Safe" so
-      // we use snd_pcm_writei() and (AFAIK) after that we
-      // cannot modify the audio samples already sent.
-      //
-      // Bottom line: this snd_pcm_rewind() most likely leads
-      // to a small audio crack upon each RX/TX transition, since
-      // the pending RX audio samples come to a sudden end
-      // without any down-slew.
-      //
-      if (snd_pcm_delay(rx->audio_handle, &delay) == 0) {
-        snd_pcm_rewind(rx->audio_handle, delay - cw_mid_water);
-      }
-
-      rx->cwcount = 0;
-      rx->cwaudio = 1;
+static void *rx_audio_thread(gpointer arg) {
+  RECEIVER *rx = (RECEIVER *)arg;
+  float buffer[2 * AUDIO_BLOCK];
+  int16_t short_buffer[2 * AUDIO_BLOCK];
+  int32_t long_buffer[2 * AUDIO_BLOCK];
+
+  while (rx->audio_running) {
+    const void *data;
+    snd_pcm_sframes_t delay;
+    snd_pcm_sframes_t rc;
+
+    if (snd_pcm_delay(rx->audio_handle, &delay) == 0) {
+      audio_ring_set_delay(rx->audio_ring, delay);
     }
 
-    int adjust = 1;
-
-    if (sample != 0.0) { rx->cwcount = 0; } // count upwards during silence
-
-    if (++rx->cwcount >= 16) {
-      rx->cwcount = 0;
-
-      //
-      // We have just seen 16 zero samples, so this is the right place
-      // to adjust the buffer filling.
-      // If buffer gets too full   ==> skip the sample
-      // If buffer gets too empty ==> insert zero sample
-      //
-
-      if (snd_pcm_delay(rx->audio_handle, &delay) == 0) {
-        if (delay > cw_high_water) { adjust = 0; }  // above high-water
+    audio_ring_read(rx->audio_ring, buffer, AUDIO_BLOCK);
 
-        if (delay < cw_low_water)  { adjust = 2; }  // below low-water
+    switch (rx->audio_format) {
+    case SND_PCM_FORMAT_S16_LE:
+      for (int i = 0; i < 2 * AUDIO_BLOCK; i++) {
+        short_buffer[i] = (int16_t) (buffer[i] * 32767.0F);
       }
-    }
 
-    //
-    // adjust == 1: put sample into buffer (default case)
-    // adjust == 2: put sample into buffer twice (if space permits)
-    // adjust == 0: skip sample
-    //
-    if (adjust) {
-      //
-      // default case: put sample into buffer and that's it
-      //
-      switch (rx->audio_format) {
-      case SND_PCM_FORMAT_S16_LE: {
-        int16_t *short_buffer = (int16_t *)rx->audio_buffer;
-        int16_t shortsample = (int16_t) (sample * 32767.0F);
-        short_buffer[rx->audio_buffer_offset * 2] = shortsample;
-        short_buffer[(rx->audio_buffer_offset * 2) + 1] = shortsample;
-        rx->audio_buffer_offset++;
-
-        if (adjust == 2 && rx->audio_buffer_offset <  out_buffer_size) {
-          short_buffer[rx->audio_buffer_offset * 2] = shortsample;
-          short_buffer[(rx->audio_buffer_offset * 2) + 1] = shortsample;
-          rx->audio_buffer_offset++;
-        }
-      }
+      data = short_buffer;
       break;
 
-      case SND_PCM_FORMAT_S32_LE: {
-        int32_t *long_buffer = (int32_t *)rx->audio_buffer;
-        int32_t longsample = (int32_t)(sample *  2147483647.0F);
-        long_buffer[rx->audio_buffer_offset * 2] = longsample;
-        long_buffer[(rx->audio_buffer_offset * 2) + 1] = longsample;
-        rx->audio_buffer_offset++;
-
-        if (adjust == 2 && rx->audio_buffer_offset <  out_buffer_size) {
-          long_buffer[rx->audio_buffer_offset * 2] = longsample;
-          long_buffer[(rx->audio_buffer_offset * 2) + 1] = longsample;
-          rx->audio_buffer_offset++;
-        }
+    case SND_PCM_FORMAT_S32_LE:
+      for (int i = 0; i < 2 * AUDIO_BLOCK; i++) {
+        long_buffer[i] = (int32_t) (buffer[i] * 2147483647.0F);
       }
-      break;
 
-      case SND_PCM_FORMAT_FLOAT_LE: {
-        float *float_buffer = (float *)rx->audio_buffer;
-        float_buffer[rx->audio_buffer_offset * 2] = sample;
-        float_buffer[(rx->audio_buffer_offset * 2) + 1] =  sample;
-        rx->audio_buffer_offset++;
-
-        if (adjust == 2 && rx->audio_buffer_offset <  out_buffer_size) {
-          float_buffer[rx->audio_buffer_offset * 2] = sample;
-          float_buffer[(rx->audio_buffer_offset * 2) + 1] = sample;
-          rx->audio_buffer_offset++;
-        }
-      }
+      data = long_buffer;
       break;
 
-      default:
-        t_print("%s: CATASTROPHIC ERROR: unknown sound format\n", __FUNCTION__);
-        break;
-      }
-    }
-
-    if (rx->audio_buffer_offset >= out_buffer_size) {
-      long rc;
-
-      if ((rc = snd_pcm_writei (rx->audio_handle, rx->audio_buffer, out_buffer_size)) != out_buffer_size) {
-        if (rc < 0) {
-          switch (rc) {
-          case -EPIPE:
-            if ((rc = snd_pcm_prepare (rx->audio_handle)) < 0) {
-              t_print("%s: cannot prepare audio interface for use %ld (%s)\n", __FUNCTION__, rc, snd_strerror (rc));
-              rx->audio_buffer_offset = 0;
-              g_mutex_unlock(&rx->audio_mutex);
-              return rc;
-            }
-
-            break;
-
-          default:
-            t_print("%s:  write error: %s\n", __FUNCTION__, snd_strerror(rc));
-            break;
-          }
-        } else {
-          t_print("%s: short write lost=%d\n", __FUNCTION__, out_buffer_size - (int) rc);
-        }
-      }
-
-      rx->audio_buffer_offset = 0;
-    }
-  }
-
-  g_mutex_unlock(&rx->audio_mutex);
-  return 0;
-}
-
-//
-// if rx == active_receiver and while transmitting, DO NOTHING
-// since tx_audio_write may be active
-//
-
-int audio_write(RECEIVER *rx, float left_sample, float right_sample) {
-  snd_pcm_sframes_t delay;
-
-  //
-  // When transmitting while not doing duplex, quickly return
-  //
-  if (rx == active_receiver && radio_is_transmitting() && !duplex) { return 0; }
-
-  // lock AFTER checking the "quick return" condition but BEFORE checking the pointers
-  g_mutex_lock(&rx->audio_mutex);
-
-  if (rx->audio_handle != NULL && rx->audio_buffer != NULL) {
-    switch (rx->audio_format) {
-    case SND_PCM_FORMAT_S16_LE: {
-      int16_t *short_buffer = (int16_t *)rx->audio_buffer;
-      short_buffer[rx->audio_buffer_offset * 2] = (int16_t)(left_sample * 32767.0F);
-      short_buffer[(rx->audio_buffer_offset * 2) + 1] = (int16_t)(right_sample * 32767.0F);
-    }
-    break;
-
-    case SND_PCM_FORMAT_S32_LE: {
-      int32_t *long_buffer = (int32_t *)rx->audio_buffer;
-      long_buffer[rx->audio_buffer_offset * 2] = (int32_t)(left_sample * 4294967295.0F);
-      long_buffer[(rx->audio_buffer_offset * 2) + 1] = (int32_t)(right_sample * 4294967295.0F);
-    }
-    break;
-
-    case SND_PCM_FORMAT_FLOAT_LE: {
-      float *float_buffer = (float *)rx->audio_buffer;
-      float_buffer[rx->audio_buffer_offset * 2] = left_sample;
-      float_buffer[(rx->audio_buffer_offset * 2) + 1] = right_sample;
-    }
-    break;
-
+    case SND_PCM_FORMAT_FLOAT_LE:
     default:
-      t_print("%s: CATASTROPHIC ERROR: unknown sound format\n", __FUNCTION__);
+      data = buffer;
       break;
     }
 
-    rx->audio_buffer_offset++;
-
-    if (rx->audio_buffer_offset >= out_buffer_size) {
-      snd_pcm_sframes_t rc;
-
-      if (snd_pcm_delay(rx->audio_handle, &delay) != 0) {
-        delay = 0;
-      }
-
-      if (rx->cwaudio == 1 || delay < 512) {
-        //
-        // This happens when we come here for the first time, or after a
-        // TX/RX transision. We have to fill the output buffer (otherwise
-        // sound will not resume) and can then rewind to half-filling.
-        // (We may also arrive here if the output buffer is nearly drained)
-        //
-        //
-        void *silence = NULL;
-        size_t len;
-        int num = (out_buflen - delay);
-
-        switch (rx->audio_format) {
-        case SND_PCM_FORMAT_S16_LE:
-          silence = g_new(int16_t, 2 * num);
-          len = 2 * num * sizeof(int16_t);
-          break;
-
-        case SND_PCM_FORMAT_S32_LE:
-          silence = g_new(int32_t, 2 * num);
-          len = 2 * num * sizeof(int32_t);
-          break;
-
-        case SND_PCM_FORMAT_FLOAT_LE:
-          silence = g_new(float, 2 * num);
-          len = 2 * num * sizeof(float);
-          break;
-
-        default:
-          t_print("%s: CATASTROPHIC ERROR: unknown sound format\n", __FUNCTION__);
-          silence = NULL;
-          len = 0;
-          break;
-        }
-
-        if (silence) {
-          memset(silence, 0, len);
-          snd_pcm_writei (rx->audio_handle, silence, num);
-          snd_pcm_rewind (rx->audio_handle, out_buflen / 2);
-          delay = out_buflen / 2;
-          g_free(silence);
+    if ((rc = snd_pcm_writei (rx->audio_handle, data, AUDIO_BLOCK)) != AUDIO_BLOCK) {
+      if (rc < 0) {
+        if (rc == -EPIPE) {
+          audio_ring_underrun(rx->audio_ring);
         }
 
-        rx->cwaudio = 0;
-      }
-
-      if (delay > out_maxlen) {
-        // output buffer is filling up, rewind until it is half filled
-        snd_pcm_rewind(rx->audio_handle, out_buflen / 2);
-      }
-
-      if ((rc = snd_pcm_writei (rx->audio_handle, rx->audio_buffer, out_buffer_size)) != out_buffer_size) {
-        if (rc < 0) {
-          switch (rc) {
-          case -EPIPE:
-            if ((rc = snd_pcm_prepare (rx->audio_handle)) < 0) {
-              t_print("%s: cannot prepare audio interface for use %ld (%s)\n", __FUNCTION__, rc, snd_strerror (rc));
-              rx->audio_buffer_offset = 0;
-              g_mutex_unlock(&rx->audio_mutex);
-              return rc;
-            }
-
-            break;
-
-          default:
-            t_print("%s:  write error: %s\n", __FUNCTION__, snd_strerror(rc));
-            break;
-          }
-        } else {
-          t_print("%s: short write lost=%d\n", __FUNCTION__, out_buffer_size - (int) rc);
+        if ((rc = snd_pcm_recover (rx->audio_handle, rc, 1)) < 0) {
+          t_print("%s: cannot recover audio interface %ld (%s)\n", __FUNCTION__, rc, snd_strerror (rc));
+          break;
         }
+      } else {
+        t_print("%s: short write lost=%d\n", __FUNCTION__, AUDIO_BLOCK - (int) rc);
       }
-
-      rx->audio_buffer_offset = 0;
     }
   }
 
-  g_mutex_unlock(&rx->audio_mutex);
-  return 0;
+  t_print("%s: exiting\n", __FUNCTION__);
+  return NULL;
 }
 
 static void *tx_audio_thread(gpointer arg) {
@@ -604,7 +355,7 @@ static void *tx_audio_thread(gpointer arg) {
   //
   // Allocate buffer such that it fits for all
   //
-  void *buffer = malloc(inp_buffer_size * sizeof(float));
+  void *buffer = malloc(AUDIO_BLOCK * sizeof(float));
 
   if (!buffer) {
     t_print("%s: unknown sound format or malloc error\n");
@@ -614,10 +365,13 @@ static void *tx_audio_thread(gpointer arg) {
   const int16_t *short_buffer =  (int16_t *) buffer;
   const int32_t *long_buffer =  (int32_t *) buffer;
   const float *float_buffer =  (float *) buffer;
+  float samples[AUDIO_BLOCK];
   tx->audio_running = TRUE;
 
   while (tx->audio_running) {
-    if ((rc = snd_pcm_readi (tx->audio_handle, buffer, inp_buffer_size)) != inp_buffer_size) {
+    snd_pcm_sframes_t delay;
+
+    if ((rc = snd_pcm_readi (tx->audio_handle, buffer, AUDIO_BLOCK)) != AUDIO_BLOCK) {
       if (tx->audio_running) {
         if (rc < 0) {
           t_print("%s: read from audio interface failed (%s)\n", __FUNCTION__,
@@ -628,58 +382,36 @@ static void *tx_audio_thread(gpointer arg) {
       }
     } else {
       // process the mic input
-      for (int i = 0; i < inp_buffer_size; i++) {
-        float sample;
-
+      for (int i = 0; i < AUDIO_BLOCK; i++) {
         switch (tx->audio_format) {
         case SND_PCM_FORMAT_S16_LE:
-          sample = (float)short_buffer[i] / 32767.0f;
+          samples[i] = (float)short_buffer[i] / 32767.0f;
           break;
 
         case SND_PCM_FORMAT_S32_LE:
-          sample = (float)long_buffer[i] / 4294967295.0f;
+          samples[i] = (float)long_buffer[i] / 4294967295.0f;
           break;
 
         case SND_PCM_FORMAT_FLOAT_LE:
-          sample = float_buffer[i];
+          samples[i] = float_buffer[i];
           break;
 
         default:
-          sample = 0.0;
+          samples[i] = 0.0;
           break;
         }
+      }
 
-        //
-        // If we are a client, simply collect and transfer data
-        // to the server without any buffering
-        //
-        if (radio_is_remote) {
-          short s = sample * 32767.0;
-          server_tx_audio(s);
-          continue;
-        }
-
-        //
-        // put sample into ring buffer
-        // Note check on the mic ring buffer is not necessary
-        // since audio_close_input() waits for this thread to
-        // complete.
-        //
-        if (tx->audio_buffer != NULL) {
-          // do not increase tx->audio_buffer_inpt *here* since it must
-          // assume an illegal value at any time
-          int newpt = tx->audio_buffer_inpt + 1;
-
-          if (newpt == MICRINGLEN) { newpt = 0; }
-
-          if (newpt != tx->audio_buffer_outpt) {
-            // buffer space available, do the write
-            tx->audio_buffer[tx->audio_buffer_inpt] = sample;
-            // atomic update of tx->audio_buffer_outpt
-            tx->audio_buffer_inpt = newpt;
-          }
-        }
+      if (snd_pcm_delay(tx->audio_handle, &delay) == 0) {
+        audio_ring_set_delay(tx->audio_ring, delay);
       }
+
+      //
+      // Note check on the mic ring buffer is not necessary
+      // since audio_close_input() waits for this thread to
+      // complete.
+      //
+      audio_mic_put(tx, samples, AUDIO_BLOCK);
     }
   }
 
@@ -688,31 +420,6 @@ static void *tx_audio_thread(gpointer arg) {
   return NULL;
 }
 
-//
-// Utility function for retrieving mic samples
-// from ring buffer
-//
-float audio_get_next_mic_sample(TRANSMITTER *tx) {
-  float sample;
-  g_mutex_lock(&tx->audio_mutex);
-
-  if ((tx->audio_buffer == NULL) || (tx->audio_buffer_inpt == tx->audio_buffer_outpt)) {
-    // no buffer, or nothing in buffer: insert silence
-    sample = 0.0;
-  } else {
-    int newpt = tx->audio_buffer_outpt + 1;
-
-    if (newpt == MICRINGLEN) { newpt = 0; }
-
-    sample = tx->audio_buffer[tx->audio_buffer_outpt];
-    // atomic update of read pointer
-    tx->audio_buffer_outpt = newpt;
-  }
-
-  g_mutex_unlock(&tx->audio_mutex);
-  return sample;
-}
-
 void audio_get_cards() {
   snd_ctl_card_info_t *info;
   snd_pcm_info_t *pcminfo;
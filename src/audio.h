@@ -20,6 +20,7 @@
 #ifndef _AUDIO_H_
 #define _AUDIO_H_
 
+#include "audio_engine.h"
 #include "receiver.h"
 #include "transmitter.h"
 
@@ -40,8 +41,16 @@ extern int audio_open_input(TRANSMITTER *tx);
 extern void audio_close_input(TRANSMITTER *tx);
 extern int audio_open_output(RECEIVER *rx);
 extern void audio_close_output(RECEIVER *rx);
+extern void audio_get_cards(void);
+
+//
+// Backend-independent functions (audio_engine.c)
+//
 extern int audio_write(RECEIVER *rx, float left_sample, float right_sample);
+extern void audio_write_block(RECEIVER *rx, const float *samples, int n);
 extern int tx_audio_write(RECEIVER *rx, float sample);
-extern void audio_get_cards(void);
+extern void audio_mic_put(TRANSMITTER *tx, const float *samples, int n);
 float  audio_get_next_mic_sample(TRANSMITTER *tx);
+extern int audio_get_output_stats(RECEIVER *rx, AUDIO_STATS *stats);
+extern int audio_get_input_stats(TRANSMITTER *tx, AUDIO_STATS *stats);
 #endif
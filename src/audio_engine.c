@@ -0,0 +1,557 @@
+/* Copyright (C)
+* 2025 - Christoph van Wüllen, DL1YCF
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+//
+// Audio engine: the part of the audio modules that does not depend
+// on the backend (ALSA, PortAudio, PulseAudio).
+//
+// This contains the SPSC ring buffers, the RX audio path with drift
+// compensation, the CW side tone latency management, the mic sample
+// path and the latency/underrun/overrun telemetry.
+//
+// The backends only open/close the devices, and run a device thread
+// or device callback that calls audio_ring_read() (output) or
+// audio_mic_put() (input). The producer and consumer of a ring only
+// communicate through the atomically updated read and write pointers,
+// and through the rmatch object (which has its own short lock).
+// The audio mutexes only protect the rings from being destroyed while
+// the DSP side uses them. Before destroying a ring, the backends stop
+// the device thread or callback.
+//
+
+#include <gtk/gtk.h>
+#include <string.h>
+#include <wdsp.h>   // only needed for rmatch
+
+#include "audio.h"
+#include "audio_engine.h"
+#include "client_server.h"
+#include "message.h"
+#include "radio.h"
+#include "receiver.h"
+#include "transmitter.h"
+
+//
+// Drift compensation of RX audio:
+// The clocks of the radio and the sound card are never exactly the same, so
+// a plain ring buffer would slowly drain or fill up. The RX audio is therefore
+// passed through a WDSP rmatch object. The DSP side puts blocks of AUDIO_BLOCK
+// frames into it with xrmatchIN(), the device side takes blocks out with
+// xrmatchOUT(), and rmatch continuously adjusts its variable-ratio resampler
+// to keep its ring half-filled (AUDIO_OUT_TARGET frames).
+//
+// When no RX audio arrives (e.g. when transmitting without duplex), rmatch
+// must not be read any further: every read without input would enter its
+// ratio estimate and drive the ratio away. Therefore, upon an underflow
+// (rmatch slews to silence) the consumer stops reading rmatch, and the
+// producer re-creates it, with the ratio reached so far, when RX audio
+// arrives again.
+//
+AUDIO_RING *audio_ring_new(int size, int channels, int drift_control) {
+  AUDIO_RING *ring = g_new0(AUDIO_RING, 1);
+  ring->buf = g_new0(float, size * channels);
+  ring->channels = channels;
+  ring->size = size;
+
+  //
+  // drift control is only used for (stereo) RX audio output
+  //
+  if (drift_control) {
+    ring->rmatch = create_rmatchV(AUDIO_BLOCK, AUDIO_BLOCK, AUDIO_RATE, AUDIO_RATE, 2 * AUDIO_OUT_TARGET, 1.0);
+    ring->block = g_new0(double, 2 * AUDIO_BLOCK);
+    ring->rblock = g_new0(double, 2 * AUDIO_BLOCK);
+    ring->rblock_pos = AUDIO_BLOCK;
+  }
+
+  return ring;
+}
+
+void audio_ring_free(AUDIO_RING *ring) {
+  if (ring == NULL) { return; }
+
+  if (ring->rmatch != NULL) {
+    destroy_rmatchV(ring->rmatch);
+  }
+
+  g_free(ring->rblock);
+  g_free(ring->block);
+  g_free(ring->buf);
+  g_free(ring);
+}
+
+int audio_ring_fill(AUDIO_RING *ring) {
+  int fill = g_atomic_int_get(&ring->inpt) - g_atomic_int_get(&ring->outpt);
+
+  if (fill < 0) { fill += ring->size; }
+
+  return fill;
+}
+
+//
+// Producer: put frames into the ring. If there is not enough space,
+// the excess frames are dropped and an overrun is counted.
+//
+int audio_ring_write(AUDIO_RING *ring, const float *data, int frames) {
+  int ch = ring->channels;
+  int inpt = ring->inpt;
+  int space = ring->size - 1 - audio_ring_fill(ring);
+
+  if (frames > space) {
+    g_atomic_int_inc(&ring->overruns);
+    frames = space;
+  }
+
+  int first = ring->size - inpt;
+
+  if (first > frames) { first = frames; }
+
+  memcpy(ring->buf + ch * inpt, data, ch * first * sizeof(float));
+  memcpy(ring->buf, data + ch * first, ch * (frames - first) * sizeof(float));
+  inpt += frames;
+
+  if (inpt >= ring->size) { inpt -= ring->size; }
+
+  // the atomic update makes the data visible to the consumer
+  g_atomic_int_set(&ring->inpt, inpt);
+  return frames;
+}
+
+//
+// Producer: put silence into the ring
+//
+static void audio_ring_silence(AUDIO_RING *ring, int frames) {
+  float zero[2 * AUDIO_BLOCK];
+  int chunk = (2 * AUDIO_BLOCK) / ring->channels;
+  memset(zero, 0, sizeof(zero));
+
+  while (frames > 0) {
+    int n = frames > chunk ? chunk : frames;
+    audio_ring_write(ring, zero, n);
+    frames -= n;
+  }
+}
+
+//
+// Consumer: execute a flush requested by the producer, that is,
+// drop the frames written before the flush request.
+//
+static void audio_ring_do_flush(AUDIO_RING *ring) {
+  int flush_at = g_atomic_int_get(&ring->flush_at);
+  int n = flush_at - ring->outpt;
+
+  if (n < 0) { n += ring->size; }
+
+  // if we have already read beyond the flush point, there is nothing to do
+  if (n <= audio_ring_fill(ring)) {
+    g_atomic_int_set(&ring->outpt, flush_at);
+  }
+
+  g_atomic_int_set(&ring->flush, 0);
+}
+
+//
+// Consumer: take frames from the ring buffer. If there are not enough
+// frames, the remainder is filled with silence. An underrun is
+// counted only if the previous read was complete, so a stream that
+// is not (yet) fed does not count.
+//
+static void audio_ring_get(AUDIO_RING *ring, float *data, int frames) {
+  int ch = ring->channels;
+
+  if (g_atomic_int_get(&ring->flush)) {
+    audio_ring_do_flush(ring);
+  }
+
+  int outpt = ring->outpt;
+  int n = audio_ring_fill(ring);
+
+  if (n > frames) { n = frames; }
+
+  int first = ring->size - outpt;
+
+  if (first > n) { first = n; }
+
+  memcpy(data, ring->buf + ch * outpt, ch * first * sizeof(float));
+  memcpy(data + ch * first, ring->buf, ch * (n - first) * sizeof(float));
+  memset(data + ch * n, 0, ch * (frames - n) * sizeof(float));
+  outpt += n;
+
+  if (outpt >= ring->size) { outpt -= ring->size; }
+
+  g_atomic_int_set(&ring->outpt, outpt);
+
+  if (n < frames && ring->last_ok) {
+    g_atomic_int_inc(&ring->underruns);
+  }
+
+  ring->last_ok = (n == frames);
+}
+
+//
+// Consumer: fetch the next block from the rmatch object, or silence if it
+// is idle. The (first) underflow makes it idle. It is counted as an underrun
+// only if the previous block was complete, and if RX audio is expected, that
+// is, neither while transmitting without duplex nor while the side tone is
+// played.
+//
+static void audio_rmatch_get(AUDIO_RING *ring) {
+  int underflows, overflows, ringsize, nring;
+  double var;
+  ring->rblock_pos = 0;
+
+  if (g_atomic_int_get(&ring->rm_idle)) {
+    memset(ring->rblock, 0, 2 * AUDIO_BLOCK * sizeof(double));
+    return;
+  }
+
+  xrmatchOUT(ring->rmatch, ring->rblock);
+  getRMatchDiags(ring->rmatch, &underflows, &overflows, &var, &ringsize, &nring);
+  g_atomic_int_set(&ring->rm_overflows, overflows);
+
+  if (underflows > 0) {
+    if (ring->rm_last_ok && !ring->cw_active && (!radio_is_transmitting() || duplex)) {
+      g_atomic_int_inc(&ring->underruns);
+    }
+
+    ring->rm_last_ok = 0;
+    g_atomic_int_set(&ring->rm_fill, 0);
+    g_atomic_int_set(&ring->rm_idle, 1);
+  } else {
+    ring->rm_last_ok = 1;
+    g_atomic_int_set(&ring->rm_fill, nring);
+  }
+}
+
+//
+// Producer: re-create an idle rmatch object (see above). The consumer does
+// not access it while rm_idle is set. The new one starts with the ratio
+// reached so far, and with its ring half-filled with silence.
+//
+static void audio_rmatch_restart(AUDIO_RING *ring) {
+  int underflows, overflows, ringsize, nring;
+  double var;
+  getRMatchDiags(ring->rmatch, &underflows, &overflows, &var, &ringsize, &nring);
+  destroy_rmatchV(ring->rmatch);
+  ring->rmatch = create_rmatchV(AUDIO_BLOCK, AUDIO_BLOCK, AUDIO_RATE, AUDIO_RATE, ringsize, var);
+  g_atomic_int_set(&ring->rm_overflows, 0);
+  g_atomic_int_add(&ring->overruns, overflows);
+  g_atomic_int_set(&ring->rm_idle, 0);
+}
+
+//
+// Consumer: take frames from the ring.
+//
+// The RX audio of a drift-controlled ring comes from the rmatch object.
+// While the CW side tone is produced, it is taken from the ring buffer
+// instead. At this transition, the rest of the current RX block is faded
+// out and played first. The rmatch object continues to be read at the
+// normal pace (and its output is discarded) until it runs empty and
+// becomes idle, such that no stale RX audio is played after the TX/RX
+// transition.
+//
+void audio_ring_read(AUDIO_RING *ring, float *data, int frames) {
+  if (ring->rmatch == NULL) {
+    audio_ring_get(ring, data, frames);
+    return;
+  }
+
+  int cw = g_atomic_int_get(&ring->cw);
+
+  if (cw && !ring->cw_active) {
+    int n = AUDIO_BLOCK - ring->rblock_pos;
+    double *p = ring->rblock + 2 * ring->rblock_pos;
+
+    for (int i = 0; i < n; i++) {
+      double damp = (double)(n - i) / (double) (n + 1);
+      p[2 * i] *= damp;
+      p[2 * i + 1] *= damp;
+    }
+
+    ring->tail = n;
+  }
+
+  g_atomic_int_set(&ring->cw_active, cw);
+
+  while (frames > 0) {
+    if (ring->rblock_pos >= AUDIO_BLOCK) { audio_rmatch_get(ring); }
+
+    int n = AUDIO_BLOCK - ring->rblock_pos;
+
+    if (n > frames) { n = frames; }
+
+    if (cw && ring->tail == 0) {
+      audio_ring_get(ring, data, n);
+    } else {
+      const double *p = ring->rblock + 2 * ring->rblock_pos;
+
+      if (cw) {
+        if (n > ring->tail) { n = ring->tail; }
+
+        ring->tail -= n;
+      }
+
+      for (int i = 0; i < 2 * n; i++) {
+        data[i] = p[i];
+      }
+    }
+
+    ring->rblock_pos += n;
+    data += 2 * n;
+    frames -= n;
+  }
+}
+
+//
+// Consumer: drop the oldest frames such that at most keep frames remain
+//
+void audio_ring_trim(AUDIO_RING *ring, int keep) {
+  int fill = audio_ring_fill(ring);
+
+  if (fill > keep) {
+    int outpt = ring->outpt + fill - keep;
+
+    if (outpt >= ring->size) { outpt -= ring->size; }
+
+    g_atomic_int_set(&ring->outpt, outpt);
+  }
+}
+
+//
+// Producer: request a flush (see audio_ring_do_flush)
+//
+void audio_ring_flush(AUDIO_RING *ring) {
+  g_atomic_int_set(&ring->flush_at, ring->inpt);
+  g_atomic_int_set(&ring->flush, 1);
+}
+
+//
+// Backend: report frames buffered in the device, and device underruns
+//
+void audio_ring_set_delay(AUDIO_RING *ring, int frames) {
+  g_atomic_int_set(&ring->device_delay, frames);
+}
+
+void audio_ring_underrun(AUDIO_RING *ring) {
+  g_atomic_int_inc(&ring->underruns);
+}
+
+void audio_ring_stats(AUDIO_RING *ring, AUDIO_STATS *stats) {
+  if (ring->rmatch != NULL && !g_atomic_int_get(&ring->cw_active)) {
+    stats->fill = g_atomic_int_get(&ring->rm_fill);
+  } else {
+    stats->fill = audio_ring_fill(ring);
+  }
+
+  stats->device_delay = g_atomic_int_get(&ring->device_delay);
+  stats->latency = 1000.0 * (stats->fill + stats->device_delay) / AUDIO_RATE;
+  stats->underruns = g_atomic_int_get(&ring->underruns);
+  stats->overruns = g_atomic_int_get(&ring->overruns) + g_atomic_int_get(&ring->rm_overflows);
+}
+
+//
+// RX audio from the DSP (n stereo frames)
+//
+void audio_write_block(RECEIVER *rx, const float *samples, int n) {
+  //
+  // If transmitting without duplex, quickly return
+  //
+  if (rx == active_receiver && radio_is_transmitting() && !duplex) { return; }
+
+  // lock AFTER checking the "quick return" condition but BEFORE checking the ring
+  g_mutex_lock(&rx->audio_mutex);
+  AUDIO_RING *ring = rx->audio_ring;
+
+  if (ring != NULL) {
+    //
+    // After a TX/RX transition in CW, make the consumer switch
+    // back from the side tone to the rmatch object
+    //
+    if (rx->cwaudio) {
+      rx->cwaudio = 0;
+      g_atomic_int_set(&ring->cw, 0);
+    }
+
+    for (int i = 0; i < n; i++) {
+      ring->block[2 * ring->block_fill] = samples[2 * i];
+      ring->block[2 * ring->block_fill + 1] = samples[2 * i + 1];
+
+      if (++ring->block_fill >= AUDIO_BLOCK) {
+        if (g_atomic_int_get(&ring->rm_idle)) { audio_rmatch_restart(ring); }
+
+        xrmatchIN(ring->rmatch, ring->block);
+        ring->block_fill = 0;
+      }
+    }
+  }
+
+  g_mutex_unlock(&rx->audio_mutex);
+}
+
+int audio_write(RECEIVER *rx, float left_sample, float right_sample) {
+  const float samples[2] = { left_sample, right_sample };
+  audio_write_block(rx, samples, 1);
+  return 0;
+}
+
+//
+// tx_audio_write() is called from the transmitter thread
+// when transmitting and not doing duplex.
+// Its main use is the CW side tone. It bypasses the rmatch
+// object and goes into the ring buffer, and to minimize
+// side tone latency, the ring filling is kept between
+// AUDIO_CW_LOW_WATER and AUDIO_CW_HIGH_WATER. This is
+// done by inserting or skipping a zero sample when
+// 16 zero samples in a row have been seen.
+//
+int tx_audio_write(RECEIVER *rx, float sample) {
+  g_mutex_lock(&rx->audio_mutex);
+  AUDIO_RING *ring = rx->audio_ring;
+
+  if (ring != NULL) {
+    int fill = audio_ring_fill(ring);
+    int count = 1;
+
+    if (rx->cwaudio == 0) {
+      //
+      // First time producing CW audio after RX/TX transition:
+      // drop what is left of the previous side tone, start with
+      // AUDIO_CW_LOW_WATER frames of silence, and make the consumer
+      // switch from the rmatch object to the ring buffer.
+      //
+      audio_ring_flush(ring);
+      audio_ring_silence(ring, AUDIO_CW_LOW_WATER);
+      ring->block_fill = 0;
+      rx->cwcount = 0;
+      rx->cwaudio = 1;
+      g_atomic_int_set(&ring->cw, 1);
+    }
+
+    if (sample != 0.0) { rx->cwcount = 0; }
+
+    //
+    // While a flush is pending, the ring filling is not meaningful
+    //
+    if (++rx->cwcount >= 16 && !g_atomic_int_get(&ring->flush)) {
+      rx->cwcount = 0;
+
+      if (fill > AUDIO_CW_HIGH_WATER) { count = 0; } // above high water: skip sample
+
+      if (fill < AUDIO_CW_LOW_WATER)  { count = 2; } // below low water: insert sample
+    }
+
+    //
+    // since the side tone is mono put it into both
+    // the left and right channel with the same phase.
+    //
+    const float frames[4] = { sample, sample, sample, sample };
+    audio_ring_write(ring, frames, count);
+  }
+
+  g_mutex_unlock(&rx->audio_mutex);
+  return 0;
+}
+
+//
+// Mic samples from the device thread or callback
+//
+void audio_mic_put(TRANSMITTER *tx, const float *samples, int n) {
+  //
+  // If we are a client, simply collect and transfer data
+  // to the server without any buffering
+  //
+  if (radio_is_remote) {
+    for (int i = 0; i < n; i++) {
+      server_tx_audio((short) (samples[i] * 32767.0));
+    }
+
+    return;
+  }
+
+  //
+  // No mutex: audio_close_input() stops the device thread or
+  // callback before the ring is destroyed
+  //
+  if (tx->audio_ring != NULL) {
+    audio_ring_write(tx->audio_ring, samples, n);
+  }
+}
+
+//
+// Utility function for retrieving mic samples
+// from ring buffer
+//
+float audio_get_next_mic_sample(TRANSMITTER *tx) {
+  float sample = 0.0;
+  g_mutex_lock(&tx->audio_mutex);
+  AUDIO_RING *ring = tx->audio_ring;
+
+  if (ring != NULL) {
+    //
+    // Normally there is a slight mis-match between the 48kHz sample
+    // rate of the audio input device and the 48kHz rate of the
+    // HPSDR device. Thus, the mic ring tends to either slowly
+    // drain or slowly become full (which leads to large TX delays).
+    //
+    // The TX/RX transition is the best moment to reduce the
+    // filling to AUDIO_MIC_TARGET. During RX, one cannot fiddle around
+    // with the mic samples any further since VOX might be active.
+    //
+    if (!radio_is_transmitting()) {
+      if (tx->audio_flag) {
+        tx->audio_flag = 0;
+        audio_ring_trim(ring, AUDIO_MIC_TARGET);
+      }
+    } else {
+      tx->audio_flag = 1;
+    }
+
+    audio_ring_read(ring, &sample, 1);
+  }
+
+  g_mutex_unlock(&tx->audio_mutex);
+  return sample;
+}
+
+//
+// Telemetry. These return -1 if the stream is not open.
+//
+int audio_get_output_stats(RECEIVER *rx, AUDIO_STATS *stats) {
+  int rc = -1;
+  g_mutex_lock(&rx->audio_mutex);
+
+  if (rx->audio_ring != NULL) {
+    audio_ring_stats(rx->audio_ring, stats);
+    rc = 0;
+  }
+
+  g_mutex_unlock(&rx->audio_mutex);
+  return rc;
+}
+
+int audio_get_input_stats(TRANSMITTER *tx, AUDIO_STATS *stats) {
+  int rc = -1;
+  g_mutex_lock(&tx->audio_mutex);
+
+  if (tx->audio_ring != NULL) {
+    audio_ring_stats(tx->audio_ring, stats);
+    rc = 0;
+  }
+
+  g_mutex_unlock(&tx->audio_mutex);
+  return rc;
+}
@@ -0,0 +1,111 @@
+/* Copyright (C)
+* 2025 - Christoph van Wüllen, DL1YCF
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef _AUDIO_ENGINE_H_
+#define _AUDIO_ENGINE_H_
+
+//
+// Backend-independent part of the audio modules (audio.c, portaudio.c, pulseaudio.c).
+//
+// Each audio stream (RX audio output, mic input) has one single-producer
+// single-consumer ring buffer. The DSP threads are the producers of RX audio
+// and the consumers of mic samples, while each backend runs a device thread
+// or device callback at the other end of the ring.
+//
+// RX audio output additionally passes through a WDSP rmatch object, which
+// compensates the clock drift between the radio and the sound card. The
+// ring buffer of an RX audio output stream then only carries the CW side tone.
+//
+// All latency-relevant parameters are collected here (sizes in frames, 48 kHz):
+//
+// AUDIO_BLOCK              block size for the DSP side and the device threads
+// AUDIO_DEVICE_LATENCY     buffering (msec) requested from the audio backend
+// AUDIO_OUT_RING_SIZE      size of the CW side tone ring of an RX audio output stream
+// AUDIO_OUT_TARGET         RX: filling of the rmatch ring (half of its size)
+// AUDIO_CW_LOW_WATER       TX: CW side tone ring filling is kept between the low and
+// AUDIO_CW_HIGH_WATER          high water mark (this determines the side tone latency)
+// AUDIO_MIC_RING_SIZE      size of the mic ring
+// AUDIO_MIC_TARGET         mic ring filling is reduced to this upon each TX/RX transition
+//                          (this determines the mic-to-RF latency)
+//
+#define AUDIO_RATE              48000
+#define AUDIO_BLOCK               256
+#define AUDIO_DEVICE_LATENCY       20
+#define AUDIO_OUT_RING_SIZE      2400
+#define AUDIO_OUT_TARGET         2400
+#define AUDIO_CW_LOW_WATER        192
+#define AUDIO_CW_HIGH_WATER       320
+#define AUDIO_MIC_RING_SIZE      6000
+#define AUDIO_MIC_TARGET          960
+
+typedef struct _audio_ring {
+  float *buf;              // interleaved samples
+  int channels;
+  int size;                // ring size in frames
+  int inpt;                // written by the producer only
+  int outpt;               // written by the consumer only
+  //
+  // A "flush" is requested by the producer and executed by the consumer:
+  // the data written before flush_at is dropped.
+  //
+  int flush;
+  int flush_at;
+  //
+  // RX audio output rings: drift compensation with a WDSP rmatch object
+  //
+  void *rmatch;
+  int cw;                  // set by the producer while it produces CW side tone
+  double *block;           // producer-side: collects one block for xrmatchIN()
+  int block_fill;
+  double *rblock;          // consumer-side: last block from xrmatchOUT()
+  int rblock_pos;          // consumer-side: frames of rblock already consumed
+  int tail;                // consumer-side: faded RX frames to play before the side tone
+  int cw_active;           // consumer-side: reading the side tone
+  int rm_idle;             // rmatch has underflowed: not read until re-created by the producer
+  int rm_last_ok;          // consumer-side: last rmatch block was complete
+  int rm_fill;             // frames in the rmatch ring
+  int rm_overflows;
+  //
+  // Telemetry
+  //
+  int last_ok;             // consumer-side: last read from the ring buffer was complete
+  int device_delay;        // frames buffered in the device, reported by the backend
+  int underruns;
+  int overruns;
+} AUDIO_RING;
+
+typedef struct _audio_stats {
+  int fill;                // frames in ring buffer
+  int device_delay;        // frames in the device
+  double latency;          // total latency (msec)
+  int underruns;
+  int overruns;
+} AUDIO_STATS;
+
+extern AUDIO_RING *audio_ring_new(int size, int channels, int drift_control);
+extern void audio_ring_free(AUDIO_RING *ring);
+extern int audio_ring_fill(AUDIO_RING *ring);
+extern int audio_ring_write(AUDIO_RING *ring, const float *data, int frames);
+extern void audio_ring_read(AUDIO_RING *ring, float *data, int frames);
+extern void audio_ring_trim(AUDIO_RING *ring, int keep);
+extern void audio_ring_flush(AUDIO_RING *ring);
+extern void audio_ring_set_delay(AUDIO_RING *ring, int frames);
+extern void audio_ring_underrun(AUDIO_RING *ring);
+extern void audio_ring_stats(AUDIO_RING *ring, AUDIO_STATS *stats);
+
+#endif
@@ -633,7 +633,7 @@ static void *client_tcp_thread(void* arg) {
     g_mutex_init(&rx->audio_mutex);
     rx->id = i;
     rx->pixel_samples = NULL;
-    rx->audio_buffer = NULL;
+    rx->audio_ring = NULL;
     rx->display_panadapter = 1;
     rx->display_waterfall = 1;
     rx->panadapter_high = -40;
@@ -649,6 +649,7 @@ static void *client_tcp_thread(void* arg) {
     rx->waterfall_low = -140;
     rx->waterfall_automatic = 1;
     rx->waterfall_percent = 25;
+    rx->waterfall_palette = WF_PALETTE_STANDARD;
     rx->display_filled = 1;
     rx->display_gradient = 1;
     rx->local_audio = 0;
@@ -678,6 +679,7 @@ static void *client_tcp_thread(void* arg) {
   transmitter->dialog = NULL;
   transmitter->local_audio = 0;
   transmitter->audio_flag = 0;
+  transmitter->audio_ring = NULL;
   g_mutex_init(&transmitter->audio_mutex);
   snprintf(transmitter->audio_name, sizeof(transmitter->audio_name), "%s", "NO AUDIO");
 
@@ -228,6 +228,10 @@ static void waterfall_automatic_cb(GtkWidget *widget, gpointer data) {
   myrx->waterfall_automatic = val;
 }
 
+static void waterfall_palette_cb(GtkWidget *widget, gpointer data) {
+  myrx->waterfall_palette = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+}
+
 static void display_waterfall_cb(GtkWidget *widget, gpointer data) {
   myrx->display_waterfall = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
   radio_reconfigure();
@@ -486,6 +490,19 @@ void display_menu(GtkWidget *parent) {
   gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (b_display_waterfall), myrx->display_waterfall);
   gtk_grid_attach(GTK_GRID(general_grid), b_display_waterfall, col + 1, row, 1, 1);
   g_signal_connect(b_display_waterfall, "toggled", G_CALLBACK(display_waterfall_cb), NULL);
+  row++;
+  label = gtk_label_new("Waterfall Colors");
+  gtk_widget_set_name (label, "boldlabel");
+  gtk_widget_set_halign(label, GTK_ALIGN_END);
+  gtk_grid_attach(GTK_GRID(general_grid), label, col, row, 1, 1);
+  GtkWidget *palette_combo = gtk_combo_box_text_new();
+  gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(palette_combo), NULL, "Standard");
+  gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(palette_combo), NULL, "Gray");
+  gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(palette_combo), NULL, "Hot");
+  gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(palette_combo), NULL, "Blue");
+  gtk_combo_box_set_active(GTK_COMBO_BOX(palette_combo), myrx->waterfall_palette);
+  my_combo_attach(GTK_GRID(general_grid), palette_combo, col + 1, row, 1, 1);
+  g_signal_connect(palette_combo, "changed", G_CALLBACK(waterfall_palette_cb), NULL);
   //
   // Peaks container and controls therein
   //
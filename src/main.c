@@ -17,16 +17,25 @@
 *
 */
 #include <gtk/gtk.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <locale.h>
 #include <math.h>
+#include <spawn.h>
+#include <sys/file.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <sys/resource.h>
 #include <sys/utsname.h>
+#ifdef __APPLE__
+  #include <sys/sysctl.h>
+#endif
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include <wdsp.h>    // only needed for WDSPwisdom() and wisdom_get_status()
+#include <wdsp.h>    // only needed for WDSPwisdom(), wisdom_get_status() and the impulse cache
 
 #include "actions.h"
 #include "appearance.h"
@@ -86,9 +95,142 @@ void status_text(const char *text) {
 static pthread_t wisdom_thread_id;
 static int wisdom_running = 0;
 
+//
+// Computed filter impulse responses are cached by WDSP. The cache is
+// stored in the same directory as the wisdom file, so filter and mode
+// changes need not re-compute them in the next session.
+//
+static char impulse_cache_file[1100] = "";
+
+void main_save_impulse_cache() {
+  int entries;
+  long hits, misses;
+
+  if (*impulse_cache_file == 0) { return; }
+
+  get_impulse_cache_stats(&entries, &hits, &misses);
+  t_print("%s: %d entries, %ld hits, %ld misses\n", __FUNCTION__, entries, hits, misses);
+
+  if (save_impulse_cache(impulse_cache_file) != 0) {
+    t_print("%s: could not write %s\n", __FUNCTION__, impulse_cache_file);
+  }
+}
+
+//
+// FFTW wisdom is obtained in tiers (see WDSPwisdom_quick()):
+// the local wisdom file, a shared wisdom file for this CPU model,
+// or a quick FFTW_MEASURE pass. In the latter case, a low-priority
+// background process ("piHPSDR -Wisdom <dir> <shared file>") builds
+// the PATIENT wisdom file, which is then used from the next start on.
+// The shared directory is $PIHPSDR_WISDOM_DIR or /usr/local/share/pihpsdr.
+//
+extern char **environ;
+
+static char self_path[PATH_MAX] = "";
+static char wisdom_shared_file[1100] = "";
+
+static void wisdom_cpu_model(char *model, size_t len) {
+  char line[256];
+  snprintf(model, len, "%s", unameData.machine);
+#ifdef __APPLE__
+  size_t size = sizeof(line);
+
+  if (sysctlbyname("machdep.cpu.brand_string", line, &size, NULL, 0) == 0) {
+    snprintf(model, len, "%s-%s", unameData.machine, line);
+  }
+
+#else
+  FILE *fp = fopen("/proc/cpuinfo", "r");
+
+  if (fp != NULL) {
+    while (fgets(line, sizeof(line), fp)) {
+      //
+      // x86 reports "model name", Raspberry Pis report "Model"
+      //
+      if (!strncmp(line, "model name", 10) || !strncmp(line, "Model", 5)) {
+        const char *cp = strchr(line, ':');
+
+        if (cp != NULL) {
+          snprintf(model, len, "%s-%s", unameData.machine, cp + 1);
+          break;
+        }
+      }
+    }
+
+    fclose(fp);
+  }
+
+#endif
+
+  //
+  // make the model string usable as part of a file name
+  //
+  for (char *cp = model; *cp; cp++) {
+    if (!isalnum((unsigned char) *cp) && *cp != '-') { *cp = '_'; }
+  }
+}
+
+//
+// GLib reaps the background process (so it does not remain a zombie)
+// and calls this in the main loop when it terminates.
+//
+static void wisdom_refinement_done(GPid pid, gint status, gpointer data) {
+  if (WIFEXITED(status)) {
+    t_print("%s: background wisdom process %d exited with status %d\n", __FUNCTION__, (int) pid, WEXITSTATUS(status));
+  } else if (WIFSIGNALED(status)) {
+    t_print("%s: background wisdom process %d killed by signal %d\n", __FUNCTION__, (int) pid, WTERMSIG(status));
+  }
+
+  g_spawn_close_pid(pid);
+}
+
+static void wisdom_start_refinement(char *directory) {
+  pid_t pid;
+  char *args[5];
+  args[0] = *self_path ? self_path : "pihpsdr";
+  args[1] = "-Wisdom";
+  args[2] = directory;
+  args[3] = wisdom_shared_file;
+  args[4] = NULL;
+
+  if (posix_spawnp(&pid, args[0], NULL, NULL, args, environ) == 0) {
+    t_print("%s: building PATIENT wisdom in background process %d\n", __FUNCTION__, pid);
+    g_child_watch_add(pid, wisdom_refinement_done, NULL);
+  } else {
+    t_print("%s: could not start background wisdom process\n", __FUNCTION__);
+  }
+}
+
+//
+// Body of the background process. Only one such process may run at a
+// time, this is guaranteed by a lock on a file in the wisdom directory.
+//
+static int wisdom_refine(char *directory, char *shared) {
+  char lock_file[1100];
+  snprintf(lock_file, sizeof(lock_file), "%swdspWisdom00.lock", directory);
+  int fd = open(lock_file, O_CREAT | O_RDWR, 0644);
+
+  if (fd < 0 || flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    return 0;
+  }
+
+  setpriority(PRIO_PROCESS, 0, 19);
+
+  if (WDSPwisdom(directory) && *shared) {
+    //
+    // This fails silently if the shared directory is not writeable
+    //
+    WDSPwisdom_export(shared);
+  }
+
+  close(fd);
+  return 0;
+}
+
 static void* wisdom_thread(void *arg) {
-  if (WDSPwisdom ((char *)arg)) {
-    t_print("%s: WDSP wisdom file has been rebuilt.\n", __FUNCTION__);
+  if (WDSPwisdom_quick ((char *)arg, *wisdom_shared_file ? wisdom_shared_file : NULL)) {
+    t_print("%s: Quick WDSP wisdom planned.\n", __FUNCTION__);
+    wisdom_start_refinement((char *)arg);
   } else {
     t_print("%s: Re-using existing WDSP wisdom file.\n", __FUNCTION__);
   }
@@ -129,6 +271,12 @@ static int init(void *data) {
   (void) getcwd(text, sizeof(text));
   snprintf(wisdom_directory, sizeof(wisdom_directory), "%s/", text);
   t_print("%s: Securing wisdom file in directory: %s\n", __FUNCTION__, wisdom_directory);
+  const char *shared_dir = getenv("PIHPSDR_WISDOM_DIR");
+  char cpu_model[256];
+  wisdom_cpu_model(cpu_model, sizeof(cpu_model));
+  snprintf(wisdom_shared_file, sizeof(wisdom_shared_file), "%s/wdspWisdom00-%s",
+           shared_dir ? shared_dir : "/usr/local/share/pihpsdr", cpu_model);
+  t_print("%s: Shared wisdom file for this CPU: %s\n", __FUNCTION__, wisdom_shared_file);
   status_text("Checking FFTW Wisdom file ...");
   wisdom_running = 1;
   pthread_create(&wisdom_thread_id, NULL, wisdom_thread, wisdom_directory);
@@ -147,6 +295,22 @@ static int init(void *data) {
     status_text(text);
   }
 
+  //
+  // Load the impulse cache. A missing, outdated or corrupt file
+  // simply leaves the cache empty.
+  //
+  init_impulse_cache(1);
+  snprintf(impulse_cache_file, sizeof(impulse_cache_file), "%swdspImpulseCache", wisdom_directory);
+
+  if (read_impulse_cache(impulse_cache_file) == 0) {
+    int entries;
+    long hits, misses;
+    get_impulse_cache_stats(&entries, &hits, &misses);
+    t_print("%s: impulse cache loaded, %d entries\n", __FUNCTION__, entries);
+  } else {
+    t_print("%s: no valid impulse cache in %s\n", __FUNCTION__, impulse_cache_file);
+  }
+
   //
   // When widsom plans are complete, start discovery process
   //
@@ -299,6 +463,22 @@ int main(int argc, char **argv) {
     exit(0);
   }
 
+  //
+  // If invoked with -Wisdom, build the PATIENT wisdom file and exit
+  // (this is the background process started by wisdom_start_refinement)
+  //
+  if (argc >= 4 && !strcmp("-Wisdom", argv[1])) {
+    return wisdom_refine(argv[2], argv[3]);
+  }
+
+  //
+  // Remember our own path for starting the background wisdom process
+  // (startup() may change the working directory)
+  //
+  if (realpath(argv[0], self_path) == NULL) {
+    snprintf(self_path, sizeof(self_path), "%s", argv[0]);
+  }
+
   //
   // If invoked with -TestMenu, then set a flag for using the test menu
   // (debug and program development only)
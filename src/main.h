@@ -35,4 +35,5 @@ extern void status_text(const char *text);
 
 extern gulong keypress_signal_id;
 extern int fatal_error(void *data);
+extern void main_save_impulse_cache(void);
 #endif
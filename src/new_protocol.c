@@ -17,6 +17,9 @@
 *
 */
 
+#ifdef __linux__
+  #define _GNU_SOURCE    // for recvmmsg()
+#endif
 #include <gtk/gtk.h>
 
 #include <errno.h>
@@ -200,26 +203,38 @@ static pthread_mutex_t send_rxaudio_mutex   = PTHREAD_MUTEX_INITIALIZER;
 ////////////////////////////////////////////////////////////////////////////
 //
 // Instead of allocating and free-ing (malloc/free) the network buffers
-// at a very high rate, we do it the "pedestrian" way, which may
-// alleviate the system load a little.
+// at a very high rate, we allocate a pool of network buffers *once*
+// and make them a linked list (via "next").
+//
+// The free buffers are additionally kept on a lock-free stack (linked via
+// "next_free"). Buffers are only taken from this stack in new_protocol_thread(),
+// but they are returned from the iq, mic, and high-priority threads.
+// Since there is only a single thread popping from the stack, the
+// simple compare-and-swap scheme is safe against the ABA problem.
 //
-// Therefore we allocate a pool of network buffers *once*, make
-// them a linked list, and simply maintain a "free" flag.
+// The "free" flag is still maintained. It is used by the consumers to
+// detect buffers that have been reclaimed upon a protocol restart, and
+// the atomic transition of this flag from 0 to 1 decides who returns a
+// buffer to the free stack. This also avoids returning a buffer twice.
 //
-// This ONLY applies to the network buffers filled with data in
-// new_protocol_thread(), so this need not be thread-safe.
+// With the SATURN XDMA interface, the buffers come from saturnmain.c
+// which maintains its own pool, and only the "free" flag is set.
 //
 ////////////////////////////////////////////////////////////////////////////
 
 //
-// number of buffers allocated (for statistics)
+// number of buffers allocated, and the maximum number
+// of buffers simultaneously in use (for statistics)
 //
 static int num_buf = 0;
+static int buf_in_use = 0;
+static int buf_high_water = 0;
 
 //
-// head of buffer list
+// head of buffer list, and top of the free stack
 //
 static mybuffer *buflist = NULL;
+static mybuffer *free_stack = NULL;
 
 //
 // The buffers used by new_protocol_thread
@@ -276,47 +291,82 @@ static void process_div_iq_data(const unsigned char *buffer);
 static void  process_high_priority(void);
 static void  process_mic_data(const unsigned char *buffer);
 
+static void push_my_buffer(mybuffer *bp) {
+  mybuffer *top = __atomic_load_n(&free_stack, __ATOMIC_RELAXED);
+
+  do {
+    bp->next_free = top;
+  } while (!__atomic_compare_exchange_n(&free_stack, &top, bp, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+//
+// Return a buffer to the pool. This may be called from any thread.
+//
+static void release_my_buffer(volatile mybuffer *mybuf) {
+  if (have_saturn_xdma) {
+    mybuf->free = 1;
+    return;
+  }
+
+  if (__atomic_exchange_n(&mybuf->free, 1, __ATOMIC_ACQ_REL) == 0) {
+    __atomic_fetch_sub(&buf_in_use, 1, __ATOMIC_RELAXED);
+    push_my_buffer((mybuffer *) mybuf);
+  }
+}
+
 //
 // Obtain a free buffer. If no one is available allocate
-// 5 new ones. The buffers are *never* released to the
+// 25 new ones. The buffers are *never* released to the
 // operating system, but marked free upon a protocol restart.
+// This must only be called from new_protocol_thread().
 //
 static mybuffer *get_my_buffer() {
   ASSERT_SERVER(NULL);
-  int i;
-  mybuffer *bp = buflist;
-
-  while (bp) {
-    if (bp->free) {
-      // found free buffer. Mark as used and return that one.
-      bp->free = 0;
-      return bp;
-    }
+  mybuffer *bp = __atomic_load_n(&free_stack, __ATOMIC_ACQUIRE);
 
-    bp = bp->next;
+  while (bp && !__atomic_compare_exchange_n(&free_stack, &bp, bp->next_free, 1, __ATOMIC_ACQUIRE,
+         __ATOMIC_ACQUIRE)) {
   }
 
-  //
-  // no free buffer found, allocate some extra ones
-  // and add to the head of the list
-  //
-  for (i = 0; i < 25; i++) {
-    bp = malloc(sizeof(mybuffer));
+  if (!bp) {
+    //
+    // no free buffer found, allocate some extra ones,
+    // add them to the head of the list and to the free stack
+    // (except the last one which is returned)
+    //
+    for (int i = 0; i < 25; i++) {
+      bp = malloc(sizeof(mybuffer));
+
+      if (!bp) {
+        fatal_error("FATAL: P2: out of memory");
+        return NULL;
+      }
 
-    if (!bp) {
-      fatal_error("FATAL: P2: out of memory");
-    } else {
-      bp->free = 1;
       bp->next = buflist;
       buflist = bp;
       num_buf++;
+
+      if (i < 24) {
+        bp->free = 1;
+        push_my_buffer(bp);
+      }
     }
+
+    t_print("NewProtocol: number of buffers increased to %d\n", num_buf);
   }
 
-  t_print("NewProtocol: number of buffers increased to %d\n", num_buf);
-  // Mark the first buffer in list as used and return that one.
-  buflist->free = 0;
-  return buflist;
+  // Mark buffer as used and return that one.
+  __atomic_store_n(&bp->free, 0, __ATOMIC_RELAXED);
+  int in_use = __atomic_add_fetch(&buf_in_use, 1, __ATOMIC_RELAXED);
+
+  if (in_use > buf_high_water) { buf_high_water = in_use; }
+
+  return bp;
+}
+
+void new_protocol_buffer_stats(int *size, int *high_water) {
+  *size = num_buf;
+  *high_water = buf_high_water;
 }
 
 void schedule_high_priority() {
@@ -1698,6 +1748,7 @@ void new_protocol_menu_stop() {
     }
 
     free(buffer);
+    t_print("%s: network buffer pool size=%d high water mark=%d\n", __FUNCTION__, num_buf, buf_high_water);
   }
 }
 
@@ -1732,7 +1783,7 @@ void new_protocol_menu_start() {
     mybuffer *mybuf = buflist;
 
     while (mybuf) {
-      mybuf->free = 1;
+      release_my_buffer(mybuf);
       mybuf = mybuf->next;
     }
   }
@@ -1761,10 +1812,96 @@ void new_protocol_menu_start() {
   new_protocol_timer_thread_id = g_thread_new( "P2 task", new_protocol_timer_thread, NULL);
 }
 
+//
+// Max. number of TX IQ or audio packets sent with a single sendmmsg() call.
+// If sendmmsg() is not available (ENOSYS), fall back to sendto() for good.
+//
+#define P2_SEND_BATCH 8
+#ifdef __linux__
+  static int p2_use_sendmmsg = 1;
+#endif
+
+static int new_protocol_send(const unsigned char *buffer, int len, int n, const struct sockaddr_in *to,
+                             socklen_t tolen) {
+  //
+  // Send n packets of length len, stored contiguously in buffer.
+  // Return the number of packets sent, or -1 upon error.
+  //
+  int i = 0;
+#ifdef __linux__
+
+  if (p2_use_sendmmsg && n > 1) {
+    struct mmsghdr msgs[P2_SEND_BATCH];
+    struct iovec iovecs[P2_SEND_BATCH];
+    int rc;
+    memset(msgs, 0, sizeof(msgs));
+
+    for (int j = 0; j < n; j++) {
+      iovecs[j].iov_base = (void *) &buffer[j * len];
+      iovecs[j].iov_len = len;
+      msgs[j].msg_hdr.msg_iov = &iovecs[j];
+      msgs[j].msg_hdr.msg_iovlen = 1;
+      msgs[j].msg_hdr.msg_name = (void *) to;
+      msgs[j].msg_hdr.msg_namelen = tolen;
+    }
+
+    rc = sendmmsg(data_socket, msgs, n, 0);
+
+    if (rc >= 0 || errno != ENOSYS) {
+      return rc;
+    }
+
+    t_print("%s: sendmmsg not available, using sendto\n", __FUNCTION__);
+    p2_use_sendmmsg = 0;
+  }
+
+#endif
+
+  for (; i < n; i++) {
+    int rc = sendto(data_socket, &buffer[i * len], len, 0, (const struct sockaddr *)to, tolen);
+
+    if (rc < 0) { return -1; }
+
+    if (rc != len) { break; }
+  }
+
+  return i;
+}
+
+static void rxaudio_fill_packet(unsigned char *audiobuffer) {
+  int nptr = rxaudio_outptr + 256;
+
+  if (nptr >= RXAUDIORINGBUFLEN) { nptr = 0; }
+
+  audiobuffer[0] = (audio_sequence >> 24) & 0xFF;
+  audiobuffer[1] = (audio_sequence >> 16) & 0xFF;
+  audiobuffer[2] = (audio_sequence >>  8) & 0xFF;
+  audiobuffer[3] = (audio_sequence      ) & 0xFF;
+  audio_sequence++;
+  memcpy(&audiobuffer[4], &RXAUDIORINGBUF[rxaudio_outptr], 256);
+  MEMORY_BARRIER;
+  rxaudio_outptr = nptr;
+}
+
+static void txiq_fill_packet(unsigned char *iqbuffer) {
+  int nptr = txiq_outptr + 1440;
+
+  if (nptr >= TXIQRINGBUFLEN) { nptr = 0; }
+
+  iqbuffer[0] = (tx_iq_sequence >> 24) & 0xFF;
+  iqbuffer[1] = (tx_iq_sequence >> 16) & 0xFF;
+  iqbuffer[2] = (tx_iq_sequence >>  8) & 0xFF;
+  iqbuffer[3] = (tx_iq_sequence      ) & 0xFF;
+  tx_iq_sequence++;
+  memcpy(&iqbuffer[4], &TXIQRINGBUF[txiq_outptr], 1440);
+  MEMORY_BARRIER;
+  txiq_outptr = nptr;
+}
+
 static gpointer new_protocol_rxaudio_thread(gpointer data) {
   ASSERT_SERVER(NULL);
   int nptr;
-  unsigned char audiobuffer[260];
+  unsigned char audiobuffer[P2_SEND_BATCH][260];
 
   //
   // Ideally, a RX audio buffer with 64 samples is sent every 1333 usecs.
@@ -1772,6 +1909,8 @@ static gpointer new_protocol_rxaudio_thread(gpointer data) {
   // (in network mode) or start DMA (in xdma mode).
   // After sending a packet in network mode, wait a little bit before
   // attempting to send the next one.
+  // If we lag behind in network mode, packets that are already waiting
+  // are sent together with a single system call.
   //
   while (P2running) {
 #ifdef __APPLE__
@@ -1792,18 +1931,11 @@ static gpointer new_protocol_rxaudio_thread(gpointer data) {
       continue;
     }
 
-    audiobuffer[0] = (audio_sequence >> 24) & 0xFF;
-    audiobuffer[1] = (audio_sequence >> 16) & 0xFF;
-    audiobuffer[2] = (audio_sequence >>  8) & 0xFF;
-    audiobuffer[3] = (audio_sequence      ) & 0xFF;
-    audio_sequence++;
-    memcpy(&audiobuffer[4], &RXAUDIORINGBUF[rxaudio_outptr], 256);
-    MEMORY_BARRIER;
-    rxaudio_outptr = nptr;
+    rxaudio_fill_packet(audiobuffer[0]);
 
     if (have_saturn_xdma) {
 #ifdef SATURN
-      saturn_handle_speaker_audio(audiobuffer);
+      saturn_handle_speaker_audio(audiobuffer[0]);
 #endif
     } else {
       //
@@ -1857,15 +1989,25 @@ static gpointer new_protocol_rxaudio_thread(gpointer data) {
       }
 
       FIFO += 64.0;  // number of samples in THIS packet
-      int rc = sendto(data_socket, audiobuffer, sizeof(audiobuffer), 0, (struct sockaddr*)&audio_addr, audio_addr_length);
+      int count = 1;
+#ifdef __APPLE__
+      sem_t *sem = rxaudio_sem;
+#else
+      sem_t *sem = &rxaudio_sem;
+#endif
+
+      while (FIFO <= 250.0 && count < P2_SEND_BATCH && !rxaudio_drain && sem_trywait(sem) == 0) {
+        rxaudio_fill_packet(audiobuffer[count++]);
+        FIFO += 64.0;
+      }
+
+      int rc = new_protocol_send(&audiobuffer[0][0], sizeof(audiobuffer[0]), count, &audio_addr, audio_addr_length);
 
       if (rc < 0) {
         g_idle_add(fatal_error, "FATAL: P2 Audio send failed (Network down?)");
         P2running = 0;
-      }
-
-      if (rc != sizeof(audiobuffer)) {
-        t_print("sendto socket failed for %ld bytes of audio: %d\n", (long)sizeof(audiobuffer), rc);
+      } else if (rc != count) {
+        t_print("sendto socket failed for %d audio packets: %d\n", count, rc);
       }
     }
   }
@@ -1875,8 +2017,7 @@ static gpointer new_protocol_rxaudio_thread(gpointer data) {
 
 static gpointer new_protocol_txiq_thread(gpointer data) {
   ASSERT_SERVER(NULL);
-  int nptr;
-  unsigned char iqbuffer[1444];
+  unsigned char iqbuffer[P2_SEND_BATCH][1444];
 
   //
   // Ideally, a TX IQ buffer with 240 sample is sent every 1250 usecs.
@@ -1885,6 +2026,8 @@ static gpointer new_protocol_txiq_thread(gpointer data) {
   // After sending a packet in network mode, take care that
   // after sending a packet, there is a delay of 1000 usec before
   // sending the next one.
+  // If we lag behind in network mode, packets that are already waiting
+  // are sent together with a single system call.
   //
   while (P2running) {
 #ifdef __APPLE__
@@ -1895,22 +2038,11 @@ static gpointer new_protocol_txiq_thread(gpointer data) {
 
     if (!P2running) { break; }
 
-    iqbuffer[0] = (tx_iq_sequence >> 24) & 0xFF;
-    iqbuffer[1] = (tx_iq_sequence >> 16) & 0xFF;
-    iqbuffer[2] = (tx_iq_sequence >>  8) & 0xFF;
-    iqbuffer[3] = (tx_iq_sequence      ) & 0xFF;
-    tx_iq_sequence++;
-    nptr = txiq_outptr + 1440;
-
-    if (nptr >= TXIQRINGBUFLEN) { nptr = 0; }
-
-    memcpy(&iqbuffer[4], &TXIQRINGBUF[txiq_outptr], 1440);
-    MEMORY_BARRIER;
-    txiq_outptr = nptr;
+    txiq_fill_packet(iqbuffer[0]);
 
     if (have_saturn_xdma) {
 #ifdef SATURN
-      saturn_handle_duc_iq(false, iqbuffer);
+      saturn_handle_duc_iq(false, iqbuffer[0]);
 #endif
     } else {
       //
@@ -1952,8 +2084,19 @@ static gpointer new_protocol_txiq_thread(gpointer data) {
       }
 
       FIFO += 240.0;  // number of samples in THIS packet
+      int count = 1;
+#ifdef __APPLE__
+      sem_t *sem = txiq_sem;
+#else
+      sem_t *sem = &txiq_sem;
+#endif
+
+      while (FIFO <= 1250.0 && count < P2_SEND_BATCH && sem_trywait(sem) == 0) {
+        txiq_fill_packet(iqbuffer[count++]);
+        FIFO += 240.0;
+      }
 
-      if (sendto(data_socket, iqbuffer, sizeof(iqbuffer), 0, (struct sockaddr * )&iq_addr, iq_addr_length) < 0) {
+      if (new_protocol_send(&iqbuffer[0][0], sizeof(iqbuffer[0]), count, &iq_addr, iq_addr_length) < 0) {
         g_idle_add(fatal_error, "FATAL: P2 TX IQ send failed (Network down?)");
         P2running = 0;
       }
@@ -1963,8 +2106,109 @@ static gpointer new_protocol_txiq_thread(gpointer data) {
   return NULL;
 }
 
+//
+// Max. number of packets fetched with a single recvmmsg() call.
+// recvmmsg() is Linux-specific and may be missing in the kernel
+// (ENOSYS). In this case, fall back to recvfrom() for good.
+//
+#ifdef __linux__
+  #define P2_RECV_BATCH 16
+  static int p2_use_recvmmsg = 1;
+#else
+  #define P2_RECV_BATCH 1
+#endif
+
+static int new_protocol_recv(mybuffer **batch, int *lens, struct sockaddr_in *from) {
+  //
+  // Receive packets into the buffers batch[0], batch[1], ...
+  // With recvmmsg() and MSG_WAITFORONE, this blocks until the first packet
+  // arrives, and then only collects packets that are already queued.
+  // Return the number of packets read, or -1 upon error.
+  //
+#ifdef __linux__
+
+  if (p2_use_recvmmsg) {
+    struct mmsghdr msgs[P2_RECV_BATCH];
+    struct iovec iovecs[P2_RECV_BATCH];
+    int n;
+    memset(msgs, 0, sizeof(msgs));
+
+    for (int i = 0; i < P2_RECV_BATCH; i++) {
+      iovecs[i].iov_base = batch[i]->buffer;
+      iovecs[i].iov_len = NET_BUFFER_SIZE;
+      msgs[i].msg_hdr.msg_iov = &iovecs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &from[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    n = recvmmsg(data_socket, msgs, P2_RECV_BATCH, MSG_WAITFORONE, NULL);
+
+    if (n >= 0 || errno != ENOSYS) {
+      for (int i = 0; i < n; i++) {
+        lens[i] = msgs[i].msg_len;
+      }
+
+      return n;
+    }
+
+    t_print("%s: recvmmsg not available, using recvfrom\n", __FUNCTION__);
+    p2_use_recvmmsg = 0;
+  }
+
+#endif
+  socklen_t fromlen = sizeof(struct sockaddr_in);
+  lens[0] = recvfrom(data_socket, batch[0]->buffer, NET_BUFFER_SIZE, 0, (struct sockaddr*)&from[0], &fromlen);
+  return (lens[0] < 0) ? -1 : 1;
+}
+
+static void new_protocol_dispatch(mybuffer *mybuf, int bytesread, short sourceport) {
+  int ddc;
+
+  //t_print("new_protocol_thread: recvd %d bytes on port %d\n",bytesread,sourceport);
+  switch (sourceport) {
+  case RX_IQ_TO_HOST_PORT_0:
+  case RX_IQ_TO_HOST_PORT_1:
+  case RX_IQ_TO_HOST_PORT_2:
+  case RX_IQ_TO_HOST_PORT_3:
+  case RX_IQ_TO_HOST_PORT_4:
+  case RX_IQ_TO_HOST_PORT_5:
+  case RX_IQ_TO_HOST_PORT_6:
+  case RX_IQ_TO_HOST_PORT_7:
+    ddc = sourceport - RX_IQ_TO_HOST_PORT_0;
+    saturn_post_iq_data(ddc, mybuf);
+    break;
+
+  case COMMAND_RESPONSE_TO_HOST_PORT:
+    //
+    // Ignore these packets silently. They occur when
+    // flashing a new firmware using the new protocol
+    // programmer. But this should be done in a separate
+    // program.
+    //
+    release_my_buffer(mybuf);
+    break;
+
+  case HIGH_PRIORITY_TO_HOST_PORT:
+    saturn_post_high_priority(mybuf);
+    break;
+
+  case MIC_LINE_TO_HOST_PORT:
+    saturn_post_micaudio(bytesread, mybuf);
+    break;
+
+  default:
+    t_print("new_protocol_thread: Unknown port %d\n", sourceport);
+    release_my_buffer(mybuf);
+    break;
+  }
+}
+
 static gpointer new_protocol_thread(gpointer data) {
   ASSERT_SERVER(NULL);
+  mybuffer *batch[P2_RECV_BATCH];
+  int lens[P2_RECV_BATCH];
+  struct sockaddr_in from[P2_RECV_BATCH];
   t_print("new_protocol_thread\n");
 
   //
@@ -1973,16 +2217,15 @@ static gpointer new_protocol_thread(gpointer data) {
   // then take care of processing the data. At least, this should apply to the
   // DDC-IQ and Microphone packets since they eventually get stuck in WDSP
   // (fexchange calls).
+  // Several packets are received with a single system call if possible.
+  // Each buffer that has been filled is handed over and replaced by a fresh one.
   //
+  for (int i = 0; i < P2_RECV_BATCH; i++) {
+    batch[i] = get_my_buffer();
+  }
+
   while (P2running) {
-    int ddc;
-    short sourceport;
-    int bytesread;
-    mybuffer *mybuf;
-    unsigned char *buffer;
-    mybuf = get_my_buffer();
-    buffer = mybuf->buffer;
-    bytesread = recvfrom(data_socket, buffer, NET_BUFFER_SIZE, 0, (struct sockaddr*)&addr, &length);
+    int n = new_protocol_recv(batch, lens, from);
 
     if (!P2running) {
       //
@@ -1990,58 +2233,26 @@ static gpointer new_protocol_thread(gpointer data) {
       // we were doing "recvfrom". In this case, we want to let the main
       // thread terminate gracefully, including writing the props files.
       //
-      mybuf->free = 1;
       break;
     }
 
-    if (bytesread < 0) {
+    if (n < 0) {
       t_perror("recvfrom socket failed for new_protocol_thread");
       g_idle_add(fatal_error, "FATAL: P2 receive (Network problem?)");
       P2running = 0;
       break;
     }
 
-    sourceport = ntohs(addr.sin_port);
-
-    //t_print("new_protocol_thread: recvd %d bytes on port %d\n",bytesread,sourceport);
-    switch (sourceport) {
-    case RX_IQ_TO_HOST_PORT_0:
-    case RX_IQ_TO_HOST_PORT_1:
-    case RX_IQ_TO_HOST_PORT_2:
-    case RX_IQ_TO_HOST_PORT_3:
-    case RX_IQ_TO_HOST_PORT_4:
-    case RX_IQ_TO_HOST_PORT_5:
-    case RX_IQ_TO_HOST_PORT_6:
-    case RX_IQ_TO_HOST_PORT_7:
-      ddc = sourceport - RX_IQ_TO_HOST_PORT_0;
-      saturn_post_iq_data(ddc, mybuf);
-      break;
-
-    case COMMAND_RESPONSE_TO_HOST_PORT:
-      //
-      // Ignore these packets silently. They occur when
-      // flashing a new firmware using the new protocol
-      // programmer. But this should be done in a separate
-      // program.
-      //
-      mybuf->free = 1;
-      break;
-
-    case HIGH_PRIORITY_TO_HOST_PORT:
-      saturn_post_high_priority(mybuf);
-      break;
-
-    case MIC_LINE_TO_HOST_PORT:
-      saturn_post_micaudio(bytesread, mybuf);
-      break;
-
-    default:
-      t_print("new_protocol_thread: Unknown port %d\n", sourceport);
-      mybuf->free = 1;
-      break;
+    for (int i = 0; i < n; i++) {
+      new_protocol_dispatch(batch[i], lens[i], ntohs(from[i].sin_port));
+      batch[i] = get_my_buffer();
     }
   }
 
+  for (int i = 0; i < P2_RECV_BATCH; i++) {
+    release_my_buffer(batch[i]);
+  }
+
   return NULL;
 }
 
@@ -2058,7 +2269,7 @@ static gpointer high_priority_thread(gpointer data) {
     sem_wait(&high_priority_sem_buffer);
 #endif
     process_high_priority();
-    high_priority_buffer->free = 1;
+    release_my_buffer(high_priority_buffer);
   }
 
   return NULL;
@@ -2092,7 +2303,7 @@ static gpointer mic_line_thread(gpointer data) {
     if (mybuf->free) { continue; }
 
     process_mic_data(mybuf->buffer);
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
   }
 
   return NULL;
@@ -2124,13 +2335,13 @@ void saturn_post_micaudio(int bytesread, mybuffer *mybuf) {
   ASSERT_SERVER();
 
   if (!P2running) {
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
     return;
   }
 
   if (mic_count < 0) {
     mic_count++;
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
     return;
   }
 
@@ -2149,7 +2360,7 @@ void saturn_post_micaudio(int bytesread, mybuffer *mybuf) {
     mic_inptr = nptr;
   } else {
     t_print("%s: buffer overflow.\n", __FUNCTION__);
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
     // skip 16 mic buffers (21 msec)
     mic_count = -16;
   }
@@ -2160,18 +2371,18 @@ void saturn_post_iq_data(int ddc, mybuffer *mybuf) {
 
   if (ddc < 0 || ddc >= MAX_DDC) {
     t_print("%s: invalid DDC(%d) seen!\n", __FUNCTION__, ddc);
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
     return;
   }
 
   if (!P2running) {
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
     return;
   }
 
   if (iq_count[ddc] < 0) {
     iq_count[ddc]++;
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
     return;
   }
 
@@ -2206,7 +2417,7 @@ void saturn_post_iq_data(int ddc, mybuffer *mybuf) {
 #endif
   } else {
     t_print("%s: DDC(%d) buffer overflow.\n", __FUNCTION__, ddc);
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
     // skip 128 incoming buffers
     iq_count[ddc] = -128;
   }
@@ -2287,20 +2498,49 @@ static gpointer iq_thread(gpointer data) {
       break;
     }
 
-    mybuf->free = 1;
+    release_my_buffer(mybuf);
   }
 
   return NULL;
 }
 
+//
+// Maximum number of 24-bit IQ samples that fit into a network buffer
+//
+#define P2_MAX_IQ_SAMPLES ((NET_BUFFER_SIZE - 16) / 6)
+
+//
+// Convert a 24-bit big-endian IQ sample to int. The sample is placed
+// in the upper bits of a 32-bit integer and then shifted back (the division
+// is exact), which sign-extends it.
+//
+static inline int p2_iq_sample(const unsigned char *p) {
+  return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8)) / 256;
+}
+
+//
+// Unpack the IQ samples of a data packet to interleaved doubles.
+// Returns the number of samples (that is, of IQ pairs) in the packet.
+//
+static int p2_unpack_iq(const unsigned char *buffer, double *iq) {
+  int samplesperframe = ((buffer[14] & 0xFF) << 8) + (buffer[15] & 0xFF);
+
+  if (samplesperframe > P2_MAX_IQ_SAMPLES) { samplesperframe = P2_MAX_IQ_SAMPLES; }
+
+  const unsigned char *p = &buffer[16];
+
+  for (int i = 0; i < 2 * samplesperframe; i++, p += 3) {
+    // The "obscure" constant 1.1920928955078125E-7 is 1/(2^23)
+    iq[i] = (double)p2_iq_sample(p) * 1.1920928955078125E-7;
+  }
+
+  return samplesperframe;
+}
+
 static void process_iq_data(const unsigned char *buffer, RECEIVER *rx) {
   ASSERT_SERVER();
-  int b;
-  int leftsample;
-  int rightsample;
-  double leftsampledouble;
-  double rightsampledouble;
-  int samplesperframe = ((buffer[14] & 0xFF) << 8) + (buffer[15] & 0xFF);
+  double iq[2 * P2_MAX_IQ_SAMPLES];
+  int samplesperframe = p2_unpack_iq(buffer, iq);
 #ifdef P2IQDEBUG
   long long timestamp =
     ((long long)(buffer[4] & 0xFF) << 56)
@@ -2314,40 +2554,41 @@ static void process_iq_data(const unsigned char *buffer, RECEIVER *rx) {
   int bitspersample = ((buffer[12] & 0xFF) << 8) + (buffer[13] & 0xFF);
   t_print("%s: rx=%d bitspersample=%d samplesperframe=%d\n", __FUNCTION__, rx->id, bitspersample, samplesperframe);
 #endif
-  b = 16;
-  int i;
+  rx_add_iq_block(rx, iq, samplesperframe);
+}
 
-  for (i = 0; i < samplesperframe; i++) {
-    leftsample   = (int)((signed char) buffer[b++]) << 16;
-    leftsample  |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    leftsample  |= (int)((unsigned char)buffer[b++] & 0xFF);
-    rightsample  = (int)((signed char)buffer[b++]) << 16;
-    rightsample |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    rightsample |= (int)((unsigned char)buffer[b++] & 0xFF);
-    // The "obscure" constant 1.1920928955078125E-7 is 1/(2^23)
-    leftsampledouble = (double)leftsample * 1.1920928955078125E-7;
-    rightsampledouble = (double)rightsample * 1.1920928955078125E-7;
-    rx_add_iq_samples(rx, leftsampledouble, rightsampledouble);
+//
+// With two synchronised DDCs, the samples of both DDCs are interleaved.
+// Split them into two separate sample streams.
+// Returns the number of samples (that is, of IQ pairs) per DDC.
+//
+static int p2_unpack_sync_iq(const unsigned char *buffer, double *iq0, double *iq1) {
+  double iq[2 * P2_MAX_IQ_SAMPLES];
+  int samplesperframe = p2_unpack_iq(buffer, iq);
+  int n = samplesperframe / 2;
+
+  for (int i = 0; i < n; i++) {
+    iq0[2 * i    ] = iq[4 * i    ];
+    iq0[2 * i + 1] = iq[4 * i + 1];
+    iq1[2 * i    ] = iq[4 * i + 2];
+    iq1[2 * i + 1] = iq[4 * i + 3];
   }
+
+  return n;
 }
 
 //
-// This is the same as process_ps_iq_data except that add_div_iq_samples is called
+// This is the same as process_ps_iq_data except that add_div_iq_block is called
 // at the end
 //
 static void process_div_iq_data(const unsigned char*buffer) {
   ASSERT_SERVER();
-  int b;
-  int leftsample0;
-  int rightsample0;
-  double leftsampledouble0;
-  double rightsampledouble0;
-  int leftsample1;
-  int rightsample1;
-  double leftsampledouble1;
-  double rightsampledouble1;
-  int samplesperframe = ((buffer[14] & 0xFF) << 8) + (buffer[15] & 0xFF);
+  double iq0[P2_MAX_IQ_SAMPLES];
+  double iq1[P2_MAX_IQ_SAMPLES];
+  int n = p2_unpack_sync_iq(buffer, iq0, iq1);
 #ifdef P2IQDEBUG
+  int samplesperframe = 2 * n;
+  RECEIVER *rx = receiver[0];
   long long timestamp =
     ((long long)(buffer[4] & 0xFF) << 56)
     + ((long long)(buffer[5] & 0xFF) << 48)
@@ -2356,55 +2597,28 @@ static void process_div_iq_data(const unsigned char*buffer) {
     + ((long long)(buffer[8] & 0xFF) << 24)
     + ((long long)(buffer[9] & 0xFF) << 16)
     + ((long long)(buffer[10] & 0xFF) << 8)
-    + ((long long)(buffer[11] & 0xFF)    );
+    + ((long long)(buffer[11] & 0xFF)   );
   int bitspersample = ((buffer[12] & 0xFF) << 8) + (buffer[13] & 0xFF);
   t_print("%s: rx=%d bitspersample=%d samplesperframe=%d\n", __FUNCTION__, rx->id, bitspersample, samplesperframe);
 #endif
-  b = 16;
-  int i;
-
-  for (i = 0; i < samplesperframe; i += 2) {
-    leftsample0   = (int)((signed char) buffer[b++]) << 16;
-    leftsample0  |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    leftsample0  |= (int)((unsigned char)buffer[b++] & 0xFF);
-    rightsample0  = (int)((signed char)buffer[b++]) << 16;
-    rightsample0 |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    rightsample0 |= (int)((unsigned char)buffer[b++] & 0xFF);
-    leftsampledouble0 = (double)leftsample0 * 1.1920928955078125E-7;
-    rightsampledouble0 = (double)rightsample0 * 1.1920928955078125E-7;
-    leftsample1   = (int)((signed char) buffer[b++]) << 16;
-    leftsample1  |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    leftsample1  |= (int)((unsigned char)buffer[b++] & 0xFF);
-    rightsample1  = (int)((signed char)buffer[b++]) << 16;
-    rightsample1 |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    rightsample1 |= (int)((unsigned char)buffer[b++] & 0xFF);
-    leftsampledouble1 = (double)leftsample1 * 1.1920928955078125E-7;
-    rightsampledouble1 = (double)rightsample1 * 1.1920928955078125E-7;
-    rx_add_div_iq_samples(receiver[0], leftsampledouble0, rightsampledouble0, leftsampledouble1, rightsampledouble1);
+  rx_add_div_iq_block(receiver[0], iq0, iq1, n);
 
-    //
-    // if both receivers share the sample rate, we can feed data to RX2
-    //
-    if (receivers > 1 && (receiver[0]->sample_rate == receiver[1]->sample_rate)) {
-      rx_add_iq_samples(receiver[1], leftsampledouble1, rightsampledouble1);
-    }
+  //
+  // if both receivers share the sample rate, we can feed data to RX2
+  //
+  if (receivers > 1 && (receiver[0]->sample_rate == receiver[1]->sample_rate)) {
+    rx_add_iq_block(receiver[1], iq1, n);
   }
 }
 
 static void process_ps_iq_data(const unsigned char *buffer) {
   ASSERT_SERVER();
-  int samplesperframe;
-  int b;
-  int leftsample0;
-  int rightsample0;
-  double leftsampledouble0;
-  double rightsampledouble0;
-  int leftsample1;
-  int rightsample1;
-  double leftsampledouble1;
-  double rightsampledouble1;
-  samplesperframe = ((buffer[14] & 0xFF) << 8) + (buffer[15] & 0xFF);
+  double iq0[P2_MAX_IQ_SAMPLES];
+  double iq1[P2_MAX_IQ_SAMPLES];
+  int n = p2_unpack_sync_iq(buffer, iq0, iq1);
 #ifdef P2IQDEBUG
+  int samplesperframe = 2 * n;
+  RECEIVER *rx = receiver[PS_RX_FEEDBACK];
   long long timestamp =
     ((long long)(buffer[4] & 0xFF) << 56)
     + ((long long)(buffer[5] & 0xFF) << 48)
@@ -2417,44 +2631,26 @@ static void process_ps_iq_data(const unsigned char *buffer) {
   int bitspersample = ((buffer[12] & 0xFF) << 8) + (buffer[13] & 0xFF);
   t_print("%s: rx=%d bitspersample=%d samplesperframe=%d\n", __FUNCTION__, rx->id, bitspersample, samplesperframe);
 #endif
-  b = 16;
-  int i;
-
-  for (i = 0; i < samplesperframe; i += 2) {
-    leftsample0   = (int)((signed char) buffer[b++]) << 16;
-    leftsample0  |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    leftsample0  |= (int)((unsigned char)buffer[b++] & 0xFF);
-    rightsample0  = (int)((signed char)buffer[b++]) << 16;
-    rightsample0 |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    rightsample0 |= (int)((unsigned char)buffer[b++] & 0xFF);
-    leftsampledouble0 = (double)leftsample0 * 1.1920928955078125E-7;
-    rightsampledouble0 = (double)rightsample0 * 1.1920928955078125E-7;
-    leftsample1   = (int)((signed char) buffer[b++]) << 16;
-    leftsample1  |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    leftsample1  |= (int)((unsigned char)buffer[b++] & 0xFF);
-    rightsample1  = (int)((signed char)buffer[b++]) << 16;
-    rightsample1 |= (int)((((unsigned char)buffer[b++]) << 8) & 0xFF00);
-    rightsample1 |= (int)((unsigned char)buffer[b++] & 0xFF);
-    leftsampledouble1 = (double)leftsample1 * 1.1920928955078125E-7;
-    rightsampledouble1 = (double)rightsample1 * 1.1920928955078125E-7;
-    tx_add_ps_iq_samples(transmitter, leftsampledouble1, rightsampledouble1, leftsampledouble0, rightsampledouble0);
-    //t_print("%06x,%06x %06x,%06x\n",leftsample0,rightsample0,leftsample1,rightsample1);
+  tx_add_ps_iq_block(transmitter, iq1, iq0, n);
 #if defined(DUMP_TX_DATA)
 
+  for (int i = 0; i < n; i++) {
+    const unsigned char *p = &buffer[16 + 12 * i];
+
     if ((DUMP_TX_DATA == DUMP_TXFDBK) && (rxiq_count < 1000000)) {
-      rxiqi[rxiq_count] = leftsample1;
-      rxiqq[rxiq_count] = rightsample1;
+      rxiqi[rxiq_count] = p2_iq_sample(p + 6);
+      rxiqq[rxiq_count] = p2_iq_sample(p + 9);
       rxiq_count++;
     }
 
     if ((DUMP_TX_DATA == DUMP_RXFDBK) && (rxiq_count < 1000000)) {
-      rxiqi[rxiq_count] = leftsample0;
-      rxiqq[rxiq_count] = rightsample0;
+      rxiqi[rxiq_count] = p2_iq_sample(p);
+      rxiqq[rxiq_count] = p2_iq_sample(p + 3);
       rxiq_count++;
     }
+  }
 
 #endif
-  }
 }
 
 static void process_high_priority() {
@@ -2679,21 +2875,18 @@ void new_protocol_tx_audio_samples(short left_audio_sample, short right_audio_sa
 }
 
 //
+// n stereo audio samples (interleaved L/R) from the active receiver.
+// The samples are packed in chunks up to the next packet boundary, so the
+// inner loop is free of bookkeeping, and the mutex is taken once per block.
 // This is only called from the RX thread
 //
-void new_protocol_audio_samples(short left_audio_sample, short right_audio_sample) {
+void new_protocol_audio_block(const short *audio, int n) {
   ASSERT_SERVER();
 
   if (radio_is_transmitting() && !duplex) { return; }
 
   pthread_mutex_lock(&send_rxaudio_mutex);
 
-  if (rxaudio_count < 0) {
-    rxaudio_count++;
-    pthread_mutex_unlock(&send_rxaudio_mutex);
-    return;
-  }
-
   if (rxaudio_flag) {
     //
     // First time we arrive here after a TX(CW)->RX transition:
@@ -2704,79 +2897,107 @@ void new_protocol_audio_samples(short left_audio_sample, short right_audio_sampl
     rxaudio_flag = 0;
   }
 
-  int iptr = rxaudio_inptr + 4 * rxaudio_count;
-  RXAUDIORINGBUF[iptr++] = (left_audio_sample  >> 8) & 0xFF;
-  RXAUDIORINGBUF[iptr++] = (left_audio_sample      ) & 0xFF;
-  RXAUDIORINGBUF[iptr++] = (right_audio_sample >> 8) & 0xFF;
-  RXAUDIORINGBUF[iptr++] = (right_audio_sample     ) & 0xFF;
-  rxaudio_count++;
+  int k = 0;
 
-  if (rxaudio_count >= 64) {
-    int nptr = rxaudio_inptr + 256;
+  while (k < n) {
+    if (rxaudio_count < 0) {
+      // skip samples after an overflow
+      int skip = MIN(n - k, -rxaudio_count);
+      rxaudio_count += skip;
+      k += skip;
+      continue;
+    }
 
-    if (nptr >= RXAUDIORINGBUFLEN) { nptr = 0; }
+    int chunk = MIN(n - k, 64 - rxaudio_count);
+    unsigned char *p = &RXAUDIORINGBUF[rxaudio_inptr + 4 * rxaudio_count];
 
-    if (nptr != rxaudio_outptr) {
-      rxaudio_inptr = nptr;
+    for (int j = 2 * k; j < 2 * (k + chunk); j++, p += 2) {
+      p[0] = (audio[j] >> 8) & 0xFF;
+      p[1] = (audio[j]     ) & 0xFF;
+    }
+
+    k += chunk;
+    rxaudio_count += chunk;
+
+    if (rxaudio_count >= 64) {
+      int nptr = rxaudio_inptr + 256;
+
+      if (nptr >= RXAUDIORINGBUFLEN) { nptr = 0; }
+
+      if (nptr != rxaudio_outptr) {
+        rxaudio_inptr = nptr;
 #ifdef __APPLE__
-      sem_post(rxaudio_sem);
+        sem_post(rxaudio_sem);
 #else
-      sem_post(&rxaudio_sem);
+        sem_post(&rxaudio_sem);
 #endif
-      rxaudio_count = 0;
-    } else {
-      t_print("%s: buffer overflow\n", __FUNCTION__);
-      // skip some audio samples
-      rxaudio_count = -4096;
+        rxaudio_count = 0;
+      } else {
+        t_print("%s: buffer overflow\n", __FUNCTION__);
+        // skip some audio samples
+        rxaudio_count = -4096;
+      }
     }
   }
 
   pthread_mutex_unlock(&send_rxaudio_mutex);
 }
 
-void new_protocol_iq_samples(int isample, int qsample) {
+//
+// n TX IQ samples (interleaved I/Q), packed as 24-bit big endian values
+// in chunks up to the next packet boundary.
+//
+void new_protocol_iq_block(const int *iq, int n) {
   ASSERT_SERVER();
+  int k = 0;
 
-  if (txiq_count < 0) {
-    txiq_count++;
-    return;
-  }
+  while (k < n) {
+    if (txiq_count < 0) {
+      int skip = MIN(n - k, -txiq_count);
+      txiq_count += skip;
+      k += skip;
+      continue;
+    }
 
+    int chunk = MIN(n - k, 240 - txiq_count);
 #if defined(DUMP_TX_DATA)
 
-  if ((DUMP_TX_DATA == DUMP_TXIQ) && (rxiq_count < 1000000)) {
-    rxiqi[rxiq_count] = isample;
-    rxiqq[rxiq_count] = qsample;
-    rxiq_count++;
-  }
+    for (int j = k; j < k + chunk && (DUMP_TX_DATA == DUMP_TXIQ) && (rxiq_count < 1000000); j++) {
+      rxiqi[rxiq_count] = iq[2 * j];
+      rxiqq[rxiq_count] = iq[2 * j + 1];
+      rxiq_count++;
+    }
 
 #endif
-  int iptr = txiq_inptr + 6 * txiq_count;
-  TXIQRINGBUF[iptr++] = (isample >> 16) & 0xFF;
-  TXIQRINGBUF[iptr++] = (isample >>  8) & 0xFF;
-  TXIQRINGBUF[iptr++] = (isample      ) & 0xFF;
-  TXIQRINGBUF[iptr++] = (qsample >> 16) & 0xFF;
-  TXIQRINGBUF[iptr++] = (qsample >>  8) & 0xFF;
-  TXIQRINGBUF[iptr++] = (qsample      ) & 0xFF;
-  txiq_count++;
-
-  if (txiq_count >= 240) {
-    int nptr = txiq_inptr + 1440;
-
-    if (nptr >= TXIQRINGBUFLEN) { nptr = 0; }
-
-    if (nptr != txiq_outptr) {
-      txiq_inptr = nptr;
-      txiq_count = 0;
+    unsigned char *p = &TXIQRINGBUF[txiq_inptr + 6 * txiq_count];
+
+    for (int j = 2 * k; j < 2 * (k + chunk); j++, p += 3) {
+      p[0] = (iq[j] >> 16) & 0xFF;
+      p[1] = (iq[j] >>  8) & 0xFF;
+      p[2] = (iq[j]      ) & 0xFF;
+    }
+
+    k += chunk;
+    txiq_count += chunk;
+
+    if (txiq_count >= 240) {
+      int nptr = txiq_inptr + 1440;
+
+      if (nptr >= TXIQRINGBUFLEN) { nptr = 0; }
+
+      if (nptr != txiq_outptr) {
+        txiq_inptr = nptr;
+        txiq_count = 0;
 #ifdef __APPLE__
-      sem_post(txiq_sem);
+        sem_post(txiq_sem);
 #else
-      sem_post(&txiq_sem);
+        sem_post(&txiq_sem);
 #endif
-    } else {
-      t_print("%s: output buffer overflow\n", __FUNCTION__);
-      // skip 4800 samples ( 25 msec @ 192k )
-      txiq_count = -4800;
+      } else {
+        t_print("%s: output buffer overflow\n", __FUNCTION__);
+        // skip 4800 samples ( 25 msec @ 192k )
+        txiq_count = -4800;
+      }
     }
   }
 }
@@ -66,6 +66,7 @@
 
 struct mybuffer_ {
   struct mybuffer_ *next;
+  struct mybuffer_ *next_free;
   int             free;
   long            lowfence;
   unsigned char   buffer[NET_BUFFER_SIZE];
@@ -87,13 +88,14 @@ extern void filter_board_changed(void);
 extern void pa_changed(void);
 extern void tuner_changed(void);
 
-extern void new_protocol_audio_samples(short left, short right);
-extern void new_protocol_iq_samples(int isample, int qsample);
+extern void new_protocol_audio_block(const short *audio, int n);
+extern void new_protocol_iq_block(const int *iq, int n);
 extern void new_protocol_flush_iq_samples(void);
 extern void new_protocol_tx_audio_samples(short left, short right);
 
 extern void new_protocol_menu_start(void);
 extern void new_protocol_menu_stop(void);
+extern void new_protocol_buffer_stats(int *size, int *high_water);
 extern void saturn_post_iq_data(int ddc, mybuffer *buffer);
 extern void saturn_post_micaudio(int bytes, mybuffer *buffer);
 extern void saturn_post_high_priority(mybuffer *buffer);
@@ -17,6 +17,9 @@
 *
 */
 
+#ifdef __linux__
+  #define _GNU_SOURCE    // for recvmmsg()
+#endif
 #include <gtk/gtk.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -68,6 +71,14 @@
 
 #define SYNC 0x7F
 #define OZY_BUFFER_SIZE 512
+#define METIS_PACKET_SIZE 1032
+
+//
+// Max. number of METIS packets fetched with a single recvmmsg() call,
+// or sent with a single sendmmsg() call
+//
+#define P1_RECV_BATCH 8
+#define P1_SEND_BATCH 8
 
 //
 // Atlas-Bus configuration bits (METIS/OZY)
@@ -88,28 +99,6 @@
 #define LT2208_DITHER_ON          0x08
 #define LT2208_RANDOM_ON          0x10
 
-// state machine buffer processing
-enum {
-  SYNC_0 = 0,
-  SYNC_1,
-  SYNC_2,
-  CONTROL_0,
-  CONTROL_1,
-  CONTROL_2,
-  CONTROL_3,
-  CONTROL_4,
-  LEFT_SAMPLE_HI,
-  LEFT_SAMPLE_MID,
-  LEFT_SAMPLE_LOW,
-  RIGHT_SAMPLE_HI,
-  RIGHT_SAMPLE_MID,
-  RIGHT_SAMPLE_LOW,
-  MIC_SAMPLE_HI,
-  MIC_SAMPLE_LOW,
-  SKIP
-};
-static int state = SYNC_0;
-
 static int data_socket = -1;
 static int tcp_socket = -1;
 static struct sockaddr_in data_addr;
@@ -144,6 +133,20 @@ static int metis_offset = 8;
 static void metis_write(unsigned char ep, unsigned const char* buffer);
 static void metis_start_stop(int command);
 static void metis_send_buffer(const unsigned char* buffer, int length);
+static void metis_send_batch(void);
+
+//
+// If metis_batching is set, metis_write() does not send complete
+// METIS packets but collects them in metis_batch. They are sent
+// with a single system call by metis_send_batch(). This is only
+// used from within the TXIQ thread, with the send_mutex locked.
+//
+static int metis_batching = 0;
+static int metis_batch_count = 0;
+static unsigned char metis_batch[P1_SEND_BATCH][METIS_PACKET_SIZE];
+#ifdef __linux__
+  static int p1_use_sendmmsg = 1;
+#endif
 
 static void open_tcp_socket(void);
 static void open_udp_socket(void);
@@ -184,8 +187,8 @@ static int mercury_software_version[2] = { 0, 0 };
 #endif
 //
 // TXIQ/audio data can be sent from two different threads, namely
-// from the RX thread (old_protocol_audio_samples(), when sending RX audio)
-// and from the TX thread (old_protocol_iq_samples(), when sending
+// from the RX thread (old_protocol_audio_block(), when sending RX audio)
+// and from the TX thread (old_protocol_iq_block(), when sending
 // TXIQ data and side tone). This is mutex protected to prevent
 // race conditions when updating TQIQ ring buffer pointers.
 //
@@ -338,18 +341,41 @@ static gpointer old_protocol_txiq_thread(gpointer data) {
       //
       // If we do not get a lock, this means a protocol restart is
       // attempted from "somewhere else", in this case do not
-      // send out data
+      // send out data.
+      // If we lag behind, further packets that are already waiting
+      // would be sent without delay, so send them with a single
+      // system call.
       //
-      FIFO += 126.0;  // number of samples in THIS packet
-      memcpy(ozy_buffer + 8, &TXRINGBUF[txring_outptr    ], 504);
-      ozy_send_buffer(ozy_buffer);
-      memcpy(ozy_buffer + 8, &TXRINGBUF[txring_outptr + 504], 504);
-      ozy_send_buffer(ozy_buffer);
+#ifdef __APPLE__
+      sem_t *sem = txring_sem;
+#else
+      sem_t *sem = &txring_sem;
+#endif
+      metis_batching = 1;
+
+      for (;;) {
+        FIFO += 126.0;  // number of samples in THIS packet
+        memcpy(ozy_buffer + 8, &TXRINGBUF[txring_outptr    ], 504);
+        ozy_send_buffer(ozy_buffer);
+        memcpy(ozy_buffer + 8, &TXRINGBUF[txring_outptr + 504], 504);
+        ozy_send_buffer(ozy_buffer);
+        MEMORY_BARRIER;
+        txring_outptr = nptr;
+
+        if (FIFO > 300.0 || metis_batch_count >= P1_SEND_BATCH || txring_drain || sem_trywait(sem) != 0) { break; }
+
+        nptr = txring_outptr + 1008;
+
+        if (nptr >= TXRINGBUFLEN) { nptr = 0; }
+      }
+
+      metis_send_batch();
+      metis_batching = 0;
       pthread_mutex_unlock(&send_mutex);
+    } else {
+      MEMORY_BARRIER;
+      txring_outptr = nptr;
     }
-
-    MEMORY_BARRIER;
-    txring_outptr = nptr;
   }
 
   return NULL;
@@ -784,6 +810,85 @@ static void open_tcp_socket() {
   t_print("TCP socket established: %d\n", tcp_socket);
 }
 
+static int metis_check_packet(const unsigned char *buffer, int bytes_read) {
+  //
+  // Check whether this is a valid METIS EP6 data packet, and
+  // keep track of the sequence numbers.
+  // Return 0 if valid, -1 otherwise.
+  //
+  if (bytes_read == METIS_PACKET_SIZE && buffer[0] == 0xEF && buffer[1] == 0xFE && buffer[3] == 6) {
+    //
+    // This is the data frame we are looking for
+    //
+    uint32_t sequence = ((buffer[4] & 0xFF) << 24) + ((buffer[5] & 0xFF) << 16) + ((buffer[6] & 0xFF) << 8) +
+                        (buffer[7] & 0xFF);
+
+    // A sequence error with a seqnum of zero usually indicates a METIS restart
+    // and is no error condition
+    if (sequence != 0 && sequence != last_seq_num + 1) {
+      t_print("SEQ ERROR: last %ld, recvd %ld\n", (long) last_seq_num, (long) sequence);
+      sequence_errors++;
+    }
+
+    last_seq_num = sequence;
+    return 0;
+  }
+
+  if (bytes_read > 12) {
+    t_print("%s: Invalid packet Header=%02x%02x EP=%d len=%d\n", __FUNCTION__, buffer[0], buffer[1], buffer[3], bytes_read);
+  }
+
+  return -1;
+}
+
+#ifdef __linux__
+//
+// recvmmsg() is Linux-specific and may be missing in the kernel
+// (ENOSYS). In this case, fall back to metis_read() for good.
+//
+static int p1_use_recvmmsg = 1;
+
+static int metis_read_batch(unsigned char buffers[][METIS_PACKET_SIZE], int *lens) {
+  //
+  // Read up to P1_RECV_BATCH UDP packets with a single system call.
+  // With MSG_WAITFORONE, this blocks (up to the socket time-out) until
+  // the first packet arrives, and then only collects packets that are
+  // already queued.
+  // Return the number of packets read, or -1 upon error/time-out.
+  //
+  struct mmsghdr msgs[P1_RECV_BATCH];
+  struct iovec iovecs[P1_RECV_BATCH];
+  int n;
+  memset(msgs, 0, sizeof(msgs));
+
+  for (int i = 0; i < P1_RECV_BATCH; i++) {
+    iovecs[i].iov_base = buffers[i];
+    iovecs[i].iov_len = METIS_PACKET_SIZE;
+    msgs[i].msg_hdr.msg_iov = &iovecs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  n = recvmmsg(data_socket, msgs, P1_RECV_BATCH, MSG_WAITFORONE, NULL);
+
+  if (n < 0) {
+    if (errno == ENOSYS) {
+      t_print("%s: recvmmsg not available, using recvfrom\n", __FUNCTION__);
+      p1_use_recvmmsg = 0;
+    } else if (errno != EAGAIN) {
+      t_perror("old_protocol recvmmsg UDP");
+    }
+
+    return -1;
+  }
+
+  for (int i = 0; i < n; i++) {
+    lens[i] = msgs[i].msg_len;
+  }
+
+  return n;
+}
+#endif
+
 static int metis_read(unsigned char *buffer, int len) {
   //
   // Read one packet. In the TCP case, read eactly len bytes.
@@ -828,25 +933,7 @@ static int metis_read(unsigned char *buffer, int len) {
     bytes_read = 0;
   }
 
-  if (bytes_read == 1032 && buffer[0] == 0xEF && buffer[1] == 0xFE && buffer[3] == 6) {
-    //
-    // This is the data frame we are looking for
-    //
-    uint32_t sequence = ((buffer[4] & 0xFF) << 24) + ((buffer[5] & 0xFF) << 16) + ((buffer[6] & 0xFF) << 8) +
-                        (buffer[7] & 0xFF);
-
-    // A sequence error with a seqnum of zero usually indicates a METIS restart
-    // and is no error condition
-    if (sequence != 0 && sequence != last_seq_num + 1) {
-      t_print("SEQ ERROR: last %ld, recvd %ld\n", (long) last_seq_num, (long) sequence);
-      sequence_errors++;
-    }
-
-    last_seq_num = sequence;
-    ret = 0;
-  } else if (bytes_read > 12) {
-    t_print("%s: Invalid packet Header=%02x%02x EP=%d len=%d\n", __FUNCTION__, buffer[0], buffer[1], buffer[3], bytes_read);
-  }
+  if (metis_check_packet(buffer, bytes_read) == 0) { ret = 0; }
 
   return ret;
 }
@@ -855,6 +942,10 @@ static gpointer receive_thread(gpointer arg) {
   ASSERT_SERVER(NULL);
   unsigned char buffer[2000];
   int ret;
+#ifdef __linux__
+  unsigned char batch[P1_RECV_BATCH][METIS_PACKET_SIZE];
+  int lens[P1_RECV_BATCH];
+#endif
   t_print( "old_protocol: receive_thread\n");
 
   if (device == DEVICE_OZY) { return NULL; }  // should not happen
@@ -873,7 +964,31 @@ static gpointer receive_thread(gpointer arg) {
     // this thread, e.g. when restarting the protocol
     //
     if (pthread_mutex_trylock(&recv_mutex) == 0) {
-      ret = P1running ? metis_read(buffer, 1032) : -1;
+#ifdef __linux__
+
+      if (p1_use_recvmmsg && tcp_socket <= 0 && data_socket >= 0) {
+        //
+        // UDP: fetch all packets that are already queued with one system call
+        //
+        int n = P1running ? metis_read_batch(batch, lens) : -1;
+
+        for (int i = 0; i < n; i++) {
+          lens[i] = metis_check_packet(batch[i], lens[i]);
+        }
+
+        pthread_mutex_unlock(&recv_mutex);
+
+        for (int i = 0; i < n; i++) {
+          if (lens[i] == 0) {
+            queue_two_ozy_input_buffers(&batch[i][8], &batch[i][520]);
+          }
+        }
+
+        continue;
+      }
+
+#endif
+      ret = P1running ? metis_read(buffer, METIS_PACKET_SIZE) : -1;
       pthread_mutex_unlock(&recv_mutex);
 
       if (ret >= 0) {
@@ -1103,24 +1218,6 @@ static int how_many_receivers() {
   return ret;
 }
 
-static int nreceiver;
-static int left_sample;
-static int right_sample;
-static short next_mic_sample;
-static double left_sample_double;
-static double right_sample_double;
-double left_sample_double_rx;
-double right_sample_double_rx;
-double left_sample_double_tx;
-double right_sample_double_tx;
-double left_sample_double_main;
-double right_sample_double_main;
-double left_sample_double_aux;
-double right_sample_double_aux;
-
-static int nsamples;
-static int iq_samples;
-
 static void process_control_bytes() {
   ASSERT_SERVER();
   int previous_ptt;
@@ -1333,183 +1430,114 @@ static void process_control_bytes() {
 
 //
 // These static variables are set at the beginning
-// of process_ozy_input_buffer() and "do" the communication
-// with process_ozy_byte()
+// of process_ozy_input_buffer_thread() for each pair of
+// OZY frames and "do" the communication with process_ozy_frame()
 //
 static int st_num_hpsdr_receivers;
 static int st_rxfdbk;
 static int st_txfdbk;
 
-static void process_ozy_byte(int b) {
-  ASSERT_SERVER();
-
-  switch (state) {
-  case SYNC_0:
-    if (b == SYNC) {
-      state++;
-    }
-
-    break;
-
-  case SYNC_1:
-    if (b == SYNC) {
-      state++;
-    } else {
-      state = SYNC_0;
-    }
+//
+// Maximum number of HPSDR receivers in a P1 stream, and the maximum
+// number of samples in an OZY frame (this is achieved with a single receiver)
+//
+#define OZY_MAX_RECEIVERS 8
+#define OZY_MAX_SAMPLES   ((OZY_BUFFER_SIZE - 8) / 8)
 
-    break;
+static double ozy_iq[OZY_MAX_RECEIVERS][2 * OZY_MAX_SAMPLES];
+static short ozy_mic[OZY_MAX_SAMPLES];
+static int ozy_sync_errors = 0;
 
-  case SYNC_2:
-    if (b == SYNC) {
-      state++;
-    } else {
-      state = SYNC_0;
+static void process_ozy_frame(const unsigned char *buf) {
+  ASSERT_SERVER();
+  //
+  // Decode one 512-byte OZY frame. After the sync and control bytes,
+  // there are nsamples groups of (6 bytes IQ per HPSDR receiver, 2 bytes mic).
+  // The frame is first completely unpacked into per-receiver IQ and
+  // mic sample batches (with a fixed stride), then these batches are
+  // distributed to the RX and TX engines.
+  //
+  if (buf[0] != SYNC || buf[1] != SYNC || buf[2] != SYNC) {
+    if (ozy_sync_errors++ == 0) {
+      t_print("%s: OZY frame with bad sync bytes skipped.\n", __FUNCTION__);
     }
 
-    break;
-
-  case CONTROL_0:
-    control_in[0] = b;
-    state++;
-    break;
-
-  case CONTROL_1:
-    control_in[1] = b;
-    state++;
-    break;
+    return;
+  }
 
-  case CONTROL_2:
-    control_in[2] = b;
-    state++;
-    break;
+  memcpy(control_in, &buf[3], 5);
+  process_control_bytes();
+  int nddc = st_num_hpsdr_receivers;
 
-  case CONTROL_3:
-    control_in[3] = b;
-    state++;
-    break;
+  if (nddc < 1 || nddc > OZY_MAX_RECEIVERS) { return; }
 
-  case CONTROL_4:
-    control_in[4] = b;
-    process_control_bytes();
-    nreceiver = 0;
-    iq_samples = (512 - 8) / ((st_num_hpsdr_receivers * 6) + 2);
-    nsamples = 0;
-    state++;
-    break;
+  const int stride = 6 * nddc + 2;
+  const int nsamples = (OZY_BUFFER_SIZE - 8) / stride;
 
-  case LEFT_SAMPLE_HI:
-    left_sample = (int)((signed char)b << 16);
-    state++;
-    break;
+  //
+  // 24-bit big-endian IQ samples are placed in the upper bits of a 32-bit
+  // integer and then scaled by 2^(-31). This is exactly the same as
+  // sign-extending to 32 bits and scaling by 2^(-23).
+  //
+  for (int ddc = 0; ddc < nddc; ddc++) {
+    const unsigned char *p = &buf[8 + 6 * ddc];
+    double *iq = ozy_iq[ddc];
 
-  case LEFT_SAMPLE_MID:
-    left_sample |= (int)((((unsigned char)b) << 8) & 0xFF00);
-    state++;
-    break;
+    for (int j = 0; j < nsamples; j++, p += stride) {
+      int32_t isample = (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8));
+      int32_t qsample = (int32_t)(((uint32_t)p[3] << 24) | ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 8));
+      iq[2 * j    ] = (double)isample * 4.656612873077392578125E-10;
+      iq[2 * j + 1] = (double)qsample * 4.656612873077392578125E-10;
+    }
+  }
 
-  case LEFT_SAMPLE_LOW:
-    left_sample |= (int)((unsigned char)b & 0xFF);
-    left_sample_double = (double)left_sample * 1.1920928955078125E-7;
-    state++;
-    break;
+  const unsigned char *p = &buf[8 + 6 * nddc];
 
-  case RIGHT_SAMPLE_HI:
-    right_sample = (int)((signed char)b << 16);
-    state++;
-    break;
+  for (int j = 0; j < nsamples; j++, p += stride) {
+    ozy_mic[j] = (short)((p[0] << 8) | p[1]);
+  }
 
-  case RIGHT_SAMPLE_MID:
-    right_sample |= (int)((((unsigned char)b) << 8) & 0xFF00);
-    state++;
-    break;
+  int xmit = radio_is_transmitting();
 
-  case RIGHT_SAMPLE_LOW:
-    right_sample |= (int)((unsigned char)b & 0xFF);
-    right_sample_double = (double)right_sample * 1.1920928955078125E-7;
+  if (xmit && transmitter->puresignal && st_rxfdbk < nddc && st_txfdbk < nddc) {
+    //
+    // transmitting with PureSignal. Feed sample pairs to pscc
+    //
+    const double *rx = ozy_iq[st_rxfdbk];
+    const double *tx = ozy_iq[st_txfdbk];
 
-    if (radio_is_transmitting() && transmitter->puresignal) {
-      //
-      // transmitting with PureSignal. Get sample pairs and feed to pscc
-      //
-      if (nreceiver == st_rxfdbk) {
-        left_sample_double_rx = left_sample_double;
-        right_sample_double_rx = right_sample_double;
-      } else if (nreceiver == st_txfdbk) {
-        left_sample_double_tx = left_sample_double;
-        right_sample_double_tx = right_sample_double;
-      }
+    tx_add_ps_iq_block(transmitter, tx, rx, nsamples);
+  }
 
-      // this is pure paranoia, it allows for st_txfdbk < st_rxfdbk
-      if (nreceiver + 1 == st_num_hpsdr_receivers) {
-        tx_add_ps_iq_samples(transmitter, left_sample_double_tx, right_sample_double_tx, left_sample_double_rx,
-                             right_sample_double_rx);
-      }
-    }
+  if (!xmit && diversity_enabled && nddc > 1) {
+    //
+    // receiving with DIVERSITY. Feed sample pairs to diversity mixer.
+    // If the second RX is running, feed aux samples to that receiver.
+    //
+    const double *iq0 = ozy_iq[0];
+    const double *iq1 = ozy_iq[1];
 
-    if (!radio_is_transmitting() && diversity_enabled) {
-      //
-      // receiving with DIVERSITY. Get sample pairs and feed to diversity mixer.
-      // If the second RX is running, feed aux samples to that receiver.
-      //
-      if (nreceiver == 0) {
-        left_sample_double_main = left_sample_double;
-        right_sample_double_main = right_sample_double;
-      } else if (nreceiver == 1) {
-        left_sample_double_aux = left_sample_double;
-        right_sample_double_aux = right_sample_double;
-        rx_add_div_iq_samples(receiver[0], left_sample_double_main, right_sample_double_main, left_sample_double_aux,
-                              right_sample_double_aux);
-
-        if (receivers > 1) { rx_add_iq_samples(receiver[1], left_sample_double_aux, right_sample_double_aux); }
-      }
-    }
+    rx_add_div_iq_block(receiver[0], iq0, iq1, nsamples);
 
-    if ((!radio_is_transmitting() || duplex) && !diversity_enabled) {
-      //
-      // RX without DIVERSITY. Feed samples to RX1 and RX2
-      //
-      if (nreceiver == 0) {
-        rx_add_iq_samples(receiver[0], left_sample_double, right_sample_double);
-      } else if (nreceiver == 1 && receivers > 1) {
-        rx_add_iq_samples(receiver[1], left_sample_double, right_sample_double);
-      }
+    if (receivers > 1) {
+      rx_add_iq_block(receiver[1], iq1, nsamples);
     }
+  }
 
-    nreceiver++;
-
-    if (nreceiver == st_num_hpsdr_receivers) {
-      state++;
-    } else {
-      state = LEFT_SAMPLE_HI;
+  if ((!xmit || duplex) && !diversity_enabled) {
+    //
+    // RX without DIVERSITY. Feed samples to RX1 and RX2
+    //
+    for (int r = 0; r < receivers && r < nddc && r < 2; r++) {
+      rx_add_iq_block(receiver[r], ozy_iq[r], nsamples);
     }
+  }
 
-    break;
-
-  case MIC_SAMPLE_HI:
-    next_mic_sample = (short)(b << 8);
-    state++;
-    break;
-
-  case MIC_SAMPLE_LOW:
-    next_mic_sample |= (short)(b & 0xFF);
-    mic_samples++;
-
-    if (mic_samples >= mic_sample_divisor) { // reduce to 48000
-      tx_add_mic_sample(transmitter, next_mic_sample);
+  for (int j = 0; j < nsamples; j++) {
+    if (++mic_samples >= mic_sample_divisor) { // reduce to 48000
+      tx_add_mic_sample(transmitter, ozy_mic[j]);
       mic_samples = 0;
     }
-
-    nsamples++;
-
-    if (nsamples == iq_samples) {
-      state = SYNC_0;
-    } else {
-      nreceiver = 0;
-      state = LEFT_SAMPLE_HI;
-    }
-
-    break;
   }
 }
 
@@ -1557,7 +1585,7 @@ static gpointer process_ozy_input_buffer_thread(gpointer arg) {
   // This thread constantly monitors the input ring buffer and
   // processes the data whenever a bunch is available. Note this
   // thread does all the fexchange() with WDSP, since it calls
-  // (via process_ozy_byte)
+  // (via process_ozy_frame)
   //
   // add_iq_samples   ==> RX engine(s)
   // add_mic_sample   ==> TX engine
@@ -1579,9 +1607,8 @@ static gpointer process_ozy_input_buffer_thread(gpointer arg) {
     st_rxfdbk = rx_feedback_channel();
     st_txfdbk = tx_feedback_channel();
 
-    for (int i = 0; i < 1024; i++) {
-      process_ozy_byte(RXRINGBUF[rxring_outptr + i] & 0xFF);
-    }
+    process_ozy_frame(&RXRINGBUF[rxring_outptr]);
+    process_ozy_frame(&RXRINGBUF[rxring_outptr + OZY_BUFFER_SIZE]);
 
     MEMORY_BARRIER;
     rxring_outptr = nptr;
@@ -1590,55 +1617,73 @@ static gpointer process_ozy_input_buffer_thread(gpointer arg) {
   return NULL;
 }
 
-void old_protocol_audio_samples(short left_audio_sample, short right_audio_sample) {
-  ASSERT_SERVER();
-
-  if (!radio_is_transmitting()) {
-    pthread_mutex_lock(&audio_mutex);
+//
+// Put n samples into the TX ring buffer. Each sample occupies 8 bytes:
+// L/R audio and I/Q, each 16-bit big endian. For audio (iq == NULL), the
+// I/Q part is zero. For TX IQ samples (audio == NULL), the audio part
+// carries the side tone (if side != NULL).
+// The samples are packed in chunks up to the next packet boundary, so the
+// inner loop is free of bookkeeping.
+// Must be called with audio_mutex held.
+//
+static void txring_put(const short *audio, const int *iq, const int *side, int n) {
+  //
+  // The HL2 makes no use of audio samples, but instead
+  // uses them to write to extended addrs which we do not
+  // want to do un-intentionally, therefore send zeros.
+  // Note special variants of the HL2 *do* have an audio codec!
+  //
+  int zero_audio = (device == DEVICE_HERMES_LITE2 && !hl2_audio_codec);
+  //
+  // The "CWX" method in the HL2 firmware behaves erroneously
+  // if the CW input from the KEY/PTT jack is activated.
+  // To make piHPSDR immune to this problem, the least significant
+  // bit of the I (and Q) samples are cleared.
+  // The resolution of the IQ samples is thus reduced from 16 to 15 bits,
+  // but since the HL2 DAC is 12-bit this is no problem.
+  //
+  int lsb_mask = (device == DEVICE_HERMES_LITE2) ? 0xFE : 0xFF;
+  int k = 0;
 
+  while (k < n) {
     if (txring_count < 0) {
-      txring_count++;
-      pthread_mutex_unlock(&audio_mutex);
-      return;
+      // skip samples after an overflow
+      int skip = MIN(n - k, -txring_count);
+      txring_count += skip;
+      k += skip;
+      continue;
     }
 
-    if (txring_flag) {
-      //
-      // First time we arrive here after a TX->RX transition:
-      // set the "drain" flag, wait 5 msec, clear it
-      // This should drain the txiq ring buffer
-      //
-      txring_drain = 1;
-      usleep(5000);
-      txring_drain = 0;
-      txring_flag = 0;
-    }
+    int chunk = MIN(n - k, 126 - txring_count);
+    unsigned char *p = &TXRINGBUF[txring_inptr + 8 * txring_count];
 
-    int iptr = txring_inptr + 8 * txring_count;
+    for (int j = k; j < k + chunk; j++, p += 8) {
+      int left, right, isample, qsample;
 
-    //
-    // The HL2 makes no use of audio samples, but instead
-    // uses them to write to extended addrs which we do not
-    // want to do un-intentionally, therefore send zeros.
-    // Note special variants of the HL2 *do* have an audio codec!
-    //
-    if (device == DEVICE_HERMES_LITE2 && !hl2_audio_codec) {
-      TXRINGBUF[iptr++] = 0;
-      TXRINGBUF[iptr++] = 0;
-      TXRINGBUF[iptr++] = 0;
-      TXRINGBUF[iptr++] = 0;
-    } else {
-      TXRINGBUF[iptr++] = left_audio_sample >> 8;
-      TXRINGBUF[iptr++] = left_audio_sample;
-      TXRINGBUF[iptr++] = right_audio_sample >> 8;
-      TXRINGBUF[iptr++] = right_audio_sample;
+      if (iq != NULL) {
+        left = right = side ? side[j] : 0;
+        isample = iq[2 * j];
+        qsample = iq[2 * j + 1];
+      } else {
+        left = audio[2 * j];
+        right = audio[2 * j + 1];
+        isample = qsample = 0;
+      }
+
+      if (zero_audio) { left = right = 0; }
+
+      p[0] = left >> 8;
+      p[1] = left;
+      p[2] = right >> 8;
+      p[3] = right;
+      p[4] = isample >> 8;
+      p[5] = isample & lsb_mask;
+      p[6] = qsample >> 8;
+      p[7] = qsample & lsb_mask;
     }
 
-    TXRINGBUF[iptr++] = 0;
-    TXRINGBUF[iptr++] = 0;
-    TXRINGBUF[iptr++] = 0;
-    TXRINGBUF[iptr++] = 0;
-    txring_count++;
+    k += chunk;
+    txring_count += chunk;
 
     if (txring_count >= 126) {
       int nptr = txring_inptr + 1008;
@@ -1658,23 +1703,44 @@ void old_protocol_audio_samples(short left_audio_sample, short right_audio_sampl
         txring_count = -1260;
       }
     }
+  }
+}
+
+//
+// n stereo audio samples (interleaved L/R) from the active receiver
+//
+void old_protocol_audio_block(const short *audio, int n) {
+  ASSERT_SERVER();
+
+  if (!radio_is_transmitting()) {
+    pthread_mutex_lock(&audio_mutex);
+
+    if (txring_flag) {
+      //
+      // First time we arrive here after a TX->RX transition:
+      // set the "drain" flag, wait 5 msec, clear it
+      // This should drain the txiq ring buffer
+      //
+      txring_drain = 1;
+      usleep(5000);
+      txring_drain = 0;
+      txring_flag = 0;
+    }
 
+    txring_put(audio, NULL, NULL, n);
     pthread_mutex_unlock(&audio_mutex);
   }
 }
 
-void old_protocol_iq_samples(int isample, int qsample, int side) {
+//
+// n TX IQ samples (interleaved I/Q), plus the side tone (may be NULL)
+//
+void old_protocol_iq_block(const int *iq, const int *side, int n) {
   ASSERT_SERVER();
 
   if (radio_is_transmitting()) {
     pthread_mutex_lock(&audio_mutex);
 
-    if (txring_count < 0) {
-      txring_count++;
-      pthread_mutex_unlock(&audio_mutex);
-      return;
-    }
-
     if (!txring_flag) {
       //
       // First time we arrive here after a RX->TX transition:
@@ -1688,67 +1754,7 @@ void old_protocol_iq_samples(int isample, int qsample, int side) {
       txring_flag = 1;
     }
 
-    int iptr = txring_inptr + 8 * txring_count;
-
-    //
-    // The HL2 makes no use of audio samples, but instead
-    // uses them to write to extended addrs which we do not
-    // want to do un-intentionally, therefore send zeros.
-    // Note special variants of the HL2 *do* have an audio codec!
-    //
-    if (device == DEVICE_HERMES_LITE2 && !hl2_audio_codec) {
-      TXRINGBUF[iptr++] = 0;
-      TXRINGBUF[iptr++] = 0;
-      TXRINGBUF[iptr++] = 0;
-      TXRINGBUF[iptr++] = 0;
-    } else {
-      TXRINGBUF[iptr++] = side  >> 8;
-      TXRINGBUF[iptr++] = side;
-      TXRINGBUF[iptr++] = side >> 8;
-      TXRINGBUF[iptr++] = side;
-    }
-
-    if (device == DEVICE_HERMES_LITE2) {
-      //
-      // The "CWX" method in the HL2 firmware behaves erroneously
-      // if the CW input from the KEY/PTT jack is activated.
-      // To make piHPSDR immune to this problem, the least significant
-      // bit of the I (and Q) samples are cleared.
-      // The resolution of the IQ samples is thus reduced from 16 to 15 bits,
-      // but since the HL2 DAC is 12-bit this is no problem.
-      //
-      TXRINGBUF[iptr++] = isample >> 8;
-      TXRINGBUF[iptr++] = isample & 0xFE;
-      TXRINGBUF[iptr++] = qsample >> 8;
-      TXRINGBUF[iptr++] = qsample & 0xFE;
-    } else {
-      TXRINGBUF[iptr++] = isample >> 8;
-      TXRINGBUF[iptr++] = isample;
-      TXRINGBUF[iptr++] = qsample >> 8;
-      TXRINGBUF[iptr++] = qsample;
-    }
-
-    txring_count++;
-
-    if (txring_count >= 126) {
-      int nptr = txring_inptr + 1008;
-
-      if (nptr >= TXRINGBUFLEN) { nptr = 0; }
-
-      if (nptr != txring_outptr) {
-#ifdef __APPLE__
-        sem_post(txring_sem);
-#else
-        sem_post(&txring_sem);
-#endif
-        txring_inptr = nptr;
-        txring_count = 0;
-      } else {
-        t_print("%s: output buffer overflow.\n", __FUNCTION__);
-        txring_count = -1260;
-      }
-    }
-
+    txring_put(NULL, iq, side, n);
     pthread_mutex_unlock(&audio_mutex);
   }
 }
@@ -2787,7 +2793,7 @@ static void ozyusb_write(unsigned char* buffer) {
 static void metis_write(unsigned char ep, unsigned const char* buffer) {
   ASSERT_SERVER();
   int i;
-  static unsigned char metis_buffer[1032];
+  static unsigned char metis_buffer[METIS_PACKET_SIZE];
 
   //
   // This alternately fill the data from buffer into the lower or upper half
@@ -2810,7 +2816,13 @@ static void metis_write(unsigned char ep, unsigned const char* buffer) {
     metis_buffer[6] = (send_sequence >> 8) & 0xFF;
     metis_buffer[7] = (send_sequence) & 0xFF;
     send_sequence++;
-    metis_send_buffer(metis_buffer, 1032);
+
+    if (metis_batching && metis_batch_count < P1_SEND_BATCH) {
+      memcpy(metis_batch[metis_batch_count++], metis_buffer, METIS_PACKET_SIZE);
+    } else {
+      metis_send_buffer(metis_buffer, METIS_PACKET_SIZE);
+    }
+
     metis_offset = 8;
   }
 }
@@ -2866,7 +2878,7 @@ void old_protocol_run() {
     //
     metis_start_stop(1);      // sends METIS start packet
 
-    if (metis_read(buffer, 1032)  ==  0) { break; }  // valid packet received
+    if (metis_read(buffer, METIS_PACKET_SIZE)  ==  0) { break; }  // valid packet received
 
     usleep(20000);
   }
@@ -2958,3 +2970,51 @@ static void metis_send_buffer(const unsigned char* buffer, int length) {
     g_idle_add(fatal_error, "FATAL: P1 neither UDP nor TCP socket available");
   }
 }
+
+static void metis_send_batch() {
+  ASSERT_SERVER();
+  int i = 0;
+
+  //
+  // Send the METIS packets collected in metis_batch. With UDP, use
+  // a single sendmmsg() call if possible. If sendmmsg() is not
+  // available (ENOSYS), fall back to sending packet by packet for good.
+  //
+#ifdef __linux__
+
+  if (p1_use_sendmmsg && tcp_socket < 0 && data_socket >= 0 && metis_batch_count > 1) {
+    struct mmsghdr msgs[P1_SEND_BATCH];
+    struct iovec iovecs[P1_SEND_BATCH];
+    int rc;
+    memset(msgs, 0, sizeof(msgs));
+
+    for (int j = 0; j < metis_batch_count; j++) {
+      iovecs[j].iov_base = metis_batch[j];
+      iovecs[j].iov_len = METIS_PACKET_SIZE;
+      msgs[j].msg_hdr.msg_iov = &iovecs[j];
+      msgs[j].msg_hdr.msg_iovlen = 1;
+      msgs[j].msg_hdr.msg_name = &data_addr;
+      msgs[j].msg_hdr.msg_namelen = sizeof(data_addr);
+    }
+
+    rc = sendmmsg(data_socket, msgs, metis_batch_count, 0);
+
+    if (rc >= 0) {
+      i = rc;
+    } else if (errno == ENOSYS) {
+      t_print("%s: sendmmsg not available, using sendto\n", __FUNCTION__);
+      p1_use_sendmmsg = 0;
+    } else {
+      t_print("%s: UDP sendmmsg failed: %d: %s\n", __FUNCTION__, errno, strerror(errno));
+      i = metis_batch_count;
+    }
+  }
+
+#endif
+
+  for (; i < metis_batch_count; i++) {
+    metis_send_buffer(metis_batch[i], METIS_PACKET_SIZE);
+  }
+
+  metis_batch_count = 0;
+}
@@ -52,43 +52,17 @@ AUDIO_DEVICE input_devices[MAX_AUDIO_DEVICES];
 AUDIO_DEVICE output_devices[MAX_AUDIO_DEVICES];
 
 //
-// We now use callback functions to provide the "headphone" audio data,
-// and therefore can control the latency.
-// RX audio samples are put into a ring buffer and "fetched" therefreom
-// by the portaudio "headphone" callback.
+// We use callback functions to provide the "headphone" audio data
+// and to receive the mic samples. The callbacks are the consumers
+// (output) and producers (input) of the ring buffers of the audio
+// engine (audio_engine.c), which also does the RX audio drift compensation
+// and the CW side tone latency management.
 //
-// We choose a ring buffer of 9600 (stereo) samples that is kept about half-full
-// during RX (latency: 0.1 sec) which should be more than enough.
-// If the buffer falls below 1800, half a buffer length of silence is
-// inserted. This usually only happens after TX/RX transitions
-//
-// During TX (no duplex), tx_audio_write() is called. If it is called for
-// the first time with a non-zero sidetone volume,
-// the ring buffer is cleared and only few (stereo) samples of silence
-// are put into it. This is probably the minimum amount necessary to avoid
-// audio underruns which manifest themselves as ugly cracks in the side ton.
-// During the TX phase, the buffer filling is kept between two rather low
-// water marks to ensure the small CW sidetone latency is kept.
-// If we then go to RX again a "low water mark" condition is detected in the
-// first call to audio_write() and half a buffer length of silence is inserted
-// again.
 // Of course, a small portaudio audio buffer size (128 samples) helps
-// keeping the latency small. With the CW low/high water marks of 192/320
-// I have achieved a latency of about 15 msec on a Macintosh.
-// One can go smaller but this increases the probabilities of audio cracks
-// from buffer underruns.
-//
-// Experiments indicate that we can indeed keep the ring buffer about half filling
-// during RX and quite empty during CW-TX.
-//
+// keeping the latency small.
 //
 
 #define MY_AUDIO_BUFFER_SIZE  128
-#define MY_RING_BUFFER_SIZE  9600
-#define MY_RING_LOW_WATER     512
-#define MY_RING_HIGH_WATER   9000
-#define MY_CW_LOW_WATER       192
-#define MY_CW_HIGH_WATER      320
 
 //
 // AUDIO_GET_CARDS
@@ -121,7 +95,7 @@ void audio_get_cards() {
     inputParameters.suggestedLatency = 0; /* ignored by Pa_IsFormatSupported() */
     inputParameters.hostApiSpecificStreamInfo = NULL;
 
-    if (Pa_IsFormatSupported(&inputParameters, NULL, 48000.0) == paFormatIsSupported) {
+    if (Pa_IsFormatSupported(&inputParameters, NULL, (double) AUDIO_RATE) == paFormatIsSupported) {
       if (n_input_devices < MAX_AUDIO_DEVICES) {
         //
         // probably not necessary with portaudio, but to be on the safe side,
@@ -143,7 +117,7 @@ void audio_get_cards() {
     outputParameters.suggestedLatency = 0; /* ignored by Pa_IsFormatSupported() */
     outputParameters.hostApiSpecificStreamInfo = NULL;
 
-    if (Pa_IsFormatSupported(NULL, &outputParameters, 48000.0) == paFormatIsSupported) {
+    if (Pa_IsFormatSupported(NULL, &outputParameters, (double) AUDIO_RATE) == paFormatIsSupported) {
       if (n_output_devices < MAX_AUDIO_DEVICES) {
         output_devices[n_output_devices].name = g_strdup(deviceInfo->name);
         output_devices[n_output_devices].description = g_strdup(deviceInfo->name);
@@ -200,7 +174,7 @@ int audio_open_input(TRANSMITTER *tx) {
   inputParameters.sampleFormat = paFloat32;
   inputParameters.suggestedLatency = Pa_GetDeviceInfo(padev)->defaultLowInputLatency ;
   inputParameters.hostApiSpecificStreamInfo = NULL; //See you specific host's API docs for info on using this field
-  err = Pa_OpenStream(&tx->audio_handle, &inputParameters, NULL, 48000.0, MY_AUDIO_BUFFER_SIZE,
+  err = Pa_OpenStream(&tx->audio_handle, &inputParameters, NULL, (double) AUDIO_RATE, MY_AUDIO_BUFFER_SIZE,
                       paNoFlag, pa_in_cb, tx);
 
   if (err != paNoError) {
@@ -210,25 +184,15 @@ int audio_open_input(TRANSMITTER *tx) {
     return -1;
   }
 
-  tx->audio_buffer = (float *) g_new(float, MY_RING_BUFFER_SIZE);
-  tx->audio_buffer_outpt = tx->audio_buffer_inpt = 0;
-
-  if (tx->audio_buffer == NULL) {
-    Pa_CloseStream(tx->audio_handle);
-    tx->audio_handle = NULL;
-    t_print("%s: alloc buffer failed.\n", __FUNCTION__);
-    g_mutex_unlock(&tx->audio_mutex);
-    return -1;
-  }
-
+  tx->audio_ring = audio_ring_new(AUDIO_MIC_RING_SIZE, 1, 0);
   err = Pa_StartStream(tx->audio_handle);
 
   if (err != paNoError) {
     t_print("%s: start stream error %s\n", __FUNCTION__, Pa_GetErrorText(err));
     Pa_CloseStream(tx->audio_handle);
     tx->audio_handle = NULL;
-    g_free(tx->audio_buffer);
-    tx->audio_buffer = NULL;
+    audio_ring_free(tx->audio_ring);
+    tx->audio_ring = NULL;
     g_mutex_unlock(&tx->audio_mutex);
     return -1;
   }
@@ -255,34 +219,17 @@ static int pa_out_cb(const void *inputBuffer, void *outputBuffer, unsigned long
     return paContinue;
   }
 
-  g_mutex_lock(&rx->audio_mutex);
+  //
+  // No mutex: audio_close_output() stops the stream
+  // before the ring buffer is destroyed
+  //
+  audio_ring_set_delay(rx->audio_ring, (int) (AUDIO_RATE * (timeInfo->outputBufferDacTime - timeInfo->currentTime)));
+  audio_ring_read(rx->audio_ring, out, framesPerBuffer);
 
-  if (rx->audio_buffer != NULL) {
-    //
-    // Mutex protection: if the buffer is non-NULL it cannot vanish
-    // util callback is completed
-    //
-    int newpt = rx->audio_buffer_outpt;
-
-    for (unsigned int i = 0; i < framesPerBuffer; i++) {
-      if (rx->audio_buffer_inpt == newpt) {
-        // Ring buffer empty, send zero sample
-        *out++ = 0.0;
-        *out++ = 0.0;
-      } else {
-        *out++ = rx->audio_buffer[2 * newpt];
-        *out++ = rx->audio_buffer[2 * newpt + 1];
-        newpt++;
-
-        if (newpt >= MY_RING_BUFFER_SIZE) { newpt = 0; }
-
-        MEMORY_BARRIER;
-        rx->audio_buffer_outpt = newpt;
-      }
-    }
+  if (statusFlags & paOutputUnderflow) {
+    audio_ring_underrun(rx->audio_ring);
   }
 
-  g_mutex_unlock(&rx->audio_mutex);
   return paContinue;
 }
 
@@ -303,103 +250,13 @@ static int pa_in_cb(const void *inputBuffer, void *outputBuffer, unsigned long f
   }
 
   //
-  // If we are a client, simply collect and transfer data
-  // to the server without any buffering
+  // No mutex: audio_close_input() stops the stream
+  // before the ring buffer is destroyed
   //
-  if (radio_is_remote) {
-    for (unsigned int i = 0; i < framesPerBuffer; i++) {
-      short sample = in[i] * 32768.0;
-      server_tx_audio(sample);
-    }
-
-    return paContinue;
-  }
-
-  g_mutex_lock(&tx->audio_mutex);
-
-  if (tx->audio_buffer != NULL) {
-    //
-    // mutex protected: ring buffer cannot vanish
-    //
-    // Normally there is a slight mis-match between the 48kHz sample
-    // rate of the audio input device and the 48kHz rate of the
-    // HPSDR device. Thus, the mic buffer tends to either slowly
-    // drain or slowly become full (which leads to large TX delays).
-    //
-    // The TX/RX transition seems to be the best moment to "reset"
-    // the mic input buffer, and fill it with a little bit (20 msec)
-    // of silence and the current batch of mic samples. During normal
-    // RX operation, one cannot fiddle around with the mic samples since
-    // VOX might be active.
-    //
-    // tx->audio_flag is used to "detect" the TX/RX transition.
-    //
-    //
-    if (!radio_is_transmitting()) {
-      if (tx->audio_flag) {
-        tx->audio_flag = 0;
-        tx->audio_buffer_outpt = 0;
-        tx->audio_buffer_inpt  = 960;
-        bzero(tx->audio_buffer, 960 * sizeof(float));
-      }
-    } else {
-      tx->audio_flag = 1;
-    }
-
-    for (unsigned int i = 0; i < framesPerBuffer; i++) {
-      //
-      // put sample into ring buffer
-      //
-      int newpt = tx->audio_buffer_inpt + 1;
-
-      if (newpt == MY_RING_BUFFER_SIZE) { newpt = 0; }
-
-      if (newpt != tx->audio_buffer_outpt) {
-        MEMORY_BARRIER;
-        // buffer space available, do the write
-        tx->audio_buffer[tx->audio_buffer_inpt] = in[i];
-        MEMORY_BARRIER;
-        // atomic update of tx->audio_buffer_inpt
-        tx->audio_buffer_inpt = newpt;
-      }
-    }
-  }
-
-  g_mutex_unlock(&tx->audio_mutex);
+  audio_mic_put(tx, in, framesPerBuffer);
   return paContinue;
 }
 
-//
-// Utility function for retrieving mic samples
-// from ring buffer
-//
-float audio_get_next_mic_sample(TRANSMITTER *tx) {
-  float sample;
-  g_mutex_lock(&tx->audio_mutex);
-
-  //
-  // mutex protected (for every single sample!):
-  // ring buffer cannot vanish while being processed here
-  //
-  if ((tx->audio_buffer == NULL) || (tx->audio_buffer_outpt == tx->audio_buffer_inpt)) {
-    // no buffer, or nothing in buffer: insert silence
-    sample = 0.0;
-  } else {
-    int newpt = tx->audio_buffer_outpt + 1;
-
-    if (newpt == MY_RING_BUFFER_SIZE) { newpt = 0; }
-
-    MEMORY_BARRIER;
-    sample = tx->audio_buffer[tx->audio_buffer_outpt];
-    // atomic update of read pointer
-    MEMORY_BARRIER;
-    tx->audio_buffer_outpt = newpt;
-  }
-
-  g_mutex_unlock(&tx->audio_mutex);
-  return sample;
-}
-
 //
 // AUDIO_OPEN_OUTPUT
 //
@@ -437,10 +294,9 @@ int audio_open_output(RECEIVER *rx) {
   outputParameters.device = padev;
   outputParameters.hostApiSpecificStreamInfo = NULL;
   outputParameters.sampleFormat = paFloat32;
-  // use a zero for the latency to get the minimum value
-  outputParameters.suggestedLatency = 0.0; //Pa_GetDeviceInfo(padev)->defaultLowOutputLatency ;
+  outputParameters.suggestedLatency = 0.001 * AUDIO_DEVICE_LATENCY;
   outputParameters.hostApiSpecificStreamInfo = NULL; //See you specific host's API docs for info on using this field
-  err = Pa_OpenStream(&(rx->audio_handle), NULL, &outputParameters, 48000.0, MY_AUDIO_BUFFER_SIZE,
+  err = Pa_OpenStream(&(rx->audio_handle), NULL, &outputParameters, (double) AUDIO_RATE, MY_AUDIO_BUFFER_SIZE,
                       paNoFlag, pa_out_cb, rx);
 
   if (err != paNoError) {
@@ -450,29 +306,15 @@ int audio_open_output(RECEIVER *rx) {
     return -1;
   }
 
-  //
-  // This is now a ring buffer much larger than a single audio buffer
-  //
-  rx->audio_buffer = g_new(float, 2 * MY_RING_BUFFER_SIZE);
-  rx->audio_buffer_inpt = 0;
-  rx->audio_buffer_outpt = 0;
-
-  if (rx->audio_buffer == NULL) {
-    t_print("%s: allocate buffer failed\n", __FUNCTION__);
-    Pa_CloseStream(rx->audio_handle);
-    rx->audio_handle = NULL;
-    g_mutex_unlock(&rx->audio_mutex);
-    return -1;
-  }
-
+  rx->audio_ring = audio_ring_new(AUDIO_OUT_RING_SIZE, 2, 1);
   err = Pa_StartStream(rx->audio_handle);
 
   if (err != paNoError) {
     t_print("%s: error starting stream:%s\n", __FUNCTION__, Pa_GetErrorText(err));
     Pa_CloseStream(rx->audio_handle);
     rx->audio_handle = NULL;
-    g_free(rx->audio_buffer);
-    rx->audio_buffer = NULL;
+    audio_ring_free(rx->audio_ring);
+    rx->audio_ring = NULL;
     g_mutex_unlock(&rx->audio_mutex);
     return -1;
   }
@@ -511,9 +353,9 @@ void audio_close_input(TRANSMITTER *tx) {
     tx->audio_handle = NULL;
   }
 
-  if (tx->audio_buffer != NULL) {
-    g_free(tx->audio_buffer);
-    tx->audio_buffer = NULL;
+  if (tx->audio_ring != NULL) {
+    audio_ring_free(tx->audio_ring);
+    tx->audio_ring = NULL;
   }
 
   g_mutex_unlock(&tx->audio_mutex);
@@ -528,11 +370,6 @@ void audio_close_output(RECEIVER *rx) {
   t_print("%s: RX%d:%s\n", __FUNCTION__, rx->id + 1, rx->audio_name);
   g_mutex_lock(&rx->audio_mutex);
 
-  if (rx->audio_buffer != NULL) {
-    g_free(rx->audio_buffer);
-    rx->audio_buffer = NULL;
-  }
-
   if (rx->audio_handle != NULL) {
     PaError err = Pa_StopStream(rx->audio_handle);
 
@@ -549,232 +386,16 @@ void audio_close_output(RECEIVER *rx) {
     rx->audio_handle = NULL;
   }
 
-  g_mutex_unlock(&rx->audio_mutex);
-}
-
-//
-// AUDIO_WRITE
-//
-// send RX audio data to a PA output stream
-// we have to store the data such that the PA callback function
-// can access it.
-//
-// Note that the check on radio_is_transmitting() takes care that "blocking"
-// by the mutex can only occur in the moment of a RX/TX transition if
-// both audio_write() and tx_audio_write() get a "go".
-//
-// So mutex locking/unlocking should only cost few CPU cycles in
-// normal operation.
-//
-int audio_write (RECEIVER *rx, float left, float right) {
-  float *buffer = rx->audio_buffer;
-
   //
-  // If transmitting without duplex, quickly return
+  // The stream has been stopped, so the ring buffer can no
+  // longer be accessed in the callback
   //
-  if (rx == active_receiver && radio_is_transmitting() && !duplex) { return 0; }
-
-  g_mutex_lock(&rx->audio_mutex);
-  rx->cwaudio = 0;
-
-  if (rx->audio_handle != NULL && buffer != NULL) {
-    int avail = rx->audio_buffer_inpt - rx->audio_buffer_outpt;
-
-    if (avail < 0) { avail += MY_RING_BUFFER_SIZE; }
-
-    if (avail <  MY_RING_LOW_WATER) {
-      //
-      // Running the RX-audio for a very long time
-      // and with audio hardware whose "48000 Hz" are a little faster than the "48000 Hz" of
-      // the SDR will very slowly drain the buffer. We recover from this by brutally
-      // inserting half a buffer's length of silence.
-      //
-      // This is not always an "error" to be reported and necessarily happens in three cases:
-      //  a) we come here for the first time
-      //  b) we come from a TX/RX transition in non-CW mode, and no duplex
-      //  c) we come from a TX/RX transition in CW mode
-      //
-      // In case a) and b) the buffer will be empty, in c) the buffer will contain "few" samples
-      // because of the "CW audio low latency" strategy.
-      //
-      int oldpt = rx->audio_buffer_inpt;
-
-      for (int i = 0; i < MY_RING_BUFFER_SIZE / 2 - avail; i++) {
-        buffer[2 * oldpt] = 0.0;
-        buffer[2 * oldpt + 1] = 0.0;
-        oldpt++;
-
-        if (oldpt >= MY_RING_BUFFER_SIZE) { oldpt = 0; }
-      }
-
-      MEMORY_BARRIER;
-      rx->audio_buffer_inpt = oldpt;
-      //t_print("%s: buffer was nearly empty, inserted silence.\n", __FUNCTION__);
-    }
-
-    if (avail > MY_RING_HIGH_WATER) {
-      //
-      // Running the RX-audio for a very long time
-      // and with audio hardware whose "48000 Hz" are a little slower than the "48000 Hz" of
-      // the SDR will very slowly fill the buffer. This should be the only situation where
-      // this "buffer overrun" condition should occur. We recover from this by brutally
-      // deleting half a buffer size of audio, such that the next overrun is in the distant
-      // future.
-      //
-      int oldpt = rx->audio_buffer_inpt - avail + MY_RING_BUFFER_SIZE / 2;
-
-      if (oldpt < 0) { oldpt += MY_RING_BUFFER_SIZE; }
-
-      rx->audio_buffer_inpt = oldpt;
-      //t_print("%s: buffer was nearly full, deleted audio\n", __FUNCTION__);
-    }
-
-    //
-    // put sample into ring buffer
-    //
-    int oldpt = rx->audio_buffer_inpt;
-    int newpt = oldpt + 1;
-
-    if (newpt == MY_RING_BUFFER_SIZE) { newpt = 0; }
-
-    if (newpt != rx->audio_buffer_outpt) {
-      //
-      // buffer space available
-      //
-      MEMORY_BARRIER;
-      buffer[2 * oldpt] = left;
-      buffer[2 * oldpt + 1] = right;
-      MEMORY_BARRIER;
-      rx->audio_buffer_inpt = newpt;
-    }
+  if (rx->audio_ring != NULL) {
+    audio_ring_free(rx->audio_ring);
+    rx->audio_ring = NULL;
   }
 
   g_mutex_unlock(&rx->audio_mutex);
-  return 0;
-}
-
-//
-// Since the main use of tx_audio_write() is to produce a CW side tone,
-// do active latency (buffer filling) management:
-// During CW, between the elements the side tone contain "true" silence.
-// We detect a sequence of 16 subsequent zero samples, and insert or delete
-// a zero sample depending on the buffer water mark:
-// If there are more than two portaudio buffers available, delete one sample,
-// if it drops down to less than one portaudio buffer, insert one sample
-//
-int tx_audio_write(RECEIVER *rx, float sample) {
-  g_mutex_lock(&rx->audio_mutex);
-
-  if (rx->audio_handle != NULL && rx->audio_buffer != NULL) {
-    int oldpt, newpt;
-    int avail = rx->audio_buffer_inpt - rx->audio_buffer_outpt;
-    int adjust = 0;
-
-    if (avail < 0) { avail += MY_RING_BUFFER_SIZE; }
-
-    if (rx->cwaudio == 0) {
-      //
-      // First time producing CW audio after RX/TX transition:
-      // keep the oldest samples (until MY_CW_LOW_WATER) in the audio buffer
-      // and discard the rest. Apply a down-slew on the samples
-      // kept.
-      //
-      double damp = 1.000;
-      newpt = rx->audio_buffer_outpt;
-      for (int i = 0; i < MY_CW_LOW_WATER; i++) {
-        if (i >= avail) {
-          rx->audio_buffer[2 * newpt] = 0;
-          rx->audio_buffer[2 * newpt + 1] = 0;
-        } else {
-          rx->audio_buffer[2 * newpt] *= damp;
-          rx->audio_buffer[2 * newpt + 1] *= damp;
-          damp = damp * 0.975;
-        }
-        newpt++;
-
-        MEMORY_BARRIER;
-        if (newpt >= MY_RING_BUFFER_SIZE) { newpt = 0; }
-      }
-      rx->audio_buffer_inpt = newpt;
-      MEMORY_BARRIER;
-      avail = MY_CW_LOW_WATER;
-      rx->cwcount = 0;
-      rx->cwaudio = 1;
-    }
-
-    if (sample != 0.0) { rx->cwcount = 0; }
-
-    if (++rx->cwcount >= 16) {
-      rx->cwcount = 0;
-
-      //
-      // We arrive here if we have seen 16 zero samples in a row.
-      //
-      if (avail > MY_CW_HIGH_WATER) { adjust = 2; } // full: we are above high water mark
-
-      if (avail < MY_CW_LOW_WATER ) { adjust = 1; } // low: we are below low water mark
-    }
-
-    switch (adjust) {
-    case 0:
-      //
-      // default case:
-      //               put sample into ring buffer.
-      //               since the side tone is mono put it into
-      //               both the left and right channel with the
-      //               same phase.
-      //
-      oldpt = rx->audio_buffer_inpt;
-      newpt = oldpt + 1;
-
-      if (newpt == MY_RING_BUFFER_SIZE) { newpt = 0; }
-
-      if (newpt != rx->audio_buffer_outpt) {
-        //
-        // buffer space available
-        //
-        MEMORY_BARRIER;
-        rx->audio_buffer[2 * oldpt] = sample;
-        rx->audio_buffer[2 * oldpt + 1] = sample;
-        MEMORY_BARRIER;
-        rx->audio_buffer_inpt = newpt;
-      }
-
-      break;
-
-    case 1:
-      //
-      // we just saw 16 samples of silence and buffer filling is low:
-      // insert one extra silence sample
-      //
-      oldpt = rx->audio_buffer_inpt;
-      rx->audio_buffer[2 * oldpt] = 0.0;
-      rx->audio_buffer[2 * oldpt + 1] = 0.0;
-      oldpt++;
-
-      if (oldpt == MY_RING_BUFFER_SIZE) { oldpt = 0; }
-
-      rx->audio_buffer[2 * oldpt] = 0.0;
-      rx->audio_buffer[2 * oldpt + 1] = 0.0;
-      oldpt++;
-
-      if (oldpt == MY_RING_BUFFER_SIZE) { oldpt = 0; }
-
-      MEMORY_BARRIER;
-      rx->audio_buffer_inpt = oldpt;
-      break;
-
-    case 2:
-      //
-      // we just saw 16 samples of silence and buffer filling is high:
-      // just skip the current "silent" sample, that is, do nothing.
-      //
-      break;
-    }
-  }
-
-  g_mutex_unlock(&rx->audio_mutex);
-  return 0;
 }
 
 #endif
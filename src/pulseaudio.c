@@ -32,25 +32,16 @@
 #include "vfo.h"
 
 //
-// Latency management:
-// Note latency is higher than for ALSA so no special CW optimisation here.
+// Audio output:
 //
-// AUDIO_LAT_HIGH         If this latency is exceeded, audio output is stopped
-// AUDIO_LAT_LOW          If latency is below this, audio output is resumed
+// The DSP thread never talks to the sound server. The audio engine
+// (audio_engine.c) puts the RX audio and the CW side tone into a ring
+// buffer. The PulseAudio stream is run asynchronously from a threaded
+// main loop, and its write callback pulls the samples out of the ring.
+// The drift compensation of the audio engine keeps the ring filling,
+// and thus the latency, constant.
 //
 
-#define AUDIO_LAT_HIGH    500000
-#define AUDIO_LAT_LOW     250000
-
-//
-// ALSA loopback devices, when connected to digimode programs, sometimes
-// deliver audio in large chungs, so we need a large ring buffer as well
-//
-#define MICRINGLEN 6000
-
-static const int out_buffer_size = 256;
-static const int inp_buffer_size = 256;
-
 int n_input_devices;
 int n_output_devices;
 AUDIO_DEVICE input_devices[MAX_AUDIO_DEVICES];
@@ -61,6 +52,14 @@ static pa_mainloop_api *main_loop_api;
 static pa_operation *op;
 static pa_context *pa_ctx;
 
+//
+// Threaded main loop and context for the (asynchronous) output streams.
+// They are created when the first output stream is opened and then kept.
+//
+static pa_threaded_mainloop *out_loop = NULL;
+static pa_context *out_ctx = NULL;
+
+
 
 static void source_list_cb(pa_context *context, const pa_source_info *s, int eol, void *data) {
   if (eol > 0) {
@@ -143,43 +142,168 @@ void audio_get_cards() {
   pa_context_set_state_callback(pa_ctx, state_cb, NULL);
 }
 
+static void out_ctx_state_cb(pa_context *c, void *userdata) {
+  pa_threaded_mainloop_signal(out_loop, 0);
+}
+
+static void out_stream_state_cb(pa_stream *s, void *userdata) {
+  pa_threaded_mainloop_signal(out_loop, 0);
+}
+
+static void out_stream_underflow_cb(pa_stream *s, void *userdata) {
+  const RECEIVER *rx = (const RECEIVER *)userdata;
+  audio_ring_underrun(rx->audio_ring);
+}
+
+//
+// Stream write callback, executed in the threaded main loop.
+// Fetch as many blocks from the ring buffer as PulseAudio requests
+// (rounded up to full blocks). This never waits for the DSP thread:
+// if the ring buffer runs empty, silence is sent.
+//
+static void out_stream_write_cb(pa_stream *s, size_t nbytes, void *userdata) {
+  const RECEIVER *rx = (const RECEIVER *)userdata;
+  float data[2 * AUDIO_BLOCK];
+  const size_t blockbytes = sizeof(data);
+  pa_usec_t latency;
+  int negative;
+
+  if (pa_stream_get_latency(s, &latency, &negative) == 0) {
+    audio_ring_set_delay(rx->audio_ring, negative ? 0 : (int) (latency * AUDIO_RATE / 1000000));
+  }
+
+  for (size_t written = 0; written < nbytes; written += blockbytes) {
+    audio_ring_read(rx->audio_ring, data, AUDIO_BLOCK);
+
+    if (pa_stream_write(s, data, blockbytes, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+      t_print("%s: ERROR pa_stream_write: %s\n", __FUNCTION__, pa_strerror(pa_context_errno(out_ctx)));
+      break;
+    }
+  }
+}
+
+//
+// Create the threaded main loop and connect its context.
+// Must be called with the main loop locked (if it exists).
+//
+static int out_ctx_connect() {
+  if (out_ctx != NULL) {
+    if (pa_context_get_state(out_ctx) == PA_CONTEXT_READY) { return 0; }
+
+    // context has died, e.g. because the sound server was restarted
+    pa_context_disconnect(out_ctx);
+    pa_context_unref(out_ctx);
+    out_ctx = NULL;
+  }
+
+  out_ctx = pa_context_new(pa_threaded_mainloop_get_api(out_loop), "piHPSDR");
+  pa_context_set_state_callback(out_ctx, out_ctx_state_cb, NULL);
+
+  if (pa_context_connect(out_ctx, NULL, 0, NULL) < 0) {
+    t_print("%s: ERROR pa_context_connect: %s\n", __FUNCTION__, pa_strerror(pa_context_errno(out_ctx)));
+    return -1;
+  }
+
+  for (;;) {
+    pa_context_state_t state = pa_context_get_state(out_ctx);
+
+    if (state == PA_CONTEXT_READY) { break; }
+
+    if (!PA_CONTEXT_IS_GOOD(state)) {
+      t_print("%s: ERROR context state %d\n", __FUNCTION__, state);
+      return -1;
+    }
+
+    pa_threaded_mainloop_wait(out_loop);
+  }
+
+  return 0;
+}
+
 int audio_open_output(RECEIVER *rx) {
   pa_sample_spec sample_spec;
-  int err;
+  pa_stream *stream = NULL;
   t_print("%s: RX%d:%s\n", __FUNCTION__, rx->id + 1, rx->audio_name);
   g_mutex_lock(&rx->audio_mutex);
-  sample_spec.rate = 48000;
+
+  if (out_loop == NULL) {
+    out_loop = pa_threaded_mainloop_new();
+
+    if (out_loop == NULL || pa_threaded_mainloop_start(out_loop) < 0) {
+      t_print("%s: ERROR could not start PA main loop\n", __FUNCTION__);
+
+      if (out_loop != NULL) {
+        pa_threaded_mainloop_free(out_loop);
+        out_loop = NULL;
+      }
+
+      g_mutex_unlock(&rx->audio_mutex);
+      return -1;
+    }
+  }
+
+  sample_spec.rate = AUDIO_RATE;
   sample_spec.channels = 2;
   sample_spec.format = PA_SAMPLE_FLOAT32NE;
+  //
+  // The ring buffer must exist before the stream is connected,
+  // since the write callback may fire immediately
+  //
+  rx->cwaudio = 0;
+  rx->cwcount = 0;
+  rx->audio_ring = audio_ring_new(AUDIO_OUT_RING_SIZE, 2, 1);
   char stream_id[16];
   snprintf(stream_id, sizeof(stream_id), "RX-%d", rx->id);
   pa_buffer_attr attr;
   attr.maxlength = (uint32_t) -1;
-  attr.tlength   = (uint32_t) -1;
+  attr.tlength   = pa_usec_to_bytes(1000 * AUDIO_DEVICE_LATENCY, &sample_spec);
   attr.prebuf    = (uint32_t) -1;
-  attr.minreq    = (uint32_t) -1;
+  attr.minreq    = AUDIO_BLOCK * pa_frame_size(&sample_spec);
   attr.fragsize  = (uint32_t) -1;
-  rx->audio_handle = pa_simple_new(NULL, // Use the default server.
-                                   "piHPSDR",          // Our application's name.
-                                   PA_STREAM_PLAYBACK,
-                                   rx->audio_name,
-                                   stream_id,          // Description of our stream.
-                                   &sample_spec,       // Our sample format.
-                                   NULL,               // Use default channel map
-                                   &attr,              // Use default attributes
-                                   &err                // error code if returns NULL
-                                  );
+  pa_threaded_mainloop_lock(out_loop);
 
-  if (rx->audio_handle == NULL) {
-    t_print("%s: ERROR pa_simple_new: %s\n", __FUNCTION__, pa_strerror(err));
+  if (out_ctx_connect() == 0) {
+    stream = pa_stream_new(out_ctx, stream_id, &sample_spec, NULL);
+  }
+
+  if (stream != NULL) {
+    pa_stream_set_state_callback(stream, out_stream_state_cb, NULL);
+    pa_stream_set_write_callback(stream, out_stream_write_cb, rx);
+    pa_stream_set_underflow_callback(stream, out_stream_underflow_cb, rx);
+
+    if (pa_stream_connect_playback(stream, rx->audio_name, &attr,
+                                   PA_STREAM_ADJUST_LATENCY | PA_STREAM_AUTO_TIMING_UPDATE,
+                                   NULL, NULL) < 0) {
+      t_print("%s: ERROR pa_stream_connect_playback: %s\n", __FUNCTION__, pa_strerror(pa_context_errno(out_ctx)));
+      pa_stream_unref(stream);
+      stream = NULL;
+    }
+  }
+
+  while (stream != NULL) {
+    pa_stream_state_t state = pa_stream_get_state(stream);
+
+    if (state == PA_STREAM_READY) { break; }
+
+    if (!PA_STREAM_IS_GOOD(state)) {
+      t_print("%s: ERROR stream state %d\n", __FUNCTION__, state);
+      pa_stream_unref(stream);
+      stream = NULL;
+    } else {
+      pa_threaded_mainloop_wait(out_loop);
+    }
+  }
+
+  pa_threaded_mainloop_unlock(out_loop);
+
+  if (stream == NULL) {
+    audio_ring_free(rx->audio_ring);
+    rx->audio_ring = NULL;
     g_mutex_unlock(&rx->audio_mutex);
     return -1;
   }
 
-  rx->cwaudio = 0;
-  rx->cwcount = 0;
-  rx->audio_buffer_offset = 0;
-  rx->audio_buffer = g_new0(float, 2 * out_buffer_size);
+  rx->audio_handle = stream;
   g_mutex_unlock(&rx->audio_mutex);
   return 0;
 }
@@ -187,54 +311,29 @@ int audio_open_output(RECEIVER *rx) {
 static void *tx_audio_thread(gpointer arg) {
   TRANSMITTER *tx = (TRANSMITTER *)arg;
   int err;
-  float *buffer = (float *) malloc(inp_buffer_size * sizeof(float));
-
-  if (!buffer) { return NULL; }
+  float buffer[AUDIO_BLOCK];
 
   while (tx->audio_running) {
     //
-    // It is guaranteed that tx->audio_buffer, and audio_handle
+    // It is guaranteed that tx->audio_ring, and audio_handle
     // will not be destroyed until this thread has terminated (and waited for via thread joining)
     //
     int rc = pa_simple_read(tx->audio_handle,
                             buffer,
-                            inp_buffer_size * sizeof(float),
+                            sizeof(buffer),
                             &err);
 
     if (rc < 0) {
       tx->audio_running = FALSE;
-      t_print("%s: ERROR pa_simple_read: %s\n", __FUNCTION__, rc, pa_strerror(err));
+      t_print("%s: ERROR pa_simple_read: %s\n", __FUNCTION__, pa_strerror(err));
     } else {
-      for (int i = 0; i < inp_buffer_size; i++) {
-        //
-        // If we are a client, simply collect and transfer data
-        // to the server without any buffering
-        //
-        if (radio_is_remote) {
-          short s = buffer[i] * 32767.0;
-          server_tx_audio(s);
-          continue;
-        }
-
-        //
-        // put sample into ring buffer
-        //
-        int newpt = tx->audio_buffer_inpt + 1;
-
-        if (newpt == MICRINGLEN) { newpt = 0; }
-
-        if (newpt != tx->audio_buffer_outpt) {
-          // buffer space available, do the write
-          tx->audio_buffer[tx->audio_buffer_inpt] = buffer[i];
-          // atomic update of tx->audio_buffer_inpt
-          tx->audio_buffer_inpt = newpt;
-        }
-      }
+      pa_usec_t latency = pa_simple_get_latency(tx->audio_handle, &err);
+      audio_ring_set_delay(tx->audio_ring, (int) (latency * AUDIO_RATE / 1000000));
+      audio_mic_put(tx, buffer, AUDIO_BLOCK);
     }
   }
 
   t_print("%s: exit\n", __FUNCTION__);
-  free(buffer);
   return NULL;
 }
 
@@ -249,7 +348,7 @@ int audio_open_input(TRANSMITTER *tx) {
   attr.prebuf = (uint32_t) -1;
   attr.minreq = (uint32_t) -1;
   attr.fragsize = 512;
-  sample_spec.rate = 48000;
+  sample_spec.rate = AUDIO_RATE;
   sample_spec.channels = 1;
   sample_spec.format = PA_SAMPLE_FLOAT32NE;
   tx->audio_handle = pa_simple_new(NULL,      // Use the default server.
@@ -265,15 +364,7 @@ int audio_open_input(TRANSMITTER *tx) {
 
   if (tx->audio_handle != NULL) {
     t_print("%s: allocating ring buffer\n", __FUNCTION__);
-    tx->audio_buffer = (float *) g_new(float, MICRINGLEN);
-    tx->audio_buffer_outpt = tx->audio_buffer_inpt = 0;
-
-    if (tx->audio_buffer == NULL) {
-      g_mutex_unlock(&tx->audio_mutex);
-      audio_close_input(tx);
-      return -1;
-    }
-
+    tx->audio_ring = audio_ring_new(AUDIO_MIC_RING_SIZE, 1, 0);
     tx->audio_running = TRUE;
     GError *error;
     tx->audio_thread_id = g_thread_try_new("TxAudioIn", tx_audio_thread, tx, &error);
@@ -298,13 +389,20 @@ void audio_close_output(RECEIVER *rx) {
   g_mutex_lock(&rx->audio_mutex);
 
   if (rx->audio_handle != NULL) {
-    pa_simple_free(rx->audio_handle);
+    //
+    // Once the stream is disconnected (with the main loop locked),
+    // the write callback will no longer access the ring buffer
+    //
+    pa_threaded_mainloop_lock(out_loop);
+    pa_stream_disconnect(rx->audio_handle);
+    pa_stream_unref(rx->audio_handle);
+    pa_threaded_mainloop_unlock(out_loop);
     rx->audio_handle = NULL;
   }
 
-  if (rx->audio_buffer != NULL) {
-    g_free(rx->audio_buffer);
-    rx->audio_buffer = NULL;
+  if (rx->audio_ring != NULL) {
+    audio_ring_free(rx->audio_ring);
+    rx->audio_ring = NULL;
   }
 
   g_mutex_unlock(&rx->audio_mutex);
@@ -330,159 +428,10 @@ void audio_close_input(TRANSMITTER *tx) {
     tx->audio_handle = NULL;
   }
 
-  if (tx->audio_buffer != NULL) {
-    g_free(tx->audio_buffer);
+  if (tx->audio_ring != NULL) {
+    audio_ring_free(tx->audio_ring);
+    tx->audio_ring = NULL;
   }
 
   g_mutex_unlock(&tx->audio_mutex);
 }
-
-//
-// Utility function for retrieving mic samples
-// from ring buffer
-//
-float audio_get_next_mic_sample(TRANSMITTER *tx) {
-  float sample;
-  g_mutex_lock(&tx->audio_mutex);
-
-  if ((tx->audio_buffer == NULL) || (tx->audio_buffer_outpt == tx->audio_buffer_inpt)) {
-    // no buffer, or nothing in buffer: insert silence
-    sample = 0.0;
-  } else {
-    int newpt = tx->audio_buffer_outpt + 1;
-
-    if (newpt == MICRINGLEN) { newpt = 0; }
-
-    sample = tx->audio_buffer[tx->audio_buffer_outpt];
-    // atomic update of read pointer
-    tx->audio_buffer_outpt = newpt;
-  }
-
-  g_mutex_unlock(&tx->audio_mutex);
-  return sample;
-}
-
-//
-// In the PulseAudio module, tx_audio_write() is essentially a copy
-// of audio_write(). Normally we would try here to "rewind" the output
-// buffer and keep it a lower filling while transmitting, but I do now
-// know whether this is possible with the "simple" API.
-//
-// In principle one can use pa_simple_flush() to flush the entire
-// output buffer, but keeping the buffer at low filling might not
-// be compatible with the buffer attributs set when creating the stream.
-//
-// So for the time being, using the internal keyer might not be
-// reasonable when running the PulseAudio module.
-//
-int tx_audio_write(RECEIVER *rx, float sample) {
-  int result = 0;
-  int err;
-  g_mutex_lock(&rx->audio_mutex);
-
-  if (rx->audio_handle != NULL && rx->audio_buffer != NULL) {
-    //
-    // Since this is mutex-protected, we know that both rx->audio_handle
-    // and rx->audio_buffer will not be destroyed until we
-    // are finished here.
-    //
-    rx->audio_buffer[rx->audio_buffer_offset * 2] = sample;
-    rx->audio_buffer[(rx->audio_buffer_offset * 2) + 1] = sample;
-    rx->audio_buffer_offset++;
-
-    if (rx->audio_buffer_offset >= out_buffer_size) {
-      pa_usec_t latency = pa_simple_get_latency(rx->audio_handle, &err);
-
-      if (latency > AUDIO_LAT_HIGH && rx->cwcount == 0) {
-        //
-        // If the radio is running a a slightly too high clock rate, or if
-        // the audio hardware clocks slightly below 48 kHz, then the PA audio
-        // buffer will fill up. suppress audio data until the latency is below
-        // AUDIO_LAT_LOW, or until a pre-calculated maximum number of output
-        // buffers has been suppressed.
-        //
-        rx->cwcount = (AUDIO_LAT_HIGH - AUDIO_LAT_LOW) / (20 * out_buffer_size);
-        t_print("%s: suppressing audio block\n", __FUNCTION__);
-      }
-
-      if (rx->cwcount > 0) {
-        rx->cwcount--;
-      }
-
-      if (rx->cwcount == 0 || latency < AUDIO_LAT_LOW) {
-        int rc = pa_simple_write(rx->audio_handle,
-                                 rx->audio_buffer,
-                                 out_buffer_size * sizeof(float) * 2,
-                                 &err);
-
-        if (rc < 0) {
-          t_print("%s: ERROR pa_simple_write: %s\n", __FUNCTION__, pa_strerror(err));
-        }
-      }
-
-      rx->audio_buffer_offset = 0;
-    }
-  }
-
-  g_mutex_unlock(&rx->audio_mutex);
-  return result;
-}
-
-int audio_write(RECEIVER *rx, float left_sample, float right_sample) {
-  int result = 0;
-  int err;
-
-  //
-  // If transmitting without duplex, quickly return
-  //
-  if (rx == active_receiver && radio_is_transmitting() && !duplex) { return 0; }
-
-  g_mutex_lock(&rx->audio_mutex);
-
-  if (rx->audio_handle != NULL && rx->audio_buffer != NULL) {
-    //
-    // Since this is mutex-protected, we know that both rx->audio_handle
-    // and rx->audio_buffer will not be destroyes until we
-    // are finished here.
-    //
-    rx->audio_buffer[rx->audio_buffer_offset * 2] = left_sample;
-    rx->audio_buffer[(rx->audio_buffer_offset * 2) + 1] = right_sample;
-    rx->audio_buffer_offset++;
-
-    if (rx->audio_buffer_offset >= out_buffer_size) {
-      pa_usec_t latency = pa_simple_get_latency(rx->audio_handle, &err);
-
-      if (latency > AUDIO_LAT_HIGH && rx->cwcount == 0) {
-        //
-        // If the radio is running a a slightly too high clock rate, or if
-        // the audio hardware clocks slightly below 48 kHz, then the PA audio
-        // buffer will fill up. suppress audio data until the latency is below
-        // AUDIO_LAT_LOW, or until a pre-calculated maximum number of output
-        // buffers has been suppressed.
-        //
-        rx->cwcount = (AUDIO_LAT_HIGH - AUDIO_LAT_LOW) / (20 * out_buffer_size);
-        t_print("%s: suppressing audio block\n", __FUNCTION__);
-      }
-
-      if (rx->cwcount > 0) {
-        rx->cwcount--;
-      }
-
-      if (rx->cwcount == 0 || latency < AUDIO_LAT_LOW) {
-        int rc = pa_simple_write(rx->audio_handle,
-                                 rx->audio_buffer,
-                                 out_buffer_size * sizeof(float) * 2,
-                                 &err);
-
-        if (rc < 0) {
-          t_print("%s: ERROR pa_simple_write: %s\n", __FUNCTION__, pa_strerror(err));
-        }
-      }
-
-      rx->audio_buffer_offset = 0;
-    }
-  }
-
-  g_mutex_unlock(&rx->audio_mutex);
-  return result;
-}
@@ -1053,6 +1053,7 @@ void radio_stop_program() {
 
   radio_save_state();
   t_print("%s: radio state saved\n", __FUNCTION__);
+  main_save_impulse_cache();
 }
 
 void radio_exit_program() {
@@ -265,6 +265,7 @@ void rx_save_state(const RECEIVER *rx) {
   SetPropI1("receiver.%d.waterfall_high", rx->id,               rx->waterfall_high);
   SetPropI1("receiver.%d.waterfall_automatic", rx->id,          rx->waterfall_automatic);
   SetPropI1("receiver.%d.waterfall_percent", rx->id,            rx->waterfall_percent);
+  SetPropI1("receiver.%d.waterfall_palette", rx->id,            rx->waterfall_palette);
 
   if (!radio_is_remote) {
     SetPropI1("receiver.%d.smetermode", rx->id,                 rx->smetermode);
@@ -358,6 +359,7 @@ void rx_restore_state(RECEIVER *rx) {
   GetPropI1("receiver.%d.waterfall_high", rx->id,               rx->waterfall_high);
   GetPropI1("receiver.%d.waterfall_automatic", rx->id,          rx->waterfall_automatic);
   GetPropI1("receiver.%d.waterfall_percent", rx->id,            rx->waterfall_percent);
+  GetPropI1("receiver.%d.waterfall_palette", rx->id,            rx->waterfall_palette);
 
   if (!radio_is_remote) {
     GetPropI1("receiver.%d.smetermode", rx->id,                 rx->smetermode);
@@ -778,6 +780,7 @@ RECEIVER *rx_create_receiver(int id, int width, int height) {
   rx->waterfall_low = -140;
   rx->waterfall_automatic = 1;
   rx->waterfall_percent = 25;
+  rx->waterfall_palette = WF_PALETTE_STANDARD;
   rx->display_filled = 1;
   rx->display_gradient = 1;
   rx->display_detector_mode = DET_AVERAGE;
@@ -827,7 +830,7 @@ RECEIVER *rx_create_receiver(int id, int width, int height) {
   rx->agc_hang_threshold = 0.0;
   rx->local_audio = 0;
   g_mutex_init(&rx->audio_mutex);
-  rx->audio_buffer = NULL;
+  rx->audio_ring = NULL;
   snprintf(rx->audio_name, sizeof(rx->audio_name), "NO AUDIO");
   rx->mute_when_not_active = 0;
   rx->audio_channel = STEREO;
@@ -889,7 +892,16 @@ RECEIVER *rx_create_receiver(int id, int width, int height) {
   //
   // allocate buffers
   //
-  rx->iq_input_buffer = g_new(double, 2 * rx->buffer_size);
+  for (int i = 0; i < RX_FEEDER_SLOTS; i++) {
+    rx->feeder_buffer[i] = g_new(double, 2 * rx->buffer_size);
+  }
+
+  rx->feeder_inptr = 0;
+  rx->feeder_outptr = 0;
+  rx->feeder_overflow = 0;
+  rx->iq_input_buffer = rx->feeder_buffer[0];
+  g_mutex_init(&rx->feeder_mutex);
+  g_cond_init(&rx->feeder_cond);
   rx->pixels = width;
   rx->pixel_samples = g_new(float, rx->pixels);
   t_print("%s (after restore): id=%d local_audio=%d\n", __FUNCTION__, rx->id, rx->local_audio);
@@ -956,6 +968,9 @@ RECEIVER *rx_create_receiver(int id, int width, int height) {
   rx_set_agc(rx);
   rx->txrxcount = 0;
   rx->txrxmax = 0;
+  char tname[32];
+  snprintf(tname, sizeof(tname), "RX%d DSP", rx->id);
+  rx->feeder_thread_id = g_thread_new(tname, rx_feeder_thread, rx);
   return rx;
 }
 
@@ -1080,8 +1095,13 @@ void rx_vfo_changed(RECEIVER *rx) {
 
 //////////////////////////////////////////////////////////////////////////////////////
 //
-// rx_add_iq_samples (rx_add_div_iq_samples),  rx_full_buffer, and rx_process_buffer
-// form the "RX engine".
+// rx_add_iq_block (and rx_add_div_iq_block), rx_queue_buffer,
+// rx_feeder_thread, rx_full_buffer, and rx_process_buffer form the "RX engine".
+//
+// The protocol threads fill the IQ input buffer. When it is full, it is queued
+// for the DSP feeder thread of that receiver, which does the actual DSP
+// (rx_full_buffer, rx_process_buffer). This way, network/sample unpacking
+// never waits for WDSP, and different receivers are processed in parallel.
 //
 //////////////////////////////////////////////////////////////////////////////////////
 
@@ -1110,6 +1130,14 @@ static void rx_process_buffer(RECEIVER *rx) {
   double unscale = 1.0 / scale;
   // Without DUPLEX; xmit will always be false.
   int xmit = radio_is_transmitting();
+  //
+  // Audio samples for the radio and for the local audio device
+  // are collected and sent as one block
+  //
+  short radio_audio[2 * rx->output_samples];
+  int radio_count = 0;
+  float local_audio[2 * rx->output_samples];
+  int local_count = 0;
 
   for (int i = 0; i < rx->output_samples; i++) {
     double left_sample = rx->audio_output_buffer[i * 2];
@@ -1175,7 +1203,8 @@ static void rx_process_buffer(RECEIVER *rx) {
     int right_audio_sample = (short)(right_sample * 32767.0);
 
     if (rx->local_audio) {
-      audio_write(rx, (float)left_sample, (float)right_sample);
+      local_audio[local_count++] = (float)left_sample;
+      local_audio[local_count++] = (float)right_sample;
     }
 
     if (remoteclient.running) {
@@ -1183,23 +1212,32 @@ static void rx_process_buffer(RECEIVER *rx) {
     }
 
     if (rx == active_receiver) {
-      switch (protocol) {
-      case ORIGINAL_PROTOCOL:
-        old_protocol_audio_samples(left_audio_sample, right_audio_sample);
-        break;
+      radio_audio[radio_count++] = left_audio_sample;
+      radio_audio[radio_count++] = right_audio_sample;
+    }
+  }
+
+  if (local_count > 0) {
+    audio_write_block(rx, local_audio, local_count / 2);
+  }
 
-      case NEW_PROTOCOL:
-        new_protocol_audio_samples(left_audio_sample, right_audio_sample);
-        break;
+  if (radio_count > 0) {
+    switch (protocol) {
+    case ORIGINAL_PROTOCOL:
+      old_protocol_audio_block(radio_audio, radio_count / 2);
+      break;
 
-      case SOAPYSDR_PROTOCOL:
-        break;
-      }
+    case NEW_PROTOCOL:
+      new_protocol_audio_block(radio_audio, radio_count / 2);
+      break;
+
+    case SOAPYSDR_PROTOCOL:
+      break;
     }
   }
 }
 
-static void rx_full_buffer(RECEIVER *rx) {
+static void rx_full_buffer(RECEIVER *rx, double *iq_buffer) {
   ASSERT_SERVER();
   int error;
 
@@ -1214,11 +1252,11 @@ static void rx_full_buffer(RECEIVER *rx) {
     //
     switch (rx->nb) {
     case 1:
-      xanbEXT (rx->id, rx->iq_input_buffer, rx->iq_input_buffer);
+      xanbEXT (rx->id, iq_buffer, iq_buffer);
       break;
 
     case 2:
-      xnobEXT (rx->id, rx->iq_input_buffer, rx->iq_input_buffer);
+      xnobEXT (rx->id, iq_buffer, iq_buffer);
       break;
 
     default:
@@ -1226,7 +1264,7 @@ static void rx_full_buffer(RECEIVER *rx) {
       break;
     }
 
-    fexchange0(rx->id, rx->iq_input_buffer, rx->audio_output_buffer, &error);
+    fexchange0(rx->id, iq_buffer, rx->audio_output_buffer, &error);
 
     if (error != 0) {
       t_print("%s: id=%d fexchange0: error=%d\n", __FUNCTION__, rx->id, error);
@@ -1234,7 +1272,7 @@ static void rx_full_buffer(RECEIVER *rx) {
 
     if (rx->displaying) {
       g_mutex_lock(&rx->display_mutex);
-      Spectrum0(1, rx->id, 0, 0, rx->iq_input_buffer);
+      Spectrum0(1, rx->id, 0, 0, iq_buffer);
       g_mutex_unlock(&rx->display_mutex);
     }
 
@@ -1243,9 +1281,58 @@ static void rx_full_buffer(RECEIVER *rx) {
   }
 }
 
-void rx_add_iq_samples(RECEIVER *rx, double i_sample, double q_sample) {
-  ASSERT_SERVER();
+static gpointer rx_feeder_thread(gpointer data) {
+  RECEIVER *rx = (RECEIVER *)data;
+
+  for (;;) {
+    g_mutex_lock(&rx->feeder_mutex);
+
+    while (rx->feeder_outptr == rx->feeder_inptr) {
+      g_cond_wait(&rx->feeder_cond, &rx->feeder_mutex);
+    }
+
+    double *iq_buffer = rx->feeder_buffer[rx->feeder_outptr];
+    g_mutex_unlock(&rx->feeder_mutex);
+    rx_full_buffer(rx, iq_buffer);
+    g_mutex_lock(&rx->feeder_mutex);
+    rx->feeder_outptr = (rx->feeder_outptr + 1) % RX_FEEDER_SLOTS;
+    g_mutex_unlock(&rx->feeder_mutex);
+  }
+
+  return NULL;
+}
 
+static void rx_queue_buffer(RECEIVER *rx) {
+  //
+  // The IQ input buffer is full: queue it for the feeder thread and
+  // continue with the next slot. If the feeder thread cannot keep up,
+  // the buffer is dropped and re-filled.
+  //
+  g_mutex_lock(&rx->feeder_mutex);
+  int next = (rx->feeder_inptr + 1) % RX_FEEDER_SLOTS;
+
+  if (next == rx->feeder_outptr) {
+    if (rx->feeder_overflow++ == 0) {
+      t_print("%s: RXid=%d DSP feeder overflow.\n", __FUNCTION__, rx->id);
+    }
+  } else {
+    rx->feeder_inptr = next;
+    rx->iq_input_buffer = rx->feeder_buffer[next];
+    g_cond_signal(&rx->feeder_cond);
+  }
+
+  g_mutex_unlock(&rx->feeder_mutex);
+  rx->samples = 0;
+}
+
+//
+// rx_add_iq_block and rx_add_div_iq_block take n interleaved IQ samples
+// and copy (or mix) them directly into the input buffer, queuing it
+// whenever it is full. rx_commit_iq_samples() advances the buffer index
+// for the chunk of "count" samples that has just been written into the
+// input buffer.
+//
+static void rx_commit_iq_samples(RECEIVER *rx, int count) {
   //
   // At the end of a TX/RX transition, txrxcount is set to zero,
   // and txrxmax to some suitable value.
@@ -1258,30 +1345,49 @@ void rx_add_iq_samples(RECEIVER *rx, double i_sample, double q_sample) {
   // and generally if in CW mode or using duplex.
   //
   if (rx->txrxcount < rx->txrxmax) {
-    i_sample = 0.0;
-    q_sample = 0.0;
-    rx->txrxcount++;
+    int nsilence = MIN(rx->txrxmax - rx->txrxcount, count);
+    memset(&rx->iq_input_buffer[rx->samples * 2], 0, 2 * nsilence * sizeof(double));
+    rx->txrxcount += nsilence;
   }
 
-  rx->iq_input_buffer[rx->samples * 2] = i_sample;
-  rx->iq_input_buffer[(rx->samples * 2) + 1] = q_sample;
-  rx->samples = rx->samples + 1;
+  rx->samples += count;
 
   if (rx->samples >= rx->buffer_size) {
-    rx_full_buffer(rx);
-    rx->samples = 0;
+    rx_queue_buffer(rx);
   }
 }
 
-void rx_add_div_iq_samples(RECEIVER *rx, double i0, double q0, double i1, double q1) {
+void rx_add_iq_block(RECEIVER *rx, const double *iq, int n) {
   ASSERT_SERVER();
-  //
-  // Note that we sum the second channel onto the first one
-  // and then simply pass to add_iq_samples
-  //
-  double i_sample = i0 + (div_cos * i1 - div_sin * q1);
-  double q_sample = q0 + (div_sin * i1 + div_cos * q1);
-  rx_add_iq_samples(rx, i_sample, q_sample);
+
+  while (n > 0) {
+    int count = MIN(rx->buffer_size - rx->samples, n);
+    memcpy(&rx->iq_input_buffer[rx->samples * 2], iq, 2 * count * sizeof(double));
+    rx_commit_iq_samples(rx, count);
+    iq += 2 * count;
+    n -= count;
+  }
+}
+
+void rx_add_div_iq_block(RECEIVER *rx, const double *iq0, const double *iq1, int n) {
+  ASSERT_SERVER();
+  const double c = div_cos;
+  const double s = div_sin;
+
+  while (n > 0) {
+    int count = MIN(rx->buffer_size - rx->samples, n);
+    double *dst = &rx->iq_input_buffer[rx->samples * 2];
+
+    for (int j = 0; j < 2 * count; j += 2) {
+      dst[j    ] = iq0[j    ] + (c * iq1[j] - s * iq1[j + 1]);
+      dst[j + 1] = iq0[j + 1] + (s * iq1[j] + c * iq1[j + 1]);
+    }
+
+    rx_commit_iq_samples(rx, count);
+    iq0 += 2 * count;
+    iq1 += 2 * count;
+    n -= count;
+  }
 }
 
 void rx_update_width(RECEIVER *rx) {
@@ -20,6 +20,7 @@
 #define _RECEIVER_H_
 
 #include <gtk/gtk.h>
+#include "audio_engine.h"
 #ifdef PORTAUDIO
   #include <portaudio.h>
 #endif
@@ -37,6 +38,24 @@ enum _audio_channel_enum {
   RIGHT
 };
 
+enum _waterfall_palette_enum {
+  WF_PALETTE_STANDARD = 0,
+  WF_PALETTE_GRAY,
+  WF_PALETTE_HOT,
+  WF_PALETTE_BLUE,
+  NUM_WF_PALETTES
+};
+
+//
+// Number of IQ input buffers that can be queued for the DSP feeder thread
+//
+#define RX_FEEDER_SLOTS 8
+
+//
+// Number of parameters that determine the static panadapter background
+//
+#define PAN_BACKGROUND_KEYLEN 22
+
 typedef struct _receiver {
   int id;
   GMutex mutex;
@@ -178,8 +197,11 @@ typedef struct _receiver {
   int waterfall_high;
   int waterfall_automatic;
   int waterfall_percent;
+  int waterfall_palette;
   cairo_surface_t *panadapter_surface;
-  GdkPixbuf *pixbuf;
+  cairo_surface_t *panadapter_background;                    // cached static part of the panadapter
+  double panadapter_background_key[PAN_BACKGROUND_KEYLEN];   // parameters it has been drawn for
+  cairo_surface_t *waterfall_surface;                        // waterfall image, used as a ring buffer
   int mute_when_not_active;
 
   //
@@ -189,33 +211,25 @@ typedef struct _receiver {
   int local_audio;
   char audio_name[128];
   GMutex audio_mutex;
+  AUDIO_RING *audio_ring;            // RX audio to the device (audio_engine.c)
+  GThread *audio_thread_id;          // device thread (if used by the backend)
+  volatile int audio_running;
 
 #if defined(PORTAUDIO) && defined(PULSEAUDIO) && defined(ALSA)
   // this is only possible for "cppcheck" runs
   // declare all data without conflicts
   void *audio_handle;
-  int audio_buffer_inpt;
-  int audio_buffer_outpt;
-  int audio_buffer_offset;
-  void *audio_buffer;
   snd_pcm_format_t audio_format;
 #endif
 #if defined(PORTAUDIO) && !defined(PULSEAUDIO) && !defined(ALSA)
   PaStream *audio_handle;
-  volatile int audio_buffer_inpt;    // pointer in audio ring-buffer
-  volatile int audio_buffer_outpt;   // pointer in audio ring-buffer
-  float *audio_buffer;
 #endif
 #if !defined(PORTAUDIO) && !defined(PULSEAUDIO) && defined(ALSA)
   snd_pcm_t *audio_handle;
   snd_pcm_format_t audio_format;
-  void *audio_buffer;        // different formats possible, so void*
-  int audio_buffer_offset;
 #endif
 #if !defined(PORTAUDIO) && defined(PULSEAUDIO) && !defined(ALSA)
-  pa_simple *audio_handle;
-  float *audio_buffer;
-  int audio_buffer_offset;
+  pa_stream *audio_handle;
 #endif
 
   int cwaudio;   // detect RX/TX transitions in CW
@@ -231,6 +245,10 @@ typedef struct _receiver {
   long long waterfall_frequency;
   double waterfall_cBp;
   double waterfall_cB;
+  int waterfall_head;     // surface row containing the newest waterfall line
+  int waterfall_offset;   // surface column displayed at the left edge of the waterfall
+  float waterfall_average;      // average signal level (automatic mode)
+  int waterfall_average_count;  // number of lines until the average is re-calculated
 
   int mute_radio;
 
@@ -280,6 +298,20 @@ typedef struct _receiver {
   int txrxcount;
   int txrxmax;
 
+  //
+  // DSP feeder: full IQ input buffers are queued by the protocol
+  // thread and processed (noise blanker, fexchange0, spectrum, audio)
+  // by a dedicated thread for each receiver. iq_input_buffer always
+  // points to the slot currently being filled.
+  //
+  double *feeder_buffer[RX_FEEDER_SLOTS];
+  int feeder_inptr;
+  int feeder_outptr;
+  int feeder_overflow;
+  GMutex feeder_mutex;
+  GCond feeder_cond;
+  GThread *feeder_thread_id;
+
   int display_gradient;
   int display_filled;
   int display_detector_mode;
@@ -303,8 +335,8 @@ extern gboolean rx_button_release_event(GtkWidget *widget, GdkEventButton *event
 extern gboolean rx_motion_notify_event(GtkWidget *widget, GdkEventMotion *event, gpointer data);
 extern gboolean rx_scroll_event(GtkWidget *widget, const GdkEventScroll *event, gpointer data);
 
-extern void   rx_add_iq_samples(RECEIVER *rx, double i_sample, double q_sample);
-extern void   rx_add_div_iq_samples(RECEIVER *rx, double i0, double q0, double i1, double q1);
+extern void   rx_add_iq_block(RECEIVER *rx, const double *iq, int n);
+extern void   rx_add_div_iq_block(RECEIVER *rx, const double *iq0, const double *iq1, int n);
 
 extern void   rx_change_sample_rate(RECEIVER *rx, int sample_rate);
 extern void   rx_change_adc(const RECEIVER *rx);
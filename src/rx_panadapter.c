@@ -57,9 +57,17 @@ panadapter_configure_event_cb (GtkWidget         *widget,
     cairo_surface_destroy (rx->panadapter_surface);
   }
 
+  if (rx->panadapter_background) {
+    cairo_surface_destroy (rx->panadapter_background);
+  }
+
   rx->panadapter_surface = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
                            CAIRO_CONTENT_COLOR,
                            mywidth, myheight);
+  rx->panadapter_background = cairo_surface_create_similar (rx->panadapter_surface,
+                              CAIRO_CONTENT_COLOR,
+                              mywidth, myheight);
+  rx->panadapter_background_key[0] = -1.0;  // force re-drawing the background
   cairo_t *cr = cairo_create(rx->panadapter_surface);
   cairo_set_source_rgba(cr, COLOUR_PAN_BACKGND);
   cairo_paint(cr);
@@ -102,65 +110,22 @@ static gboolean panadapter_scroll_event_cb(GtkWidget *widget, GdkEventScroll *ev
   return rx_scroll_event(widget, event, data);
 }
 
-void rx_panadapter_update(RECEIVER *rx) {
-  float *samples;
+//
+// Draw the static part of the panadapter: background, 60m channels, filter
+// shading, dBm grid, frequency markers, band edges.
+// This only changes with the frequency, zoom, pan, filter or level settings
+// and is therefore drawn into a separate surface that is re-used until one of
+// the parameters in panadapter_background_key changes.
+//
+static void rx_panadapter_background(const RECEIVER *rx, cairo_t *cr, int mywidth, int myheight,
+                                     long long frequency, int vfoband, const BAND *band,
+                                     double filter_left, double filter_right, int active) {
   cairo_text_extents_t extents;
   long long f;
   long long divisor;
-  double soffset;
-  int active = (active_receiver == rx);
-  int mywidth = gtk_widget_get_allocated_width (rx->panadapter);
-  int myheight = gtk_widget_get_allocated_height (rx->panadapter);
-  samples = rx->pixel_samples;
-  cairo_t *cr;
-  cr = cairo_create (rx->panadapter_surface);
   cairo_set_source_rgba(cr, COLOUR_PAN_BACKGND);
   cairo_rectangle(cr, 0, 0, mywidth, myheight);
   cairo_fill(cr);
-  int mode = vfo[rx->id].mode;
-  long long frequency = vfo[rx->id].frequency;
-  int vfoband = vfo[rx->id].band;
-  double xoffset;
-  //
-  // soffset contains all corrections for attenuation and preamps
-  // Perhaps some adjustment is necessary for those old radios which have
-  // switchable preamps.
-  //
-  const BAND *band = band_get_band(vfoband);
-  int calib = rx_gain_calibration - band->gaincalib;
-  soffset = (double) calib + (double)adc[rx->adc].attenuation - adc[rx->adc].gain;
-
-  if (filter_board == ALEX && rx->adc == 0) {
-    soffset += (double)(10 * adc[0].alex_attenuation);
-  }
-
-  if (filter_board == CHARLY25 && rx->adc == 0) {
-    soffset += (double)(12 * adc[0].alex_attenuation - 18 * (adc[0].preamp + adc[0].dither));
-  }
-
-  if (have_preamp && filter_board != CHARLY25) {
-    soffset -= (double)(20 * adc[rx->adc].preamp);
-  }
-
-  // In diversity mode, the RX2 frequency tracks the RX1 frequency
-  if (diversity_enabled && rx->id == 1) {
-    frequency = vfo[0].frequency;
-    vfoband = vfo[0].band;
-    mode = vfo[0].mode;
-  }
-
-  xoffset = rx->cAp * vfo[rx->id].offset;
-  double rxpos = rx->cBp + xoffset;
-  double filter_left  = rx->cAp * rx->filter_low  + xoffset + rx->cBp;
-  double filter_right = rx->cAp * rx->filter_high + xoffset + rx->cBp;
-
-  if (mode == modeCWU) {
-    filter_left  -= cw_keyer_sidetone_frequency * rx->cAp;
-    filter_right -= cw_keyer_sidetone_frequency * rx->cAp;
-  } else if (mode == modeCWL) {
-    filter_left  += cw_keyer_sidetone_frequency * rx->cAp;
-    filter_right += cw_keyer_sidetone_frequency * rx->cAp;
-  }
 
   if (vfoband == band60) {
     for (int i = 0; i < channel_entries; i++) {
@@ -322,6 +287,86 @@ void rx_panadapter_update(RECEIVER *rx) {
     cairo_move_to(cr, ((double)mywidth / 2.0) - (extents.width / 2.0), (double)myheight / 2.0);
     cairo_show_text(cr, text);
   }
+}
+
+void rx_panadapter_update(RECEIVER *rx) {
+  float *samples;
+  cairo_text_extents_t extents;
+  double soffset;
+  int active = (active_receiver == rx);
+  int mywidth = gtk_widget_get_allocated_width (rx->panadapter);
+  int myheight = gtk_widget_get_allocated_height (rx->panadapter);
+  samples = rx->pixel_samples;
+  cairo_t *cr;
+  int mode = vfo[rx->id].mode;
+  long long frequency = vfo[rx->id].frequency;
+  int vfoband = vfo[rx->id].band;
+  double xoffset;
+  //
+  // soffset contains all corrections for attenuation and preamps
+  // Perhaps some adjustment is necessary for those old radios which have
+  // switchable preamps.
+  //
+  const BAND *band = band_get_band(vfoband);
+  int calib = rx_gain_calibration - band->gaincalib;
+  soffset = (double) calib + (double)adc[rx->adc].attenuation - adc[rx->adc].gain;
+
+  if (filter_board == ALEX && rx->adc == 0) {
+    soffset += (double)(10 * adc[0].alex_attenuation);
+  }
+
+  if (filter_board == CHARLY25 && rx->adc == 0) {
+    soffset += (double)(12 * adc[0].alex_attenuation - 18 * (adc[0].preamp + adc[0].dither));
+  }
+
+  if (have_preamp && filter_board != CHARLY25) {
+    soffset -= (double)(20 * adc[rx->adc].preamp);
+  }
+
+  // In diversity mode, the RX2 frequency tracks the RX1 frequency
+  if (diversity_enabled && rx->id == 1) {
+    frequency = vfo[0].frequency;
+    vfoband = vfo[0].band;
+    mode = vfo[0].mode;
+  }
+
+  xoffset = rx->cAp * vfo[rx->id].offset;
+  double rxpos = rx->cBp + xoffset;
+  double filter_left  = rx->cAp * rx->filter_low  + xoffset + rx->cBp;
+  double filter_right = rx->cAp * rx->filter_high + xoffset + rx->cBp;
+
+  if (mode == modeCWU) {
+    filter_left  -= cw_keyer_sidetone_frequency * rx->cAp;
+    filter_right -= cw_keyer_sidetone_frequency * rx->cAp;
+  } else if (mode == modeCWL) {
+    filter_left  += cw_keyer_sidetone_frequency * rx->cAp;
+    filter_right += cw_keyer_sidetone_frequency * rx->cAp;
+  }
+
+  //
+  // Re-draw the static background only if something has changed
+  //
+  double key[PAN_BACKGROUND_KEYLEN] = {
+    mywidth, myheight, (double) frequency, vfoband, filter_left, filter_right, active,
+    rx->panadapter_high, rx->panadapter_low, rx->panadapter_step, rx->cA, rx->cB, rx->cAp, rx->cBp,
+    rx->pixels, rx->sample_rate, rx->width, remoteclient.running, which_css_font, channel_entries,
+    (double) band->frequencyMin, (double) band->frequencyMax
+  };
+
+  if (memcmp(key, rx->panadapter_background_key, sizeof(key)) != 0) {
+    cr = cairo_create (rx->panadapter_background);
+    rx_panadapter_background(rx, cr, mywidth, myheight, frequency, vfoband, band, filter_left, filter_right, active);
+    cairo_destroy (cr);
+    memcpy(rx->panadapter_background_key, key, sizeof(key));
+  }
+
+  cr = cairo_create (rx->panadapter_surface);
+  cairo_set_source_surface (cr, rx->panadapter_background, 0.0, 0.0);
+  cairo_paint (cr);
+  int panhi = rx->panadapter_high;
+  int panlo = rx->panadapter_low;
+  cairo_select_font_face(cr, DISPLAY_FONT_FACE, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+  cairo_set_font_size(cr, DISPLAY_FONT_SIZE2);
 
   // agc
   if (rx->agc != AGC_OFF) {
@@ -664,6 +709,7 @@ void rx_panadapter_update(RECEIVER *rx) {
 
 void rx_panadapter_init(RECEIVER *rx, int width, int height) {
   rx->panadapter_surface = NULL;
+  rx->panadapter_background = NULL;
   rx->panadapter = gtk_drawing_area_new ();
   gtk_widget_set_size_request (rx->panadapter, width, height);
   /* Signals used to handle the backing surface */
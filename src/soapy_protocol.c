@@ -104,7 +104,7 @@ void soapy_protocol_change_rx_sample_rate(RECEIVER *rx) {
   //
   // rx->mutex already locked, so we can call this  only
   // if the radio is stopped -- we cannot change the resampler
-  // while the receive thread is stuck in rx_add_iq_samples()
+  // while the receive thread is stuck in rx_add_iq_block()
   //
 #if 0
   //
@@ -550,9 +550,34 @@ void soapy_protocol_init(gboolean hf) {
   SoapySDRKwargs_clear(&args);
 }
 
-static void process_rx_buffer(RECEIVER *rx, const float *rxbuff, int elements, int micflag) {
-  double isample, qsample;
+//
+// Feed a block of n IQ samples (interleaved doubles) to the receiver, swapping
+// I and Q if requested. If micflag is set, generate the TX "heart beat":
+// since there are no mic samples in SOAPY, a (zero) mic sample is sent
+// to the transmitter for every mic_sample_divisor RX samples.
+//
+static void add_rx_block(RECEIVER *rx, double *iq, int n, int micflag) {
+  if (soapy_iqswap) {
+    for (int j = 0; j < 2 * n; j += 2) {
+      double tmp = iq[j];
+      iq[j] = iq[j + 1];
+      iq[j + 1] = tmp;
+    }
+  }
+
+  rx_add_iq_block(rx, iq, n);
 
+  if (can_transmit && micflag) {
+    for (int j = 0; j < n; j++) {
+      if (++mic_samples >= mic_sample_divisor) { // reduce to 48000
+        tx_add_mic_sample(transmitter, 0);
+        mic_samples = 0;
+      }
+    }
+  }
+}
+
+static void process_rx_buffer(RECEIVER *rx, const float *rxbuff, int elements, int micflag) {
   if (rx->resampler != NULL) {
     //
     // When using the resampler, copy all elements of the Soapy buffer into the input
@@ -570,31 +595,7 @@ static void process_rx_buffer(RECEIVER *rx, const float *rxbuff, int elements, i
 
       if (rxrc >= 2 * max_rx_samples) {
         int samples = xresample(rx->resampler);
-
-        for (int j = 0; j < samples; j++) {
-          isample = rx->resample_output[j * 2];
-          qsample = rx->resample_output[(j * 2) + 1];
-
-          if (soapy_iqswap) {
-            rx_add_iq_samples(rx, qsample, isample);
-          } else {
-            rx_add_iq_samples(rx, isample, qsample);
-          }
-
-          if (can_transmit && micflag) {
-            mic_samples++;
-
-            if (mic_samples >= mic_sample_divisor) { // reduce to 48000
-              //
-              // We have no mic samples, this call only
-              // sets the heart beat
-              //
-              tx_add_mic_sample(transmitter, 0);
-              mic_samples = 0;
-            }
-          }
-        }
-
+        add_rx_block(rx, rx->resample_output, samples, micflag);
         rxrc = 0;
       }
     }
@@ -603,26 +604,20 @@ static void process_rx_buffer(RECEIVER *rx, const float *rxbuff, int elements, i
   } else {
     //
     // When *not* using the resampler, convert elements in the Soapy buffer
-    // to double and use them on-the-fly
+    // to double in chunks and feed them to the receiver
     //
-    for (int i = 0; i < elements; i++) {
-      isample = (double)rxbuff[i * 2];
-      qsample = (double)rxbuff[(i * 2) + 1];
-
-      if (soapy_iqswap) {
-        rx_add_iq_samples(rx, qsample, isample);
-      } else {
-        rx_add_iq_samples(rx, isample, qsample);
-      }
+    double iq[512];
 
-      if (can_transmit && micflag) {
-        mic_samples++;
+    while (elements > 0) {
+      int n = MIN(elements, 256);
 
-        if (mic_samples >= mic_sample_divisor) { // reduce to 48000
-          tx_add_mic_sample(transmitter, 0);
-          mic_samples = 0;
-        }
+      for (int j = 0; j < 2 * n; j++) {
+        iq[j] = (double)rxbuff[j];
       }
+
+      add_rx_block(rx, iq, n, micflag);
+      rxbuff += 2 * n;
+      elements -= n;
     }
   }
 }
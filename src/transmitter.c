@@ -1078,6 +1078,7 @@ TRANSMITTER *tx_create_transmitter(int id, int pixels, int width, int height) {
   tx->local_audio = 0;
   tx->audiomonitor = 0;
   tx->audio_flag = 0;
+  tx->audio_ring = NULL;
   g_mutex_init(&tx->audio_mutex);
   snprintf(tx->audio_name, sizeof(tx->audio_name), "%s", "NO AUDIO");
   tx->dialog_x = -1;
@@ -1301,21 +1302,20 @@ TRANSMITTER *tx_create_transmitter(int id, int pixels, int width, int height) {
 
 //////////////////////////////////////////////////////////////////////////
 //
-// tx_add_mic_sample, tx_full_buffer,  tx_add_ps_iq_samples form the
+// tx_add_mic_sample, tx_full_buffer,  tx_add_ps_iq_block form the
 // "TX engine"
 //
 //////////////////////////////////////////////////////////////////////////
 
 static void tx_full_buffer(TRANSMITTER *tx) {
   ASSERT_SERVER();
-  long isample;
-  long qsample;
   double gain;
   double *dp;
   int j;
   int error;
   int cwmode;
   static int txflag = 0;
+  static const int silence[2 * 1024];   // zero IQ samples
   // It is important to query the TX mode and tune only *once* within this function, to assure that
   // the two "if (cwmode)" clauses give the same result.
   // cwmode only valid in the old protocol, in the new protocol we use a different mechanism
@@ -1443,9 +1443,7 @@ static void tx_full_buffer(TRANSMITTER *tx) {
       // suppress underflows if one of the following buckets comes
       // a little late.
       //
-      for (j = 0; j < 1024; j++) {
-        new_protocol_iq_samples(0, 0);
-      }
+      new_protocol_iq_block(silence, 1024);
     }
 
     txflag = 1;
@@ -1477,16 +1475,19 @@ static void tx_full_buffer(TRANSMITTER *tx) {
         // An inspection of the IQ samples produced by WDSP when TUNEing shows
         // that the amplitude of the pulse is in I (in the range 0.0 - 1.0)
         // and Q should be zero
+        int iq[2 * tx->output_samples];
+
         for (j = 0; j < tx->output_samples; j++) {
-          double ramp = tx->cw_sig_rf[j];       // between 0.0 and 1.0
-          isample = floor(gain * ramp + 0.5);   // always non-negative, isample is just the pulse envelope
-          old_protocol_iq_samples(isample, 0, tx->p1stone[j]);
+          double ramp = tx->cw_sig_rf[j];         // between 0.0 and 1.0
+          iq[2 * j] = floor(gain * ramp + 0.5);   // always non-negative, I is just the pulse envelope
+          iq[2 * j + 1] = 0;
         }
+
+        old_protocol_iq_block(iq, tx->p1stone, tx->output_samples);
       }
       break;
 
-      case NEW_PROTOCOL:
-
+      case NEW_PROTOCOL: {
         //
         // An inspection of the IQ samples produced by WDSP when TUNEing shows
         // that the amplitude of the pulse is in I (in the range 0.0 - 0.896)
@@ -1496,13 +1497,17 @@ static void tx_full_buffer(TRANSMITTER *tx) {
         //
         // This is why we apply the factor 0.896 HERE.
         //
+        int iq[2 * tx->output_samples];
+
         for (j = 0; j < tx->output_samples; j++) {
-          double ramp = tx->cw_sig_rf[j];                  // between 0.0 and 1.0
-          isample = floor(0.896 * gain * ramp + 0.5);      // always non-negative, isample is just the pulse envelope
-          new_protocol_iq_samples(isample, 0);
+          double ramp = tx->cw_sig_rf[j];                   // between 0.0 and 1.0
+          iq[2 * j] = floor(0.896 * gain * ramp + 0.5);     // always non-negative, I is just the pulse envelope
+          iq[2 * j + 1] = 0;
         }
 
-        break;
+        new_protocol_iq_block(iq, tx->output_samples);
+      }
+      break;
 
       case SOAPYSDR_PROTOCOL:
 
@@ -1522,32 +1527,29 @@ static void tx_full_buffer(TRANSMITTER *tx) {
       //
       // Original code without pulse shaping and without side tone
       //
-      for (j = 0; j < tx->output_samples; j++) {
-        double is, qs;
-        is = tx->iq_output_buffer[j * 2];
-        qs = tx->iq_output_buffer[(j * 2) + 1];
-        isample = is >= 0.0 ? (long)floor(is * gain + 0.5) : (long)ceil(is * gain - 0.5);
-        qsample = qs >= 0.0 ? (long)floor(qs * gain + 0.5) : (long)ceil(qs * gain - 0.5);
+      if (protocol == SOAPYSDR_PROTOCOL) {
+        for (j = 0; j < tx->output_samples; j++) {
+          // SOAPY: just convert the double IQ samples (is,qs) to float.
+#ifdef SOAPYSDR
+          soapy_protocol_iq_samples((float)tx->iq_output_buffer[j * 2], (float)tx->iq_output_buffer[(j * 2) + 1]);
+#endif
+        }
+      } else {
+        int iq[2 * tx->output_samples];
 
-        switch (protocol) {
-        case ORIGINAL_PROTOCOL:
+        for (j = 0; j < 2 * tx->output_samples; j++) {
+          double x = tx->iq_output_buffer[j];
+          iq[j] = x >= 0.0 ? (long)floor(x * gain + 0.5) : (long)ceil(x * gain - 0.5);
+        }
+
+        if (protocol == ORIGINAL_PROTOCOL) {
           //
           // Normally, tx->p1stone[j] will be zero. It can be non-zero
           // e.g. when producing a side tone while TUNE-ing
           //
-          old_protocol_iq_samples(isample, qsample, tx->p1stone[j]);
-          break;
-
-        case NEW_PROTOCOL:
-          new_protocol_iq_samples(isample, qsample);
-          break;
-
-        case SOAPYSDR_PROTOCOL:
-          // SOAPY: just convert the double IQ samples (is,qs) to float.
-#ifdef SOAPYSDR
-          soapy_protocol_iq_samples((float)is, (float)qs);
-#endif
-          break;
+          old_protocol_iq_block(iq, tx->p1stone, tx->output_samples);
+        } else {
+          new_protocol_iq_block(iq, tx->output_samples);
         }
       }
     }
@@ -1563,9 +1565,7 @@ static void tx_full_buffer(TRANSMITTER *tx) {
       // after stopping the TX are zero and won't produce
       // an unwanted signal after the next RX -> TX transition.
       //
-      for (j = 0; j < 240; j++) {
-        new_protocol_iq_samples(0, 0);
-      }
+      new_protocol_iq_block(silence, 240);
     }
 
     txflag = 0;
@@ -1903,69 +1903,93 @@ void tx_add_mic_sample(TRANSMITTER *tx, short next_mic_sample) {
   }
 }
 
-void tx_add_ps_iq_samples(const TRANSMITTER *tx, double i_sample_tx, double q_sample_tx, double i_sample_rx,
-                          double q_sample_rx) {
+static void tx_ps_full_buffer(const TRANSMITTER *tx) {
   ASSERT_SERVER();
+  //
+  // Called when the PS feedback buffers are full
+  //
   RECEIVER *tx_feedback = receiver[PS_TX_FEEDBACK];
   RECEIVER *rx_feedback = receiver[PS_RX_FEEDBACK];
 
-  if (tx->do_scale) {
-    tx_feedback->iq_input_buffer[tx_feedback->samples * 2] = i_sample_tx * tx->drive_iscal;
-    tx_feedback->iq_input_buffer[(tx_feedback->samples * 2) + 1] = q_sample_tx * tx->drive_iscal;
-  } else {
-    tx_feedback->iq_input_buffer[tx_feedback->samples * 2] = i_sample_tx;
-    tx_feedback->iq_input_buffer[(tx_feedback->samples * 2) + 1] = q_sample_tx;
-  }
+  if (radio_is_transmitting()) {
+    int txmode = vfo_get_tx_mode();
+    int cwmode = (txmode == modeCWL || txmode == modeCWU) && !tx->tune && !tx->twotone;
+#if 0
+    //
+    // Special code to document the amplitude of the feedback samples.
+    // This can be used to determine the "SetPK" value for an unknown
+    // radio.
+    //
+    double pkmax = 0.0, pkval;
+    double rxmax = 0.0, rxval;
 
-  rx_feedback->iq_input_buffer[rx_feedback->samples * 2] = i_sample_rx;
-  rx_feedback->iq_input_buffer[(rx_feedback->samples * 2) + 1] = q_sample_rx;
-  tx_feedback->samples = tx_feedback->samples + 1;
-  rx_feedback->samples = rx_feedback->samples + 1;
+    for (int i = 0; i < rx_feedback->buffer_size; i++) {
+      pkval = tx_feedback->iq_input_buffer[2 * i] * tx_feedback->iq_input_buffer[2 * i] +
+              tx_feedback->iq_input_buffer[2 * i + 1] * tx_feedback->iq_input_buffer[2 * i + 1];
+      rxval = rx_feedback->iq_input_buffer[2 * i] * rx_feedback->iq_input_buffer[2 * i] +
+              rx_feedback->iq_input_buffer[2 * i + 1] * rx_feedback->iq_input_buffer[2 * i + 1];
 
-  if (rx_feedback->samples >= rx_feedback->buffer_size) {
-    if (radio_is_transmitting()) {
-      int txmode = vfo_get_tx_mode();
-      int cwmode = (txmode == modeCWL || txmode == modeCWU) && !tx->tune && !tx->twotone;
-#if 0
+      if (pkval > pkmax) { pkmax = pkval; }
+
+      if (rxval > rxmax) { rxmax = rxval; }
+    }
+
+    t_print("%s: SetPk MEASURED: %f RX FeedBk Level: %f\n", __FUNCTION__, sqrt(pkmax), sqrt(rxmax));
+#endif
+
+    if (!cwmode) {
       //
-      // Special code to document the amplitude of the feedback samples.
-      // This can be used to determine the "SetPK" value for an unknown
-      // radio.
+      // Since we are not using WDSP in CW transmit, it also makes little sense to
+      // deliver feedback samples
       //
-      double pkmax = 0.0, pkval;
-      double rxmax = 0.0, rxval;
+      pscc(tx->id, rx_feedback->buffer_size, tx_feedback->iq_input_buffer, rx_feedback->iq_input_buffer);
+    }
+
+    if (tx->displaying && tx->feedback) {
+      g_mutex_lock(&rx_feedback->display_mutex);
+      Spectrum0(1, rx_feedback->id, 0, 0, rx_feedback->iq_input_buffer);
+      g_mutex_unlock(&rx_feedback->display_mutex);
+    }
+  }
 
-      for (int i = 0; i < rx_feedback->buffer_size; i++) {
-        pkval = tx_feedback->iq_input_buffer[2 * i] * tx_feedback->iq_input_buffer[2 * i] +
-                tx_feedback->iq_input_buffer[2 * i + 1] * tx_feedback->iq_input_buffer[2 * i + 1];
-        rxval = rx_feedback->iq_input_buffer[2 * i] * rx_feedback->iq_input_buffer[2 * i] +
-                rx_feedback->iq_input_buffer[2 * i + 1] * rx_feedback->iq_input_buffer[2 * i + 1];
+  rx_feedback->samples = 0;
+  tx_feedback->samples = 0;
+}
 
-        if (pkval > pkmax) { pkmax = pkval; }
+//
+// PureSignal feedback: n interleaved IQ samples
+// from the TX and RX feedback channels.
+//
+void tx_add_ps_iq_block(const TRANSMITTER *tx, const double *iq_tx, const double *iq_rx, int n) {
+  ASSERT_SERVER();
+  RECEIVER *tx_feedback = receiver[PS_TX_FEEDBACK];
+  RECEIVER *rx_feedback = receiver[PS_RX_FEEDBACK];
 
-        if (rxval > rxmax) { rxmax = rxval; }
-      }
+  while (n > 0) {
+    int count = MIN(rx_feedback->buffer_size - rx_feedback->samples, n);
+    double *txdst = &tx_feedback->iq_input_buffer[tx_feedback->samples * 2];
 
-      t_print("%s: SetPk MEASURED: %f RX FeedBk Level: %f\n", __FUNCTION__, sqrt(pkmax), sqrt(rxmax));
-#endif
+    if (tx->do_scale) {
+      const double scale = tx->drive_iscal;
 
-      if (!cwmode) {
-        //
-        // Since we are not using WDSP in CW transmit, it also makes little sense to
-        // deliver feedback samples
-        //
-        pscc(tx->id, rx_feedback->buffer_size, tx_feedback->iq_input_buffer, rx_feedback->iq_input_buffer);
+      for (int j = 0; j < 2 * count; j++) {
+        txdst[j] = iq_tx[j] * scale;
       }
+    } else {
+      memcpy(txdst, iq_tx, 2 * count * sizeof(double));
+    }
 
-      if (tx->displaying && tx->feedback) {
-        g_mutex_lock(&rx_feedback->display_mutex);
-        Spectrum0(1, rx_feedback->id, 0, 0, rx_feedback->iq_input_buffer);
-        g_mutex_unlock(&rx_feedback->display_mutex);
-      }
+    memcpy(&rx_feedback->iq_input_buffer[rx_feedback->samples * 2], iq_rx, 2 * count * sizeof(double));
+    tx_feedback->samples += count;
+    rx_feedback->samples += count;
+
+    if (rx_feedback->samples >= rx_feedback->buffer_size) {
+      tx_ps_full_buffer(tx);
     }
 
-    rx_feedback->samples = 0;
-    tx_feedback->samples = 0;
+    iq_tx += 2 * count;
+    iq_rx += 2 * count;
+    n -= count;
   }
 }
 
@@ -21,6 +21,7 @@
 #define _TRANSMITTER_H_
 
 #include <gtk/gtk.h>
+#include "audio_engine.h"
 
 #define CTCSS_FREQUENCIES 38
 extern double ctcss_frequencies[CTCSS_FREQUENCIES];
@@ -88,10 +89,8 @@ typedef struct _transmitter {
   GMutex audio_mutex;
   GThread * audio_thread_id;
   int audio_flag;
-  volatile int audio_buffer_inpt;
-  volatile int audio_buffer_outpt;
   volatile int audio_running;
-  float *audio_buffer;
+  AUDIO_RING *audio_ring;    // mic samples from the device (audio_engine.c)
 
 #if defined(PORTAUDIO) && defined(PULSEAUDIO) && defined(ALSA)
   // this is only possible for "cppcheck" runs
@@ -227,8 +226,7 @@ void tx_create_dialog(TRANSMITTER *tx);
 void tx_reconfigure(TRANSMITTER *tx, int pixels, int width, int height);
 
 extern void   tx_add_mic_sample(TRANSMITTER *tx, short next_mic_sample);
-extern void   tx_add_ps_iq_samples(const TRANSMITTER *tx, double i_sample_0, double q_sample_0, double i_sample_1,
-                                   double q_sample_1);
+extern void   tx_add_ps_iq_block(const TRANSMITTER *tx, const double *iq_tx, const double *iq_rx, int n);
 
 extern void   tx_close(const TRANSMITTER *tx);
 extern void   tx_create_analyzer(const TRANSMITTER *tx);
@@ -29,13 +29,100 @@
 #include "message.h"
 #include "waterfall.h"
 
-static int colorLowR = 0; // black
-static int colorLowG = 0;
-static int colorLowB = 0;
+//
+// The waterfall colours are taken from a look-up table. Entries 1 ... WF_LUT_SIZE
+// cover the range from waterfall_low to waterfall_high, entry 0 is used for
+// signals below, and entry WF_LUT_SIZE+1 for signals above this range.
+// Since the table only depends on the palette, it is built once for each palette.
+// The entries are pixels in CAIRO_FORMAT_RGB24 (0x00RRGGBB in native byte order),
+// such that they can be stored directly into the waterfall surface.
+//
+#define WF_LUT_SIZE 1024
+
+//
+// In automatic mode, the average signal level is only re-calculated
+// every WF_AVERAGE_INTERVAL lines.
+//
+#define WF_AVERAGE_INTERVAL 8
+
+typedef struct _wf_stop {
+  float percent;
+  unsigned char r, g, b;
+} WF_STOP;
+
+typedef struct _wf_palette {
+  unsigned char low[3];     // colour below range
+  unsigned char high[3];    // colour above range
+  int nstops;
+  WF_STOP stops[8];         // colour gradient within range
+} WF_PALETTE;
+
+static const WF_PALETTE palettes[NUM_WF_PALETTES] = {
+  // WF_PALETTE_STANDARD: black - blue - cyan - green - yellow - red - magenta - lilac, yellow above range
+  {{0, 0, 0}, {255, 255, 0}, 8, {
+      {0.000000F,   0,   0,   0}, {0.222222F,   0,   0, 255}, {0.333333F,   0, 255, 255}, {0.444444F,   0, 255,   0},
+      {0.555555F, 255, 255,   0}, {0.777777F, 255,   0,   0}, {0.888888F, 255,   0, 255}, {1.000000F, 191, 127, 255}
+    }
+  },
+  // WF_PALETTE_GRAY: black - white
+  {{0, 0, 0}, {255, 255, 255}, 2, {
+      {0.0F,   0,   0,   0}, {1.0F, 255, 255, 255}
+    }
+  },
+  // WF_PALETTE_HOT: black - red - yellow - white
+  {{0, 0, 0}, {255, 255, 255}, 4, {
+      {0.0F,   0,   0,   0}, {0.4F, 255,   0,   0}, {0.8F, 255, 255,   0}, {1.0F, 255, 255, 255}
+    }
+  },
+  // WF_PALETTE_BLUE: dark blue - blue - cyan - white
+  {{0, 0, 32}, {255, 255, 255}, 4, {
+      {0.0F,   0,   0,  32}, {0.4F,   0,  64, 255}, {0.8F,   0, 255, 255}, {1.0F, 255, 255, 255}
+    }
+  }
+};
+
+static guint32 wf_lut[NUM_WF_PALETTES][WF_LUT_SIZE + 2];
+static int wf_lut_valid[NUM_WF_PALETTES] = { 0 };
 
-static int colorHighR = 255; // yellow
-static int colorHighG = 255;
-static int colorHighB = 0;
+static guint32 waterfall_rgb(unsigned char r, unsigned char g, unsigned char b) {
+  return ((guint32) r << 16) | ((guint32) g << 8) | (guint32) b;
+}
+
+static void waterfall_build_lut(int palette) {
+  const WF_PALETTE *pal = &palettes[palette];
+  guint32 *lut = wf_lut[palette];
+  int stop = 0;
+  lut[0] = waterfall_rgb(pal->low[0], pal->low[1], pal->low[2]);
+  lut[WF_LUT_SIZE + 1] = waterfall_rgb(pal->high[0], pal->high[1], pal->high[2]);
+
+  for (int i = 0; i < WF_LUT_SIZE; i++) {
+    float percent = ((float) i + 0.5F) / (float) WF_LUT_SIZE;
+
+    while (stop < pal->nstops - 2 && percent > pal->stops[stop + 1].percent) { stop++; }
+
+    const WF_STOP *s0 = &pal->stops[stop];
+    const WF_STOP *s1 = &pal->stops[stop + 1];
+    float x = (percent - s0->percent) / (s1->percent - s0->percent);
+    lut[i + 1] = waterfall_rgb((unsigned char)(s0->r + x * (s1->r - s0->r)),
+                               (unsigned char)(s0->g + x * (s1->g - s0->g)),
+                               (unsigned char)(s0->b + x * (s1->b - s0->b)));
+  }
+
+  wf_lut_valid[palette] = 1;
+}
+
+//
+// Clear the waterfall surface and reset the ring buffer positions
+//
+static void waterfall_clear(RECEIVER *rx) {
+  cairo_surface_t *surface = rx->waterfall_surface;
+  cairo_surface_flush(surface);
+  memset(cairo_image_surface_get_data(surface), 0,
+         (size_t) cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface));
+  cairo_surface_mark_dirty(surface);
+  rx->waterfall_head = 0;
+  rx->waterfall_offset = 0;
+}
 
 /* Create a new surface of the appropriate size to store our scribbles */
 static gboolean
@@ -44,15 +131,14 @@ waterfall_configure_event_cb (GtkWidget         *widget,
                               gpointer           data) {
   RECEIVER *rx = (RECEIVER *)data;
 
-  if (rx->pixbuf) {
-    g_object_unref(rx->pixbuf);
+  if (rx->waterfall_surface) {
+    cairo_surface_destroy(rx->waterfall_surface);
   }
 
   int width = gtk_widget_get_allocated_width (widget);
   int heigt = gtk_widget_get_allocated_height (widget);
-  rx->pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, heigt);
-  unsigned char *pixels = gdk_pixbuf_get_pixels (rx->pixbuf);
-  memset(pixels, 0, width * heigt * 3);
+  rx->waterfall_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, heigt);
+  waterfall_clear(rx);
   return TRUE;
 }
 
@@ -66,14 +152,60 @@ waterfall_draw_cb (GtkWidget *widget,
                    gpointer   data) {
   const RECEIVER *rx = (RECEIVER *)data;
 
-  if (rx->pixbuf) {
-    gdk_cairo_set_source_pixbuf (cr, rx->pixbuf, 0, 0);
-    cairo_paint (cr);
+  if (rx->waterfall_surface) {
+    //
+    // The surface is a ring buffer both vertically and horizontally:
+    // row waterfall_head contains the newest line and goes to the top,
+    // column waterfall_offset goes to the left edge. So the image is
+    // composed from (at most) four rectangles.
+    //
+    cairo_surface_t *surface = rx->waterfall_surface;
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    int xpos[2] = { -rx->waterfall_offset, width - rx->waterfall_offset };
+    int ypos[2] = { -rx->waterfall_head, height - rx->waterfall_head };
+
+    for (int i = 0; i < 2; i++) {
+      if (ypos[i] >= height) { continue; }
+
+      for (int j = 0; j < 2; j++) {
+        if (xpos[j] >= width) { continue; }
+
+        cairo_set_source_surface(cr, surface, xpos[j], ypos[i]);
+        cairo_rectangle(cr, xpos[j], ypos[i], width, height);
+        cairo_fill(cr);
+      }
+    }
   }
 
   return FALSE;
 }
 
+//
+// Clear the surface columns displayed at x-positions xstart ... xstart+n-1
+//
+static void waterfall_clear_columns(const RECEIVER *rx, int xstart, int n) {
+  cairo_surface_t *surface = rx->waterfall_surface;
+  unsigned char *pixels = cairo_image_surface_get_data(surface);
+  int width = cairo_image_surface_get_width(surface);
+  int height = cairo_image_surface_get_height(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  int col = (xstart + rx->waterfall_offset) % width;
+  int n1 = (col + n > width) ? width - col : n;
+  cairo_surface_flush(surface);
+
+  for (int i = 0; i < height; i++) {
+    guint32 *row = (guint32 *) &pixels[i * stride];
+    memset(&row[col], 0, n1 * sizeof(guint32));
+
+    if (n1 < n) { memset(row, 0, (n - n1) * sizeof(guint32)); }
+  }
+
+  cairo_surface_mark_dirty_rectangle(surface, col, 0, n1, height);
+
+  if (n1 < n) { cairo_surface_mark_dirty_rectangle(surface, 0, 0, n - n1, height); }
+}
+
 static gboolean
 waterfall_button_press_event_cb (GtkWidget      *widget,
                                  GdkEventButton *event,
@@ -100,14 +232,15 @@ static gboolean waterfall_scroll_event_cb (GtkWidget *widget, GdkEventScroll *ev
 }
 
 void waterfall_update(RECEIVER *rx) {
-  if (rx->pixbuf && rx->pixels_available) {
+  if (rx->waterfall_surface && rx->pixels_available) {
     const float *samples;
     long long frequency = vfo[rx->id].frequency; // access only once to be thread-safe
     int  freq_changed = 0;                    // flag whether we have just "rotated"
-    unsigned char *pixels = gdk_pixbuf_get_pixels (rx->pixbuf);
-    int width = gdk_pixbuf_get_width(rx->pixbuf);
-    int height = gdk_pixbuf_get_height(rx->pixbuf);
-    int rowstride = gdk_pixbuf_get_rowstride(rx->pixbuf);
+    cairo_surface_t *surface = rx->waterfall_surface;
+    unsigned char *pixels = cairo_image_surface_get_data(surface);
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    int stride = cairo_image_surface_get_stride(surface);
 
     //
     // The existing waterfall corresponds to a center frequency rx->waterfall_frequency, a zoom value rx->waterfall_zoom and
@@ -132,29 +265,25 @@ void waterfall_update(RECEIVER *rx) {
           //
           // If horizontal shift is too large, re-init waterfall
           //
-          memset(pixels, 0, width * height * 3);
+          waterfall_clear(rx);
           rx->waterfall_frequency = frequency;
           rx->waterfall_cBp = rx->cBp;
         } else {
           //
           // If rotate_pixels != 0, shift waterfall horizontally and set "freq changed" flag
           // calculated which VFO/pan value combination the shifted waterfall corresponds to
+          // The shift only moves the horizontal offset, and the columns that
+          // become visible are cleared.
           //
           //
+          rx->waterfall_offset = (rx->waterfall_offset - rotate_pixels + width) % width;
+
           if (rotate_pixels < 0) {
             // shift left, and clear the right-most part
-            memmove(pixels, &pixels[-rotate_pixels * 3], ((width * height) + rotate_pixels) * 3);
-
-            for (int i = 0; i < height; i++) {
-              memset(&pixels[((i * width) + (width + rotate_pixels)) * 3], 0, -rotate_pixels * 3);
-            }
+            waterfall_clear_columns(rx, width + rotate_pixels, -rotate_pixels);
           } else if (rotate_pixels > 0) {
             // shift right, and clear left-most part
-            memmove(&pixels[rotate_pixels * 3], pixels, ((width * height) - rotate_pixels) * 3);
-
-            for (int i = 0; i < height; i++) {
-              memset(&pixels[(i * width) * 3], 0, rotate_pixels * 3);
-            }
+            waterfall_clear_columns(rx, 0, rotate_pixels);
           }
 
           if (rotfreq != 0) {
@@ -170,7 +299,7 @@ void waterfall_update(RECEIVER *rx) {
       // waterfall frequency not (yet) set, sample rate changed, or zoom value changed:
       // (re-) init waterfall
       //
-      memset(pixels, 0, width * height * 3);
+      waterfall_clear(rx);
       rx->waterfall_frequency = frequency;
       rx->waterfall_cBp = rx->cBp;
       rx->waterfall_cB = rx->cB;
@@ -187,12 +316,18 @@ void waterfall_update(RECEIVER *rx) {
     // improvement.
     //
     if (!freq_changed) {
-      memmove(&pixels[rowstride], pixels, (height - 1)*rowstride);
+      //
+      // Instead of scrolling the whole image, move the head row up by one
+      // and write the new line there, starting at the horizontal offset
+      //
+      rx->waterfall_head = (rx->waterfall_head + height - 1) % height;
+      guint32 *row = (guint32 *) &pixels[rx->waterfall_head * stride];
+      int wrap = width - rx->waterfall_offset;
       float soffset;
-      unsigned char *p;
-      p = pixels;
+      guint32 *p;
+      p = &row[rx->waterfall_offset];
       samples = rx->pixel_samples;
-      float wf_low, wf_high, rangei;
+      float wf_low, wf_high;
       int id = rx->id;
       int b = vfo[id].band;
       const BAND *band = band_get_band(b);
@@ -215,73 +350,57 @@ void waterfall_update(RECEIVER *rx) {
       }
 
       if (rx->waterfall_automatic) {
-        float average = 0.0F;
+        if (--rx->waterfall_average_count <= 0) {
+          float average = 0.0F;
+
+          for (int i = 0; i < width; i++) {
+            average += samples[i];
+          }
 
-        for (int i = 0; i < width; i++) {
-          average += samples[i];
+          rx->waterfall_average = average / (float)width;
+          rx->waterfall_average_count = WF_AVERAGE_INTERVAL;
         }
 
-        wf_low = (average / (float)width) + soffset - 5.0F;
+        wf_low = rx->waterfall_average + soffset - 5.0F;
         wf_high = wf_low + 55.0F;
       } else {
         wf_low  = (float) rx->waterfall_low;
         wf_high = (float) rx->waterfall_high;
       }
 
-      rangei = 1.0F / (wf_high - wf_low);
+      int palette = rx->waterfall_palette;
+
+      if (palette < 0 || palette >= NUM_WF_PALETTES) { palette = WF_PALETTE_STANDARD; }
+
+      if (!wf_lut_valid[palette]) { waterfall_build_lut(palette); }
+
+      const guint32 *lut = wf_lut[palette];
+      //
+      // First quantize the samples to LUT indices. This loop has no
+      // branches so the compiler can vectorize it.
+      // The lower clamp is written such that a NaN maps to the "below" entry.
+      //
+      float offset = soffset - wf_low;
+      float range = (wf_high > wf_low) ? wf_high - wf_low : 1.0F;
+      float scale = (float) WF_LUT_SIZE / range;
+      int index[width];
+
+      for (int i = 0; i < width; i++) {
+        float x = (samples[i] + offset) * scale;
+        x = (x >= -1.0F) ? x : -1.0F;
+        x = (x > (float) WF_LUT_SIZE) ? (float) WF_LUT_SIZE : x;
+        index[i] = (int)(x + 1.0F);
+      }
+
+      cairo_surface_flush(surface);
 
       for (int i = 0; i < width; i++) {
-        float sample = samples[i] + soffset;
-
-        if (sample < wf_low) {
-          *p++ = colorLowR;
-          *p++ = colorLowG;
-          *p++ = colorLowB;
-        } else if (sample > wf_high) {
-          *p++ = colorHighR;
-          *p++ = colorHighG;
-          *p++ = colorHighB;
-        } else {
-          float percent = (sample - wf_low) * rangei;
-
-          if (percent < 0.222222f) {
-            float local_percent = percent * 4.5f;
-            *p++ = (int)((1.0f - local_percent) * colorLowR);
-            *p++ = (int)((1.0f - local_percent) * colorLowG);
-            *p++ = (int)(colorLowB + local_percent * (255 - colorLowB));
-          } else if (percent < 0.333333f) {
-            float local_percent = (percent - 0.222222f) * 9.0f;
-            *p++ = 0;
-            *p++ = (int)(local_percent * 255);
-            *p++ = 255;
-          } else if (percent < 0.444444f) {
-            float local_percent = (percent - 0.333333) * 9.0f;
-            *p++ = 0;
-            *p++ = 255;
-            *p++ = (int)((1.0f - local_percent) * 255);
-          } else if (percent < 0.555555f) {
-            float local_percent = (percent - 0.444444f) * 9.0f;
-            *p++ = (int)(local_percent * 255);
-            *p++ = 255;
-            *p++ = 0;
-          } else if (percent < 0.777777f) {
-            float local_percent = (percent - 0.555555f) * 4.5f;
-            *p++ = 255;
-            *p++ = (int)((1.0f - local_percent) * 255);
-            *p++ = 0;
-          } else if (percent < 0.888888f) {
-            float local_percent = (percent - 0.777777f) * 9.0f;
-            *p++ = 255;
-            *p++ = 0;
-            *p++ = (int)(local_percent * 255);
-          } else {
-            float local_percent = (percent - 0.888888f) * 9.0f;
-            *p++ = (int)((0.75f + 0.25f * (1.0f - local_percent)) * 255.0f);
-            *p++ = (int)(local_percent * 255.0f * 0.5f);
-            *p++ = 255;
-          }
-        }
+        if (i == wrap) { p = row; }
+
+        *p++ = lut[index[i]];
       }
+
+      cairo_surface_mark_dirty_rectangle(surface, 0, rx->waterfall_head, width, 1);
     }
 
     gtk_widget_queue_draw (rx->waterfall);
@@ -289,8 +408,11 @@ void waterfall_update(RECEIVER *rx) {
 }
 
 void waterfall_init(RECEIVER *rx, int width, int height) {
-  rx->pixbuf = NULL;
+  rx->waterfall_surface = NULL;
   rx->waterfall_frequency = 0;
+  rx->waterfall_head = 0;
+  rx->waterfall_offset = 0;
+  rx->waterfall_average_count = 0;
   rx->waterfall = gtk_drawing_area_new ();
   gtk_widget_set_size_request (rx->waterfall, width, height);
   /* Signals used to handle the backing surface */
@@ -558,10 +558,31 @@ void flush_rxa (int channel)
 	flush_resample (rxa[channel].rsmpout.p);
 }
 
+/*
+ * Front end: frequency shift and decimation to the dsp rate. If both are
+ * active, the NCO mix is done while the samples enter the resampler ring,
+ * such that the high-rate input buffer is only read once.
+ */
+static void xshift_rsmpin (int channel)
+{
+	SHIFT s = rxa[channel].shift.p;
+	RESAMPLE r = rxa[channel].rsmpin.p;
+	if (s->run && r->run && s->in == r->in && s->size == r->size)
+	{
+		double cos_phase, sin_phase;
+		start_shift (s, &cos_phase, &sin_phase);
+		xresample_rotate (r, cos_phase, sin_phase, s->cos_delta, s->sin_delta);
+	}
+	else
+	{
+		xshift (s);
+		xresample (r);
+	}
+}
+
 void xrxa (int channel)
 {
-	xshift (rxa[channel].shift.p);
-	xresample (rxa[channel].rsmpin.p);
+	xshift_rsmpin (channel);
 	xgen (rxa[channel].gen0.p);
 	xmeter (rxa[channel].adcmeter.p);
 	xbpsnbain (rxa[channel].bpsnba.p, 0);
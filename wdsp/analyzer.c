@@ -656,6 +656,7 @@ DWORD WINAPI spectra (void *pargs)
 			for (j = 0; j < dMAX_STITCH; j++)
 				for (i = 0; i < dMAX_NUM_FFT; i++)
 					InterlockedBitTestAndReset(&(a->input_busy[j][i]), 0);
+			SetEvent(a->hDispatchEvent);
 			stitch(disp);
 		}
 		else
@@ -905,6 +906,7 @@ DWORD WINAPI Cspectra (void *pargs)
 			for (j = 0; j < dMAX_STITCH; j++)
 				for (i = 0; i < dMAX_NUM_FFT; i++)
 					InterlockedBitTestAndReset(&(a->input_busy[j][i]), 0);
+			SetEvent(a->hDispatchEvent);
 			stitch(disp);
 		}
 		else
@@ -1084,7 +1086,12 @@ void __cdecl sendbuf(void *arg)
 					LeaveCriticalSection(&(a->BufferControlSection[a->ss][a->LO]));
 				}
 			}
-		Sleep(1);
+		// sleep until Spectrum*() / CloseBuffer() marks a buffer ready, a
+		// spectrum calculation completes, or we are told to terminate.
+		// Then drain the event, since several signals may have piled up
+		// while scanning; all of them are covered by the next scan.
+		WaitForSingleObject(a->hDispatchEvent, INFINITE);
+		ResetEvent(a->hDispatchEvent);
 	}
 	InterlockedBitTestAndReset(&a->dispatcher, 0);
 	_endthread();
@@ -1196,6 +1203,7 @@ void SetAnalyzer (	int disp,			// display identifier
 
 	EnterCriticalSection(&a->SetAnalyzerSection);
 	a->end_dispatcher = 1;
+	SetEvent(a->hDispatchEvent);
 	while (InterlockedAnd(&a->dispatcher, 1))
 		Sleep(1);
 	a->stop = 1;
@@ -1220,8 +1228,8 @@ void SetAnalyzer (	int disp,			// display identifier
 			{
 				if (a->plan[i][j])		fftw_destroy_plan (a->plan[i][j]);
 				if (a->Cplan[i][j])		fftw_destroy_plan (a->Cplan[i][j]);
-				a->plan[i][j] = fftw_plan_dft_r2c_1d(sz, a->fft_in[i][j], a->fft_out[i][j], FFTW_PATIENT);
-				a->Cplan[i][j] = fftw_plan_dft_1d(sz, a->Cfft_in[i][j], a->fft_out[i][j], FFTW_FORWARD, FFTW_PATIENT);
+				a->plan[i][j] = fftw_plan_dft_r2c_1d(sz, a->fft_in[i][j], a->fft_out[i][j], FFTW_PLANNER);
+				a->Cplan[i][j] = fftw_plan_dft_1d(sz, a->Cfft_in[i][j], a->fft_out[i][j], FFTW_FORWARD, FFTW_PLANNER);
 			}
 
 		// Setup DetectMaxBin for a 'size' change.
@@ -1334,6 +1342,7 @@ void XCreateAnalyzer(	int disp,
 	a->max_stitch = m_stitch;
 	
 	a->pnum_threads = (LONG*) malloc0 (sizeof (LONG));
+	a->hDispatchEvent = CreateEvent(NULL, FALSE, FALSE, TEXT("dispatch"));
 
 	for (i = 0; i < a->max_stitch; i++)
 		for (j = 0; j < a->max_num_fft; j++)
@@ -1428,8 +1437,12 @@ void DestroyAnalyzer(int disp)
 	int i, j;
 
 	a->end_dispatcher = 1;
+	SetEvent(a->hDispatchEvent);
 	while (InterlockedAnd(&a->dispatcher, 1))
 		Sleep(1);
+	a->stop = 1;
+	while (_InterlockedAnd(a->pnum_threads, 1023))
+		Sleep(1);
 
 	for (i = 0; i < a->max_stitch; i++)
 		for (j = 0; j < a->max_num_fft; j++)
@@ -1491,6 +1504,7 @@ void DestroyAnalyzer(int disp)
 	for (i = 0; i < a->max_stitch; i++)
 		for (j = 0; j < a->max_num_fft; j++)
 			CloseHandle(a->hSnapEvent[i][j]);
+	CloseHandle(a->hDispatchEvent);
 
 	_aligned_free ((void *) a->pnum_threads);
 
@@ -1622,7 +1636,10 @@ void CloseBuffer(int disp, int ss, int LO)
 				a->have_samples[ss][LO] = a->max_writeahead;
 			}
 		if ((a->have_samples[ss][LO] += a->buff_size) >= a->size)
+		{
 			InterlockedBitTestAndSet(&(a->buff_ready[ss][LO]), 0);
+			SetEvent(a->hDispatchEvent);
+		}
 	LeaveCriticalSection(&(a->BufferControlSection[ss][LO]));
 	if((a->IQin_index[ss][LO] += a->buff_size) >= a->bsize)	//REQUIRES buff_size IS A SUB-MULTIPLE OF SIZE OF INPUT SAMPLE BUFFS!
 		a->IQin_index[ss][LO] = 0;
@@ -1661,7 +1678,10 @@ void Spectrum(int disp, int ss, int LO, dINREAL* pI, dINREAL* pQ)
 				a->have_samples[ss][LO] = a->max_writeahead;
 			}
 		if ((a->have_samples[ss][LO] += a->buff_size) >= a->size)
+		{
 			InterlockedBitTestAndSet(&(a->buff_ready[ss][LO]), 0);
+			SetEvent(a->hDispatchEvent);
+		}
 	LeaveCriticalSection(&(a->BufferControlSection[ss][LO]));
 	if((a->IQin_index[ss][LO] += a->buff_size) >= a->bsize)	//REQUIRES buff_size IS A SUB-MULTIPLE OF SIZE OF INPUT SAMPLE BUFFS!
 		a->IQin_index[ss][LO] = 0;
@@ -1706,7 +1726,10 @@ void Spectrum2(int run, int disp, int ss, int LO, dINREAL* pbuff)
 					a->have_samples[ss][LO] = a->max_writeahead;
 				}
 			if ((a->have_samples[ss][LO] += a->buff_size) >= a->size)
+			{
 				InterlockedBitTestAndSet(&(a->buff_ready[ss][LO]), 0);
+				SetEvent(a->hDispatchEvent);
+			}
 		LeaveCriticalSection(&(a->BufferControlSection[ss][LO]));
 		if((a->IQin_index[ss][LO] += a->buff_size) >= a->bsize)	//REQUIRES buff_size IS A SUB-MULTIPLE OF SIZE OF INPUT SAMPLE BUFFS!
 			a->IQin_index[ss][LO] = 0;
@@ -1752,7 +1775,10 @@ void Spectrum0(int run, int disp, int ss, int LO, double* pbuff)
 					a->have_samples[ss][LO] = a->max_writeahead;
 				}
 			if ((a->have_samples[ss][LO] += a->buff_size) >= a->size)
+			{
 				InterlockedBitTestAndSet(&(a->buff_ready[ss][LO]), 0);
+				SetEvent(a->hDispatchEvent);
+			}
 		LeaveCriticalSection(&(a->BufferControlSection[ss][LO]));
 		if((a->IQin_index[ss][LO] += a->buff_size) >= a->bsize)	//REQUIRES buff_size IS A SUB-MULTIPLE OF SIZE OF INPUT SAMPLE BUFFS!
 			a->IQin_index[ss][LO] = 0;
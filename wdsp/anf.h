@@ -42,8 +42,8 @@ typedef struct _anf
 	int delay;
 	double two_mu;
 	double gamma;
-	double d [ANF_DLINE_SIZE];
-	double w [ANF_DLINE_SIZE];
+	WDSP_REAL d [2 * ANF_DLINE_SIZE];	// mirrored: d[k] == d[k + dline_size]
+	WDSP_REAL w [ANF_DLINE_SIZE];
 	int in_idx;
 
 	double lidx;
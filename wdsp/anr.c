@@ -68,8 +68,8 @@ ANR create_anr	(
 	a->lincr = lincr;
 	a->ldecr = ldecr;
 	
-	memset (a->d, 0, sizeof(double) * ANR_DLINE_SIZE);
-	memset (a->w, 0, sizeof(double) * ANR_DLINE_SIZE);
+	memset (a->d, 0, sizeof(WDSP_REAL) * 2 * ANR_DLINE_SIZE);
+	memset (a->w, 0, sizeof(WDSP_REAL) * ANR_DLINE_SIZE);
 	
 	return a;
 }
@@ -81,7 +81,7 @@ void destroy_anr (ANR a)
 
 void xanr (ANR a, int position)
 {
-    int i, j, idx;
+    int i, idx;
     double c0, c1;
     double y, error, sigma, inv_sigp;
 	double nel, nev;
@@ -89,17 +89,11 @@ void xanr (ANR a, int position)
 	{
 		for (i = 0; i < a->buff_size; i++)
 		{
-			a->d[a->in_idx] = a->in_buff[2 * i + 0];
+			a->d[a->in_idx] = a->d[a->in_idx + a->dline_size] = (WDSP_REAL)a->in_buff[2 * i + 0];
 
-			y = 0;
-			sigma = 0;
-
-			for (j = 0; j < a->n_taps; j++)
-			{
-				idx = (a->in_idx + j + a->delay) & a->mask;
-				y += a->w[j] * a->d[idx];
-				sigma += a->d[idx] * a->d[idx];
-			}
+			// the delay line is mirrored, so the taps are contiguous from idx on
+			idx = (a->in_idx + a->delay) & a->mask;
+			lms_dot (a->w, &a->d[idx], a->n_taps, &y, &sigma);
 			inv_sigp = 1.0 / (sigma + 1e-10);
 			error = a->d[a->in_idx] - y;
 
@@ -121,11 +115,7 @@ void xanr (ANR a, int position)
 			c0 = 1.0 - a->two_mu * a->ngamma;
 			c1 = a->two_mu * error * inv_sigp;
 
-			for (j = 0; j < a->n_taps; j++)
-			{
-				idx = (a->in_idx + j + a->delay) & a->mask;
-				a->w[j] = c0 * a->w[j] + c1 * a->d[idx];
-			}
+			lms_update (a->w, &a->d[idx], a->n_taps, c0, c1);
 			a->in_idx = (a->in_idx + a->mask) & a->mask;
 		}
 	}
@@ -135,8 +125,8 @@ void xanr (ANR a, int position)
 
 void flush_anr (ANR a)
 {
-	memset (a->d, 0, sizeof(double) * ANR_DLINE_SIZE);
-	memset (a->w, 0, sizeof(double) * ANR_DLINE_SIZE);
+	memset (a->d, 0, sizeof(WDSP_REAL) * 2 * ANR_DLINE_SIZE);
+	memset (a->w, 0, sizeof(WDSP_REAL) * ANR_DLINE_SIZE);
 	a->in_idx = 0;
 }
 
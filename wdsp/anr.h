@@ -29,6 +29,39 @@ warren@wpratt.com
 
 #define ANR_DLINE_SIZE 2048
 
+// Normalized LMS kernels shared by ANR and ANF. d points to n contiguous
+// taps of the (mirrored) delay line. lms_dot() computes the filter output
+// and the tap energy in one pass, with two partial sums such that the loop
+// vectorizes (also without -ffast-math).
+static inline void lms_dot (const WDSP_REAL* restrict w, const WDSP_REAL* restrict d, int n, double* y, double* sigma)
+{
+	int j;
+	WDSP_REAL y0 = 0.0, y1 = 0.0, s0 = 0.0, s1 = 0.0;
+	for (j = 0; j < n - 1; j += 2)
+	{
+		y0 += w[j + 0] * d[j + 0];
+		y1 += w[j + 1] * d[j + 1];
+		s0 += d[j + 0] * d[j + 0];
+		s1 += d[j + 1] * d[j + 1];
+	}
+	if (j < n)
+	{
+		y0 += w[j] * d[j];
+		s0 += d[j] * d[j];
+	}
+	*y = y0 + y1;
+	*sigma = s0 + s1;
+}
+
+static inline void lms_update (WDSP_REAL* restrict w, const WDSP_REAL* restrict d, int n, double c0, double c1)
+{
+	int j;
+	const WDSP_REAL k0 = (WDSP_REAL)c0;
+	const WDSP_REAL k1 = (WDSP_REAL)c1;
+	for (j = 0; j < n; j++)
+		w[j] = k0 * w[j] + k1 * d[j];
+}
+
 typedef struct _anr
 {
 	int run;
@@ -42,8 +75,8 @@ typedef struct _anr
 	int delay;
 	double two_mu;
 	double gamma;
-	double d [ANR_DLINE_SIZE];
-	double w [ANR_DLINE_SIZE];
+	WDSP_REAL d [2 * ANR_DLINE_SIZE];	// mirrored: d[k] == d[k + dline_size]
+	WDSP_REAL w [ANR_DLINE_SIZE];
 	int in_idx;
 
 	double lidx;
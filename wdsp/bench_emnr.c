@@ -0,0 +1,362 @@
+/*
+ * bench_emnr
+ *
+ * This program checks the reworked xemnr() in emnr.c (mirrored input
+ * ring, modulo-free overlap-add, common a-priori SNR loop in calc_gain)
+ * against a copy of the previous implementation, and measures both.
+ *
+ * For each gain method, two EMNR instances with identical parameters
+ * (those of the RXA chain) process the same input, a pseudo-random noise
+ * with two carriers. The outputs must be bit-identical (memcmp), and the
+ * time per sample of both implementations is printed.
+ *
+ * It is not part of the library. Build it after the library with
+ *
+ *   gcc -O3 -pthread -o bench_emnr bench_emnr.c libwdsp.a `pkg-config --cflags --libs fftw3` -lm
+ *
+ * return values of main()
+ *
+ *  0  all OK
+ * -1  could not allocate buffers
+ * -2  output differs from the previous implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "comm.h"
+
+#define BENCH_SIZE    1024      // buffer size (samples per call)
+#define BENCH_FSIZE   4096      // FFT size
+#define BENCH_OVRLP   4         // overlap
+#define BENCH_RATE    48000     // sample rate
+#ifndef BENCH_SAMPLES
+#define BENCH_SAMPLES 2400000   // samples processed per measurement
+#endif
+
+#define BENCH_CALLS (BENCH_SAMPLES / BENCH_SIZE)
+
+//
+// not exported through emnr.h
+//
+extern double bessI0 (double x);
+extern double bessI1 (double x);
+extern double e1xb (double x);
+extern void LambdaD (EMNR a);
+extern void LambdaDs (EMNR a);
+extern void LambdaDl (EMNR a);
+extern void aepf (EMNR a);
+extern void post2 (EMNR a);
+extern int getZeta (EMNR a, double gamma, double eps, double* zeta);
+
+/********************************************************************************************************
+*                          Previous implementation (copied from emnr.c)                                 *
+********************************************************************************************************/
+
+static inline void getKeyIndex(double v, int* n1, int* n2, double* d)
+{
+	double t;
+	const double dmin = 0.001;
+	const double dmax = 1000.0;
+	if (v <= dmin)
+	{
+		*n1 = *n2 = 0;
+		t = 0.0;
+	}
+	else if (v >= dmax)
+	{
+		*n1 = *n2 = 240;
+		t = 60.0;
+	}
+	else
+	{
+		t = 10.0 * log10(v / dmin);
+		*n1 = (int)(4.0 * t);
+		*n2 = *n1 + 1;
+	}
+	*d = (t - 0.25 * *n1) / 0.25;
+}
+
+static inline double lookupKey(const double* type, int ngamma1, int ngamma2, double dg, int nxi1, int nxi2, double dx)
+{
+	return (1.0 - dg)  * (1.0 - dx) * type[241 * nxi1 + ngamma1]
+		+  (1.0 - dg)  *        dx  * type[241 * nxi2 + ngamma1]
+		+         dg   * (1.0 - dx) * type[241 * nxi1 + ngamma2]
+		+         dg   *        dx  * type[241 * nxi2 + ngamma2];
+}
+
+static void ref_calc_gain (EMNR a)
+{
+	int k;
+	for (k = 0; k < a->g.msize; k++)
+	{
+		a->g.lambda_y[k] = a->g.y[2 * k + 0] * a->g.y[2 * k + 0] + a->g.y[2 * k + 1] * a->g.y[2 * k + 1];
+	}
+	switch (a->g.npe_method)
+	{
+	case 0:
+		LambdaD(a);
+		break;
+	case 1:
+		LambdaDs(a);
+		break;
+	case 2:
+		LambdaDl(a);
+		break;
+	}
+	switch (a->g.gain_method)
+	{
+	case 0:
+		{
+			double gamma, eps_hat, v;
+			for (k = 0; k < a->g.msize; k++)
+			{
+				gamma = min (a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
+				eps_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
+					+ (1.0 - a->g.alpha) * max (gamma - 1.0, a->g.eps_floor);
+				eps_hat = max(eps_hat, a->g.xi_min);
+				v = (eps_hat / (1.0 + eps_hat)) * gamma;
+				a->g.mask[k] = a->g.gf1p5 * sqrt (v) / gamma * exp (- 0.5 * v)
+					* ((1.0 + v) * bessI0 (0.5 * v) + v * bessI1 (0.5 * v));
+				{
+					double v2 = min (v, 700.0);
+					double eta = a->g.mask[k] * a->g.mask[k] * a->g.lambda_y[k] / a->g.lambda_d[k];
+					double eps = eta / (1.0 - a->g.q);
+					double witchHat = (1.0 - a->g.q) / a->g.q * exp (v2) / (1.0 + eps);
+					a->g.mask[k] *= witchHat / (1.0 + witchHat);
+				}
+				if (a->g.mask[k] > a->g.gmax) a->g.mask[k] = a->g.gmax;
+				if (a->g.mask[k] != a->g.mask[k]) a->g.mask[k] = 0.01;
+				a->g.prev_gamma[k] = gamma;
+				a->g.prev_mask[k] = a->g.mask[k];
+			}
+			break;
+		}
+	case 1:
+		{
+			double gamma, eps_hat, v, ehr;
+			for (k = 0; k < a->g.msize; k++)
+			{
+				gamma = min (a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
+				eps_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
+					+ (1.0 - a->g.alpha) * max (gamma - 1.0, a->g.eps_floor);
+				ehr = eps_hat / (1.0 + eps_hat);
+				v = ehr * gamma;
+				if((a->g.mask[k] = ehr * exp (min (700.0, 0.5 * e1xb(v)))) > a->g.gmax) a->g.mask[k] = a->g.gmax;
+				if (a->g.mask[k] != a->g.mask[k])a->g.mask[k] = 0.01;
+				a->g.prev_gamma[k] = gamma;
+				a->g.prev_mask[k] = a->g.mask[k];
+			}
+			break;
+		}
+	case 2:
+		{
+			double gamma, eps_hat, eps_p;
+			int ng1, ng2, nx1, nx2, np1, np2;
+			double dg, dx, dp;
+			for (k = 0; k < a->g.msize; k++)
+			{
+				gamma = min(a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
+				eps_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
+					+ (1.0 - a->g.alpha) * max(gamma - 1.0, a->g.eps_floor);
+				eps_p = eps_hat / (1.0 - a->g.q);
+				getKeyIndex(gamma, &ng1, &ng2, &dg);
+				getKeyIndex(eps_hat, &nx1, &nx2, &dx);
+				getKeyIndex(eps_p, &np1, &np2, &dp);
+				a->g.mask[k] = lookupKey(a->g.GG, ng1, ng2, dg, nx1, nx2, dx)
+					* lookupKey(a->g.GGS, ng1, ng2, dg, np1, np2, dp);
+				a->g.prev_gamma[k] = gamma;
+				a->g.prev_mask[k] = a->g.mask[k];
+			}
+			break;
+		}
+	case 3:
+		{
+			double gamma, xi_hat, v, zeta_hat;
+			for (k = 0; k < a->g.msize; k++)
+			{
+				gamma = min(a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
+				xi_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
+					+ (1.0 - a->g.alpha) * max(gamma - 1.0, a->g.eps_floor);
+				xi_hat = max(xi_hat, a->g.xi_min);
+				v = (xi_hat / (1.0 + xi_hat)) * gamma;
+				a->g.mask[k] = a->g.gf1p5 * sqrt(v) / gamma * exp(-0.5 * v)
+					* ((1.0 + v) * bessI0(0.5 * v) + v * bessI1(0.5 * v));
+				{
+					double v2 = min(v, 700.0);
+					double eta = a->g.mask[k] * a->g.mask[k] * a->g.lambda_y[k] / a->g.lambda_d[k];
+					double eps = eta / (1.0 - a->g.q);
+					double witchHat = (1.0 - a->g.q) / a->g.q * exp(v2) / (1.0 + eps);
+					a->g.mask[k] *= witchHat / (1.0 + witchHat);
+				}
+				if (a->g.mask[k] > a->g.gmax) a->g.mask[k] = a->g.gmax;
+				if (a->g.mask[k] != a->g.mask[k]) a->g.mask[k] = 0.01;
+				a->g.prev_mask[k] = a->g.mask[k];
+				a->g.prev_gamma[k] = gamma;
+
+				{
+					double xi_ts = a->g.mask[k] * a->g.mask[k] * gamma;
+					xi_ts = max(xi_ts, a->g.xi_min);
+					double v_ts = (xi_ts / (1.0 + xi_ts)) * gamma;
+					a->g.mask[k] = a->g.gf1p5 * sqrt(v_ts) / gamma * exp(-0.5 * v_ts)
+						* ((1.0 + v_ts) * bessI0(0.5 * v_ts) + v_ts * bessI1(0.5 * v_ts));
+					double v2 = min(v_ts, 700.0);
+					double eta = a->g.mask[k] * a->g.mask[k] * a->g.lambda_y[k] / a->g.lambda_d[k];
+					double eps = eta / (1.0 - a->g.q);
+					double witchHat = (1.0 - a->g.q) / a->g.q * exp(v2) / (1.0 + eps);
+					a->g.mask[k] *= witchHat / (1.0 + witchHat);
+					xi_hat = xi_ts;
+				}
+				if (a->g.mask[k] > a->g.gmax) a->g.mask[k] = a->g.gmax;
+				if (a->g.mask[k] != a->g.mask[k]) a->g.mask[k] = 0.01;
+
+				if (getZeta(a, gamma, xi_hat, &zeta_hat) >= 0)
+				{
+					if (zeta_hat > a->g.zeta_thresh) a->g.mask[k] = 1.0;
+					else                             a->g.mask[k] = 0.0;
+				}
+			}
+			break;
+		}
+	}
+	if (a->g.ae_run) aepf(a);
+}
+
+// inaccum is only used as a plain ring of iasize samples here
+static void ref_xemnr (EMNR a, int pos)
+{
+	if (a->run && pos == a->position)
+	{
+		int i, j, k, sbuff, sbegin;
+		double g1;
+		for (i = 0; i < 2 * a->bsize; i += 2)
+		{
+			a->inaccum[a->iainidx] = a->in[i];
+			a->iainidx = (a->iainidx + 1) % a->iasize;
+		}
+		a->nsamps += a->bsize;
+		while (a->nsamps >= a->fsize)
+		{
+			for (i = 0, j = a->iaoutidx; i < a->fsize; i++, j = (j + 1) % a->iasize)
+				a->forfftin[i] = a->window[i] * a->inaccum[j];
+			a->iaoutidx = (a->iaoutidx + a->incr) % a->iasize;
+			a->nsamps -= a->incr;
+			fftw_execute (a->Rfor);
+			ref_calc_gain(a);
+			for (i = 0; i < a->msize; i++)
+			{
+				g1 = a->gain * a->mask[i];
+				a->revfftin[2 * i + 0] = g1 * a->forfftout[2 * i + 0];
+				a->revfftin[2 * i + 1] = g1 * a->forfftout[2 * i + 1];
+			}
+			post2(a);
+			fftw_execute (a->Rrev);
+			for (i = 0; i < a->fsize; i++)
+				a->save[a->saveidx][i] = a->window[i] * a->revfftout[i];
+			for (i = a->ovrlp; i > 0; i--)
+			{
+				sbuff = (a->saveidx + i) % a->ovrlp;
+				sbegin = a->incr * (a->ovrlp - i);
+				for (j = sbegin, k = a->oainidx; j < a->incr + sbegin; j++, k = (k + 1) % a->oasize)
+				{
+					if ( i == a->ovrlp)
+						a->outaccum[k]  = a->save[sbuff][j];
+					else
+						a->outaccum[k] += a->save[sbuff][j];
+				}
+			}
+			a->saveidx = (a->saveidx + 1) % a->ovrlp;
+			a->oainidx = (a->oainidx + a->incr) % a->oasize;
+		}
+		for (i = 0; i < a->bsize; i++)
+		{
+			a->out[2 * i + 0] = a->outaccum[a->oaoutidx];
+			a->out[2 * i + 1] = 0.0;
+			a->oaoutidx = (a->oaoutidx + 1) % a->oasize;
+		}
+	}
+	else if (a->out != a->in)
+		memcpy (a->out, a->in, a->bsize * sizeof (complex));
+}
+
+/********************************************************************************************************
+*                                           Benchmark                                                   *
+********************************************************************************************************/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+//
+// run one EMNR instance over the whole input, return ns/sample
+//
+static double run(EMNR a, void (*process)(EMNR, int), const double *input, double *output) {
+  int i;
+  double t = now();
+
+  for (i = 0; i < BENCH_CALLS; i++) {
+    memcpy(a->in, input + 2 * i * BENCH_SIZE, BENCH_SIZE * sizeof(complex));
+    process(a, 0);
+    memcpy(output + 2 * i * BENCH_SIZE, a->out, BENCH_SIZE * sizeof(complex));
+  }
+
+  return (now() - t) * 1.0e9 / ((double) BENCH_CALLS * BENCH_SIZE);
+}
+
+int main() {
+  int method, i, same;
+  unsigned int seed = 12345;
+  double *input, *ref_out, *new_out, *ref_buf, *new_buf;
+  double t_ref, t_new;
+  double w1 = TWOPI * 1000.0 / BENCH_RATE;
+  double w2 = TWOPI * 2300.0 / BENCH_RATE;
+  EMNR ref, cur;
+  int rc = 0;
+  input = (double *) malloc(BENCH_CALLS * BENCH_SIZE * sizeof(complex));
+  ref_out = (double *) malloc(BENCH_CALLS * BENCH_SIZE * sizeof(complex));
+  new_out = (double *) malloc(BENCH_CALLS * BENCH_SIZE * sizeof(complex));
+  ref_buf = (double *) malloc0(BENCH_SIZE * sizeof(complex));
+  new_buf = (double *) malloc0(BENCH_SIZE * sizeof(complex));
+
+  if (input == NULL || ref_out == NULL || new_out == NULL || ref_buf == NULL || new_buf == NULL) {
+    printf("Could not allocate buffers\n");
+    return -1;
+  }
+
+  //
+  // fixed input: LCG noise with two carriers (EMNR only uses the I channel)
+  //
+  for (i = 0; i < BENCH_CALLS * BENCH_SIZE; i++) {
+    seed = 1664525 * seed + 1013904223;
+    input[2 * i + 0] = 0.1 * ((double) seed / 4294967296.0 - 0.5) + 0.01 * cos(w1 * i) + 0.003 * cos(w2 * i);
+    input[2 * i + 1] = 0.0;
+  }
+
+  printf("buffer size %d, FFT size %d, overlap %d, %d samples\n", BENCH_SIZE, BENCH_FSIZE, BENCH_OVRLP,
+         BENCH_CALLS * BENCH_SIZE);
+  printf("gain method   previous ns/sample   current ns/sample   result\n");
+
+  for (method = 0; method < 4; method++) {
+    ref = create_emnr(1, 0, BENCH_SIZE, ref_buf, ref_buf, BENCH_FSIZE, BENCH_OVRLP, BENCH_RATE, 0, 1.0, method, 0, 1);
+    cur = create_emnr(1, 0, BENCH_SIZE, new_buf, new_buf, BENCH_FSIZE, BENCH_OVRLP, BENCH_RATE, 0, 1.0, method, 0, 1);
+    t_ref = run(ref, ref_xemnr, input, ref_out);
+    t_new = run(cur, xemnr, input, new_out);
+
+    same = (memcmp(ref_out, new_out, BENCH_CALLS * BENCH_SIZE * sizeof(complex)) == 0);
+
+    if (!same) { rc = -2; }
+
+    printf("%11d   %18.2f   %17.2f   %s\n", method, t_ref, t_new, same ? "identical" : "DIFFERENT");
+    destroy_emnr(ref);
+    destroy_emnr(cur);
+  }
+
+  free(input);
+  free(ref_out);
+  free(new_out);
+  _aligned_free(ref_buf);
+  _aligned_free(new_buf);
+  return rc;
+}
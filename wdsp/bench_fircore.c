@@ -0,0 +1,85 @@
+/*
+ * bench_fircore
+ *
+ * This program measures the speed of the partitioned FFT convolution
+ * (xfircore() in firmin.c) for a number of partition counts and prints
+ * the time per output sample, and per output sample and partition.
+ * The latter is dominated by the multiply-accumulate kernel.
+ *
+ * It is not part of the library. Build it after the library with
+ *
+ *   gcc -O3 -pthread -o bench_fircore bench_fircore.c libwdsp.a `pkg-config --cflags --libs fftw3` -lm
+ *
+ * return values of main()
+ *
+ *  0  all OK
+ * -1  could not allocate buffers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "comm.h"
+
+#define BENCH_SIZE    1024      // buffer size (samples per call)
+#define BENCH_SAMPLES 20000000  // samples processed per measurement
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+int main() {
+  int parts[] = { 1, 2, 4, 8, 16, 32 };
+  int p, i, n, calls;
+  double *in, *out, *impulse;
+  double t;
+  FIRCORE a;
+  in = (double *) malloc(BENCH_SIZE * sizeof(complex));
+  out = (double *) malloc(2 * BENCH_SIZE * sizeof(complex));    // the inverse FFT fills 2*size samples
+  impulse = (double *) malloc(32 * BENCH_SIZE * sizeof(complex));
+
+  if (in == NULL || out == NULL || impulse == NULL) {
+    printf("Could not allocate buffers\n");
+    return -1;
+  }
+
+  srand(1);
+
+  for (i = 0; i < 2 * BENCH_SIZE; i++) {
+    in[i] = (double) rand() / RAND_MAX - 0.5;
+  }
+
+  for (i = 0; i < 2 * 32 * BENCH_SIZE; i++) {
+    impulse[i] = ((double) rand() / RAND_MAX - 0.5) * 1.0e-3;
+  }
+
+  printf("buffer size %d\n", BENCH_SIZE);
+  printf("partitions   ns/sample   ns/sample/partition\n");
+
+  for (p = 0; p < (int)(sizeof(parts) / sizeof(parts[0])); p++) {
+    n = parts[p] * BENCH_SIZE;
+    a = create_fircore(BENCH_SIZE, in, out, n, 0, impulse);
+    calls = BENCH_SAMPLES / BENCH_SIZE / parts[p];
+
+    for (i = 0; i < 16; i++) {   // warm-up
+      xfircore(a);
+    }
+
+    t = now();
+
+    for (i = 0; i < calls; i++) {
+      xfircore(a);
+    }
+
+    t = (now() - t) * 1.0e9 / ((double) calls * BENCH_SIZE);
+    printf("%10d   %9.2f   %19.3f\n", parts[p], t, t / parts[p]);
+    destroy_fircore(a);
+  }
+
+  free(impulse);
+  free(out);
+  free(in);
+  return 0;
+}
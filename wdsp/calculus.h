@@ -1,8 +1,8 @@
 #ifndef _calculus_h
 #define _calculus_h
 
-extern double GG[];
+extern const double GG[];
 
-extern double GGS[];
+extern const double GGS[];
 
 #endif
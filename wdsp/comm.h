@@ -45,6 +45,14 @@ warren@wpratt.com
 #endif
 #include "fftw3.h"
 
+// Sample type of the blocks that support single precision: the ring buffers
+// and coefficients of the resamplers, and the ANR/ANF delay lines and
+// weights. "make WDSP_REAL=float" selects float; the main data path
+// (channel buffers, FFTs) stays double.
+#ifndef WDSP_REAL
+#define WDSP_REAL double
+#endif
+
 #include "amd.h"
 #include "ammod.h"
 #include "amsq.h"
@@ -133,6 +141,9 @@ warren@wpratt.com
 // wisdom definitions
 #define MAX_WISDOM_SIZE_DISPLAY			262144
 #define MAX_WISDOM_SIZE_FILTER			262144				// was 32769
+#define MAX_WISDOM_SIZE_QUICK			16384				// sizes covered by the quick (FFTW_MEASURE) start-up pass
+#define FFTW_PLANNER					wisdom_planner_flags	// planner rigor for run-time plans, see wisdom.c
+extern int wisdom_planner_flags;
 
 // math definitions
 #define PI								3.1415926535897932
@@ -329,7 +329,7 @@ void calc_emnr(EMNR a)
 	a->oaoutidx = 0;
 	a->msize = a->fsize / 2 + 1;
 	a->window = (double *)malloc0(a->fsize * sizeof(double));
-	a->inaccum = (double *)malloc0(a->iasize * sizeof(double));
+	a->inaccum = (double *)malloc0(2 * a->iasize * sizeof(double));
 	a->forfftin = (double *)malloc0(a->fsize * sizeof(double));
 	a->forfftout = (double *)malloc0(a->msize * sizeof(complex));
 	a->mask = (double *)malloc0(a->msize * sizeof(double));
@@ -353,6 +353,7 @@ void calc_emnr(EMNR a)
 	a->g.lambda_d    = (double*)malloc0(a->msize * sizeof(double));
 	a->g.prev_gamma  = (double*)malloc0(a->msize * sizeof(double));
 	a->g.prev_mask   = (double*)malloc0(a->msize * sizeof(double));
+	a->g.eps_hat     = (double*)malloc0(a->msize * sizeof(double));
 
 	a->g.gf1p5 = sqrt(PI) / 2.0;
 	{
@@ -370,18 +371,21 @@ void calc_emnr(EMNR a)
 	}
 	a->g.gmax = 10000.0;
 	//
-	a->g.GG = (double *)malloc0(241 * 241 * sizeof(double));
-	a->g.GGS = (double *)malloc0(241 * 241 * sizeof(double));
+	// the built-in tables are shared by all instances, only a "calculus" file is read into private copies
 	if (a->g.fileb = fopen("calculus", "rb"))
 	{
-		fread(a->g.GG, sizeof(double), 241 * 241, a->g.fileb);
-		fread(a->g.GGS, sizeof(double), 241 * 241, a->g.fileb);
+		double* gg  = (double *)malloc0(241 * 241 * sizeof(double));
+		double* ggs = (double *)malloc0(241 * 241 * sizeof(double));
+		fread(gg, sizeof(double), 241 * 241, a->g.fileb);
+		fread(ggs, sizeof(double), 241 * 241, a->g.fileb);
 		fclose(a->g.fileb);
+		a->g.GG = gg;
+		a->g.GGS = ggs;
 	}
 	else
 	{
-		memcpy (a->g.GG,  GG,  241 * 241 * sizeof(double));
-		memcpy (a->g.GGS, GGS, 241 * 241 * sizeof(double));
+		a->g.GG = GG;
+		a->g.GGS = GGS;
 	}
 	//
 	a->g.dim_zeta = 60;
@@ -612,8 +616,9 @@ void decalc_emnr(EMNR a)
 	// g
 	_aligned_free(a->g.zeta_true);
 	_aligned_free(a->g.zeta_hat);
-	_aligned_free(a->g.GGS);
-	_aligned_free(a->g.GG);
+	if (a->g.GGS != GGS) _aligned_free((void *)a->g.GGS);
+	if (a->g.GG != GG) _aligned_free((void *)a->g.GG);
+	_aligned_free(a->g.eps_hat);
 	_aligned_free(a->g.prev_mask);
 	_aligned_free(a->g.prev_gamma);
 	_aligned_free(a->g.lambda_d);
@@ -659,7 +664,7 @@ EMNR create_emnr (int run, int position, int size, double* in, double* out, int
 void flush_emnr (EMNR a)
 {
 	int i;
-	memset (a->inaccum, 0, a->iasize * sizeof (double));
+	memset (a->inaccum, 0, 2 * a->iasize * sizeof (double));
 	for (i = 0; i < a->ovrlp; i++)
 		memset (a->save[i], 0, a->fsize * sizeof (double));
 	memset (a->outaccum, 0, a->oasize * sizeof (double));
@@ -998,52 +1003,51 @@ void SetRXAEMNRpost2Rate(int channel, double tc)
 *                               End Post-Processing Functions                                           *
 ********************************************************************************************************/
 
-double getKey(double* type, double gamma, double xi)
+// Position of v on the axis of the GG/GGS tables: 241 points in 0.25 dB steps
+// from 0.001 to 1000. Returns the two neighbouring grid indices and the
+// fractional distance from the first one.
+static inline void getKeyIndex(double v, int* n1, int* n2, double* d)
 {
-	int ngamma1, ngamma2, nxi1, nxi2;
-	double tg, tx, dg, dx;
+	double t;
 	const double dmin = 0.001;
 	const double dmax = 1000.0;
-	if (gamma <= dmin)
+	if (v <= dmin)
 	{
-		ngamma1 = ngamma2 = 0;
-		tg = 0.0;
+		*n1 = *n2 = 0;
+		t = 0.0;
 	}
-	else if (gamma >= dmax)
+	else if (v >= dmax)
 	{
-		ngamma1 = ngamma2 = 240;
-		tg = 60.0;
+		*n1 = *n2 = 240;
+		t = 60.0;
 	}
 	else
 	{
-		tg = 10.0 * log10(gamma / dmin);
-		ngamma1 = (int)(4.0 * tg);
-		ngamma2 = ngamma1 + 1;
-	}
-	if (xi <= dmin)
-	{
-		nxi1 = nxi2 = 0;
-		tx = 0.0;
+		t = 10.0 * log10(v / dmin);
+		*n1 = (int)(4.0 * t);
+		*n2 = *n1 + 1;
 	}
-	else if (xi >= dmax)
-	{
-		nxi1 = nxi2 = 240;
-		tx = 60.0;
-	}
-	else
-	{
-		tx = 10.0 * log10(xi / dmin);
-		nxi1 = (int)(4.0 * tx);
-		nxi2 = nxi1 + 1;
-	}
-	dg = (tg - 0.25 * ngamma1) / 0.25;
-	dx = (tx - 0.25 * nxi1) / 0.25;
+	*d = (t - 0.25 * *n1) / 0.25;
+}
+
+// bilinear interpolation at a grid position found by getKeyIndex()
+static inline double lookupKey(const double* type, int ngamma1, int ngamma2, double dg, int nxi1, int nxi2, double dx)
+{
 	return (1.0 - dg)  * (1.0 - dx) * type[241 * nxi1 + ngamma1]
 		+  (1.0 - dg)  *        dx  * type[241 * nxi2 + ngamma1]
 		+         dg   * (1.0 - dx) * type[241 * nxi1 + ngamma2]
 		+         dg   *        dx  * type[241 * nxi2 + ngamma2];
 }
 
+double getKey(const double* type, double gamma, double xi)
+{
+	int ngamma1, ngamma2, nxi1, nxi2;
+	double dg, dx;
+	getKeyIndex(gamma, &ngamma1, &ngamma2, &dg);
+	getKeyIndex(xi, &nxi1, &nxi2, &dx);
+	return lookupKey(type, ngamma1, ngamma2, dg, nxi1, nxi2, dx);
+}
+
 int getZeta( EMNR a, double gamma, double eps, double* zeta)
 {
 	int index, i_gamma, i_xi;
@@ -1066,6 +1070,23 @@ int getZeta( EMNR a, double gamma, double eps, double* zeta)
 	return 0;
 }
 
+// a-posteriori SNR (becomes the new prev_gamma) and decision-directed a-priori SNR
+// estimate; common to all gain methods and free of calls, so the loop vectorizes
+static void calc_eps_hat (int n, double alpha, double eps_floor, double gamma_max,
+	const double* restrict lambda_y, const double* restrict lambda_d,
+	const double* restrict prev_mask, double* restrict prev_gamma, double* restrict eps_hat)
+{
+	int k;
+	double gamma;
+	for (k = 0; k < n; k++)
+	{
+		gamma = min (lambda_y[k] / lambda_d[k], gamma_max);
+		eps_hat[k] = alpha * prev_mask[k] * prev_mask[k] * prev_gamma[k]
+			+ (1.0 - alpha) * max (gamma - 1.0, eps_floor);
+		prev_gamma[k] = gamma;
+	}
+}
+
 void calc_gain (EMNR a)
 {
 	int k;
@@ -1085,6 +1106,8 @@ void calc_gain (EMNR a)
 		LambdaDl(a);
 		break;
 	}
+	calc_eps_hat (a->g.msize, a->g.alpha, a->g.eps_floor, a->g.gamma_max,
+		a->g.lambda_y, a->g.lambda_d, a->g.prev_mask, a->g.prev_gamma, a->g.eps_hat);
 	switch (a->g.gain_method)
 	{
 	case 0:
@@ -1092,10 +1115,8 @@ void calc_gain (EMNR a)
 			double gamma, eps_hat, v;
 			for (k = 0; k < a->g.msize; k++)
 			{
-				gamma = min (a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
-				eps_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
-					+ (1.0 - a->g.alpha) * max (gamma - 1.0, a->g.eps_floor);
-				eps_hat = max(eps_hat, a->g.xi_min);
+				gamma = a->g.prev_gamma[k];
+				eps_hat = max(a->g.eps_hat[k], a->g.xi_min);
 				v = (eps_hat / (1.0 + eps_hat)) * gamma;
 				a->g.mask[k] = a->g.gf1p5 * sqrt (v) / gamma * exp (- 0.5 * v)
 					* ((1.0 + v) * bessI0 (0.5 * v) + v * bessI1 (0.5 * v));
@@ -1108,7 +1129,6 @@ void calc_gain (EMNR a)
 				}
 				if (a->g.mask[k] > a->g.gmax) a->g.mask[k] = a->g.gmax;
 				if (a->g.mask[k] != a->g.mask[k]) a->g.mask[k] = 0.01;
-				a->g.prev_gamma[k] = gamma;
 				a->g.prev_mask[k] = a->g.mask[k];
 			}
 			break;
@@ -1118,14 +1138,12 @@ void calc_gain (EMNR a)
 			double gamma, eps_hat, v, ehr;
 			for (k = 0; k < a->g.msize; k++)
 			{
-				gamma = min (a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
-				eps_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
-					+ (1.0 - a->g.alpha) * max (gamma - 1.0, a->g.eps_floor);
+				gamma = a->g.prev_gamma[k];
+				eps_hat = a->g.eps_hat[k];
 				ehr = eps_hat / (1.0 + eps_hat);
 				v = ehr * gamma;
 				if((a->g.mask[k] = ehr * exp (min (700.0, 0.5 * e1xb(v)))) > a->g.gmax) a->g.mask[k] = a->g.gmax;
 				if (a->g.mask[k] != a->g.mask[k])a->g.mask[k] = 0.01;
-				a->g.prev_gamma[k] = gamma;
 				a->g.prev_mask[k] = a->g.mask[k];
 			}
 			break;
@@ -1133,14 +1151,19 @@ void calc_gain (EMNR a)
 	case 2:
 		{
 			double gamma, eps_hat, eps_p;
+			int ng1, ng2, nx1, nx2, np1, np2;
+			double dg, dx, dp;
 			for (k = 0; k < a->g.msize; k++)
 			{
-				gamma = min(a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
-				eps_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
-					+ (1.0 - a->g.alpha) * max(gamma - 1.0, a->g.eps_floor);
+				gamma = a->g.prev_gamma[k];
+				eps_hat = a->g.eps_hat[k];
 				eps_p = eps_hat / (1.0 - a->g.q);
-				a->g.mask[k] = getKey(a->g.GG, gamma, eps_hat) * getKey(a->g.GGS, gamma, eps_p);
-				a->g.prev_gamma[k] = gamma;
+				// both tables share the gamma axis, so its position is computed once
+				getKeyIndex(gamma, &ng1, &ng2, &dg);
+				getKeyIndex(eps_hat, &nx1, &nx2, &dx);
+				getKeyIndex(eps_p, &np1, &np2, &dp);
+				a->g.mask[k] = lookupKey(a->g.GG, ng1, ng2, dg, nx1, nx2, dx)
+					* lookupKey(a->g.GGS, ng1, ng2, dg, np1, np2, dp);
 				a->g.prev_mask[k] = a->g.mask[k];
 			}
 			break;
@@ -1150,10 +1173,8 @@ void calc_gain (EMNR a)
 			double gamma, xi_hat, v, zeta_hat;
 			for (k = 0; k < a->g.msize; k++)
 			{
-				gamma = min(a->g.lambda_y[k] / a->g.lambda_d[k], a->g.gamma_max);
-				xi_hat = a->g.alpha * a->g.prev_mask[k] * a->g.prev_mask[k] * a->g.prev_gamma[k]
-					+ (1.0 - a->g.alpha) * max(gamma - 1.0, a->g.eps_floor);
-				xi_hat = max(xi_hat, a->g.xi_min);
+				gamma = a->g.prev_gamma[k];
+				xi_hat = max(a->g.eps_hat[k], a->g.xi_min);
 				v = (xi_hat / (1.0 + xi_hat)) * gamma;
 				a->g.mask[k] = a->g.gf1p5 * sqrt(v) / gamma * exp(-0.5 * v)
 					* ((1.0 + v) * bessI0(0.5 * v) + v * bessI1(0.5 * v));
@@ -1167,7 +1188,6 @@ void calc_gain (EMNR a)
 				if (a->g.mask[k] > a->g.gmax) a->g.mask[k] = a->g.gmax;
 				if (a->g.mask[k] != a->g.mask[k]) a->g.mask[k] = 0.01;
 				a->g.prev_mask[k] = a->g.mask[k];
-				a->g.prev_gamma[k] = gamma;
 
 				{
 					double xi_ts = a->g.mask[k] * a->g.mask[k] * gamma;
@@ -1201,19 +1221,23 @@ void xemnr (EMNR a, int pos)
 {
 	if (a->run && pos == a->position)
 	{
-		int i, j, k, sbuff, sbegin;
+		int i, j, sbuff, n1, n2;
 		double g1;
-		for (i = 0; i < 2 * a->bsize; i += 2)
+		double *inp, *outp, *savep;
+		// inaccum is mirrored (each sample is also stored at index + iasize),
+		// so that a frame can always be read as one contiguous block
+		for (i = 0; i < a->bsize; i++)
 		{
-			a->inaccum[a->iainidx] = a->in[i];
-			a->iainidx = (a->iainidx + 1) % a->iasize;
+			a->inaccum[a->iainidx] = a->inaccum[a->iainidx + a->iasize] = a->in[2 * i + 0];
+			if (++a->iainidx == a->iasize) a->iainidx = 0;
 		}
 		a->nsamps += a->bsize;
 		while (a->nsamps >= a->fsize)
 		{
-			for (i = 0, j = a->iaoutidx; i < a->fsize; i++, j = (j + 1) % a->iasize)
-				a->forfftin[i] = a->window[i] * a->inaccum[j];
-			a->iaoutidx = (a->iaoutidx + a->incr) % a->iasize;
+			inp = a->inaccum + a->iaoutidx;
+			for (i = 0; i < a->fsize; i++)
+				a->forfftin[i] = a->window[i] * inp[i];
+			if ((a->iaoutidx += a->incr) >= a->iasize) a->iaoutidx -= a->iasize;
 			a->nsamps -= a->incr;
 			fftw_execute (a->Rfor);
 			calc_gain(a);
@@ -1225,28 +1249,32 @@ void xemnr (EMNR a, int pos)
 			}
                         post2(a);
 			fftw_execute (a->Rrev);
+			// overlap-add: the output segment wraps at most once in outaccum
+			outp = a->outaccum + a->oainidx;
+			if ((n1 = a->oasize - a->oainidx) > a->incr) n1 = a->incr;
+			n2 = a->incr - n1;
+			savep = a->save[a->saveidx];
 			for (i = 0; i < a->fsize; i++)
-				a->save[a->saveidx][i] = a->window[i] * a->revfftout[i];
-			for (i = a->ovrlp; i > 0; i--)
+				savep[i] = a->window[i] * a->revfftout[i];
+			memcpy (outp, savep, n1 * sizeof (double));
+			memcpy (a->outaccum, savep + n1, n2 * sizeof (double));
+			for (i = a->ovrlp - 1; i > 0; i--)
 			{
-				sbuff = (a->saveidx + i) % a->ovrlp;
-				sbegin = a->incr * (a->ovrlp - i);
-				for (j = sbegin, k = a->oainidx; j < a->incr + sbegin; j++, k = (k + 1) % a->oasize)
-				{
-					if ( i == a->ovrlp)
-						a->outaccum[k]  = a->save[sbuff][j];
-					else
-						a->outaccum[k] += a->save[sbuff][j];
-				}
+				if ((sbuff = a->saveidx + i) >= a->ovrlp) sbuff -= a->ovrlp;
+				savep = a->save[sbuff] + a->incr * (a->ovrlp - i);
+				for (j = 0; j < n1; j++)
+					outp[j] += savep[j];
+				for (j = 0; j < n2; j++)
+					a->outaccum[j] += savep[n1 + j];
 			}
-			a->saveidx = (a->saveidx + 1) % a->ovrlp;
-			a->oainidx = (a->oainidx + a->incr) % a->oasize;
+			if (++a->saveidx == a->ovrlp) a->saveidx = 0;
+			if ((a->oainidx += a->incr) >= a->oasize) a->oainidx -= a->oasize;
 		}
 		for (i = 0; i < a->bsize; i++)
 		{
 			a->out[2 * i + 0] = a->outaccum[a->oaoutidx];
 			a->out[2 * i + 1] = 0.0;
-			a->oaoutidx = (a->oaoutidx + 1) % a->oasize;
+			if (++a->oaoutidx == a->oasize) a->oaoutidx = 0;
 		}
 	}
 	else if (a->out != a->in)
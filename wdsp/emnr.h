@@ -74,6 +74,7 @@ typedef struct _emnr
 		double* lambda_d;
 		double* prev_mask;
 		double* prev_gamma;
+		double* eps_hat;
 		double gf1p5;
 		double alpha;
 		double eps_floor;
@@ -82,8 +83,8 @@ typedef struct _emnr
 		double q;
 		double gmax;
 		//
-		double* GG;
-		double* GGS;
+		const double* GG;		// the built-in tables, or copies read from the file "calculus"
+		const double* GGS;
 		FILE* fileb;
 		//
 		int dim_zeta;
@@ -145,11 +145,11 @@ void plan_firopt (FIROPT a)
 	{
 		a->fftout[i] = (double *) malloc0 (2 * a->size * sizeof (complex));
 		a->fmask[i] = (double *) malloc0 (2 * a->size * sizeof (complex));
-		a->pcfor[i] = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->fftin, (fftw_complex *)a->fftout[i], FFTW_FORWARD, FFTW_PATIENT);
-		a->maskplan[i] = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->maskgen, (fftw_complex *)a->fmask[i], FFTW_FORWARD, FFTW_PATIENT);
+		a->pcfor[i] = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->fftin, (fftw_complex *)a->fftout[i], FFTW_FORWARD, FFTW_PLANNER);
+		a->maskplan[i] = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->maskgen, (fftw_complex *)a->fmask[i], FFTW_FORWARD, FFTW_PLANNER);
 	}
 	a->accum = (double *) malloc0 (2 * a->size * sizeof (complex));
-	a->crev = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->accum, (fftw_complex *)a->out, FFTW_BACKWARD, FFTW_PATIENT);
+	a->crev = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->accum, (fftw_complex *)a->out, FFTW_BACKWARD, FFTW_PLANNER);
 }
 
 void calc_firopt (FIROPT a)
@@ -287,6 +287,58 @@ void setFreqs_firopt (FIROPT a, double f_low, double f_high)
 ********************************************************************************************************/
 
 
+/*
+ * All FIRCORE instances share their FFT plans. There is one plan per shape
+ * (size, direction, alignment of input and output array), it is created on
+ * first use and then re-used with fftw_execute_dft() on the instance's arrays.
+ * Plans are never destroyed, since the number of different shapes is small
+ * and re-planning (FFTW_PATIENT) is expensive.
+ */
+
+typedef struct _fircore_plan
+{
+	int n;					// FFT size (complex samples)
+	int sign;				// FFTW_FORWARD or FFTW_BACKWARD
+	int ialign;				// alignment of the input array
+	int oalign;				// alignment of the output array
+	fftw_plan plan;
+	struct _fircore_plan* next;
+} fircore_plan;
+
+static fircore_plan* fircore_plans = NULL;
+static volatile long fircore_plans_lock = 0;
+
+static fftw_plan get_fircore_plan (int n, int sign, double* in, double* out)
+{
+	// in and out must be different arrays
+	fircore_plan* p;
+	int ialign = fftw_alignment_of (in);
+	int oalign = fftw_alignment_of (out);
+	while (InterlockedExchange (&fircore_plans_lock, 1))
+		Sleep (1);
+	for (p = fircore_plans; p; p = p->next)
+		if (p->n == n && p->sign == sign && p->ialign == ialign && p->oalign == oalign)
+			break;
+	if (!p)
+	{
+		// plan on scratch arrays with the same alignment as the instance's arrays
+		char* tin  = (char *) fftw_malloc (n * sizeof (complex) + 64);
+		char* tout = (char *) fftw_malloc (n * sizeof (complex) + 64);
+		p = (fircore_plan *) malloc0 (sizeof (fircore_plan));
+		p->n = n;
+		p->sign = sign;
+		p->ialign = ialign;
+		p->oalign = oalign;
+		p->plan = fftw_plan_dft_1d (n, (fftw_complex *)(tin + ialign), (fftw_complex *)(tout + oalign), sign, FFTW_PLANNER);
+		p->next = fircore_plans;
+		fircore_plans = p;
+		fftw_free (tout);
+		fftw_free (tin);
+	}
+	InterlockedAnd (&fircore_plans_lock, 0);
+	return p->plan;
+}
+
 void plan_fircore (FIRCORE a)
 {
 	// must call for change in 'nc', 'size', 'out'
@@ -301,24 +353,53 @@ void plan_fircore (FIRCORE a)
 	a->fmask[0] = (double **) malloc0 (a->nfor * sizeof (double *));
 	a->fmask[1] = (double **) malloc0 (a->nfor * sizeof (double *));
 	a->maskgen = (double *) malloc0 (2 * a->size * sizeof (complex));
-	a->pcfor = (fftw_plan *) malloc0 (a->nfor * sizeof (fftw_plan));
-	a->maskplan    = (fftw_plan **) malloc0 (2 * sizeof (fftw_plan *));
-	a->maskplan[0] = (fftw_plan *) malloc0 (a->nfor * sizeof (fftw_plan));
-	a->maskplan[1] = (fftw_plan *) malloc0 (a->nfor * sizeof (fftw_plan));
 	for (i = 0; i < a->nfor; i++)
 	{
 		a->fftout[i]   = (double *) malloc0 (2 * a->size * sizeof (complex));
 		a->fmask[0][i] = (double *) malloc0 (2 * a->size * sizeof (complex));
 		a->fmask[1][i] = (double *) malloc0 (2 * a->size * sizeof (complex));
-		a->pcfor[i] = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->fftin, (fftw_complex *)a->fftout[i], FFTW_FORWARD, FFTW_PATIENT);
-		a->maskplan[0][i] = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->maskgen, (fftw_complex *)a->fmask[0][i], FFTW_FORWARD, FFTW_PATIENT);
-		a->maskplan[1][i] = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->maskgen, (fftw_complex *)a->fmask[1][i], FFTW_FORWARD, FFTW_PATIENT);
 	}
 	a->accum = (double *) malloc0 (2 * a->size * sizeof (complex));
-	a->crev = fftw_plan_dft_1d(2 * a->size, (fftw_complex *)a->accum, (fftw_complex *)a->out, FFTW_BACKWARD, FFTW_PATIENT);
+	// malloc0() returns arrays of equal alignment, so one plan fits all partitions
+	a->pcfor = get_fircore_plan (2 * a->size, FFTW_FORWARD, a->fftin, a->fftout[0]);
+	a->maskplan = get_fircore_plan (2 * a->size, FFTW_FORWARD, a->maskgen, a->fmask[0][0]);
+	a->crev = get_fircore_plan (2 * a->size, FFTW_BACKWARD, a->accum, a->out);
 	a->masks_ready = 0;
 }
 
+/*
+ * Complex multiply-accumulate accum += x * m over n complex samples.
+ * The arrays do not overlap, so the compiler can vectorize this loop.
+ * On x86_64 Linux, a Haswell clone (AVX2 + FMA) is selected at run time
+ * if the CPU supports it (SSE2 otherwise), on aarch64 NEON is always used.
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+__attribute__((target_clones("arch=haswell", "default")))
+#endif
+static void cmac_fircore (double* restrict accum, const double* restrict x, const double* restrict m, int n)
+{
+	int i;
+	for (i = 0; i < n; i++)
+	{
+		accum[2 * i + 0] += x[2 * i + 0] * m[2 * i + 0] - x[2 * i + 1] * m[2 * i + 1];
+		accum[2 * i + 1] += x[2 * i + 0] * m[2 * i + 1] + x[2 * i + 1] * m[2 * i + 0];
+	}
+}
+
+static void wait_fircore_masks (FIRCORE a)
+{
+	// wait until xfircore() no longer reads the mask set that is about to be re-calculated
+	for (;;)
+	{
+		int busy;
+		EnterCriticalSection (&a->update);
+		busy = (a->reading == 2 - a->cset);
+		LeaveCriticalSection (&a->update);
+		if (!busy) break;
+		Sleep (1);
+	}
+}
+
 void calc_fircore (FIRCORE a, int flip)
 {
 	// call for change in frequency, rate, wintype, gain
@@ -328,12 +409,13 @@ void calc_fircore (FIRCORE a, int flip)
 		mp_imp (a->nc, a->impulse, a->imp, 16, 0);
 	else
 		memcpy (a->imp, a->impulse, a->nc * sizeof (complex));
+	wait_fircore_masks (a);
 	for (i = 0; i < a->nfor; i++)
 	{
 		// I right-justified the impulse response => take output from left side of output buff, discard right side
 		// Be careful about flipping an asymmetrical impulse response.
 		memcpy (&(a->maskgen[2 * a->size]), &(a->imp[2 * a->size * i]), a->size * sizeof(complex));
-		fftw_execute (a->maskplan[1 - a->cset][i]);
+		fftw_execute_dft (a->maskplan, (fftw_complex *)a->maskgen, (fftw_complex *)a->fmask[1 - a->cset][i]);
 	}
 	a->masks_ready = 1;
 	if (flip)
@@ -364,22 +446,15 @@ FIRCORE create_fircore (int size, double* in, double* out, int nc, int mp, doubl
 
 void deplan_fircore (FIRCORE a)
 {
+	// the (shared) plans are not destroyed
 	int i;
-	fftw_destroy_plan (a->crev);
 	_aligned_free (a->accum);
 	for (i = 0; i < a->nfor; i++)
 	{
 		_aligned_free (a->fftout[i]);
 		_aligned_free (a->fmask[0][i]);
 		_aligned_free (a->fmask[1][i]);
-		fftw_destroy_plan (a->pcfor[i]);
-		fftw_destroy_plan (a->maskplan[0][i]);
-		fftw_destroy_plan (a->maskplan[1][i]);
 	}
-	_aligned_free (a->maskplan[0]);
-	_aligned_free (a->maskplan[1]);
-	_aligned_free (a->maskplan);
-	_aligned_free (a->pcfor);
 	_aligned_free (a->maskgen);
 	_aligned_free (a->fmask[0]);
 	_aligned_free (a->fmask[1]);
@@ -409,31 +484,32 @@ void flush_fircore (FIRCORE a)
 void xfircore (FIRCORE a)
 {
 	//[2.10.3.9]MW0LGE refactor to remove pointer chase in the loops
-	int i, j, k;
+	int j, k;
+	int cset;
 	memcpy (&(a->fftin[2 * a->size]), a->in, a->size * sizeof (complex));
-	fftw_execute (a->pcfor[a->buffidx]);
+	fftw_execute_dft (a->pcfor, (fftw_complex *)a->fftin, (fftw_complex *)a->fftout[a->buffidx]);
 	k = a->buffidx;
 	memset (a->accum, 0, 2 * a->size * sizeof (complex));
+	// the lock is only held to pick the mask set, calc_fircore() does not
+	// overwrite the set while a->reading indicates it is in use
 	EnterCriticalSection (&a->update);
+	cset = a->cset;
+	a->reading = cset + 1;
+	LeaveCriticalSection (&a->update);
 	double* accum = a->accum;
 	double** fftout = a->fftout;
-	double*** fmask = a->fmask;
-	int cset = a->cset;
+	double** fmask = a->fmask[cset];
 	int idxmask = a->idxmask;
 	int sz = a->size;
 	int nfor = a->nfor;
 	for (j = 0; j < nfor; j++)
 	{
-		for (i = 0; i < 2 * sz; i++)
-		{
-			accum[2 * i + 0] += fftout[k][2 * i + 0] * fmask[cset][j][2 * i + 0] - fftout[k][2 * i + 1] * fmask[cset][j][2 * i + 1];
-			accum[2 * i + 1] += fftout[k][2 * i + 0] * fmask[cset][j][2 * i + 1] + fftout[k][2 * i + 1] * fmask[cset][j][2 * i + 0];
-		}
+		cmac_fircore (accum, fftout[k], fmask[j], 2 * sz);
 		k = (k + idxmask) & idxmask;
 	}
-	LeaveCriticalSection (&a->update);
+	InterlockedAnd (&a->reading, 0);
 	a->buffidx = (a->buffidx + 1) & idxmask;
-	fftw_execute (a->crev);
+	fftw_execute_dft (a->crev, (fftw_complex *)a->accum, (fftw_complex *)a->out);
 	memcpy (a->fftin, &(a->fftin[2 * a->size]), a->size * sizeof(complex));
 }
 
@@ -441,9 +517,8 @@ void setBuffers_fircore (FIRCORE a, double* in, double* out)
 {
 	a->in = in;
 	a->out = out;
-	deplan_fircore (a);
-	plan_fircore (a);
-	calc_fircore (a, 1);
+	// only the reverse plan depends on 'out', and only through its alignment
+	a->crev = get_fircore_plan (2 * a->size, FFTW_BACKWARD, a->accum, a->out);
 }
 
 void setSize_fircore (FIRCORE a, int size)
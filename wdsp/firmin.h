@@ -151,13 +151,14 @@ typedef struct _fircore
 	int buffidx;			// fft out buffer index
 	int idxmask;			// mask for index computations
 	double* maskgen;		// input for mask generation FFT
-	fftw_plan* pcfor;		// array of forward FFT plans
-	fftw_plan crev;			// reverse fft plan
-	fftw_plan** maskplan;	// plans for frequency domain masks
+	fftw_plan pcfor;		// forward FFT plan (shared)
+	fftw_plan crev;			// reverse fft plan (shared)
+	fftw_plan maskplan;		// plan for frequency domain masks (shared)
 	CRITICAL_SECTION update;
 	int cset;
 	int mp;
 	int masks_ready;
+	volatile long reading;	// mask set in use by xfircore() plus one, zero if none
 } fircore, *FIRCORE;
 
 extern FIRCORE create_fircore (int size, double* in, double* out, 
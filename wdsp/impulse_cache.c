@@ -83,11 +83,27 @@ typedef struct _cache_entry {
 	struct _cache_entry* next;
 } cache_entry;
 
+//
+// On-disk format (all values in host byte order):
+//   header:  magic, format version, WDSP version, sizeof(HASH_T), number of buckets
+//   payload: per bucket: count, then count * (hash, N, N complex values)
+//   trailer: FNV-1a checksum of the payload
+// A file that does not match in any of these respects is ignored.
+//
+#define IMPULSE_CACHE_MAGIC		0x43504d49U		// "IMPC"
+#define IMPULSE_CACHE_VERSION	1
+#define IMPULSE_CACHE_MAX_N		(1 << 20)		// sanity limit for a single impulse
+#define IMPULSE_CACHE_SUM_INIT	2166136261U		// FNV-1a 32-bit offset basis
+
+extern int GetWDSPVersion(void);				// version.c
+
 static size_t _cache_counts[CACHE_BUCKETS] = { 0 };
 static cache_entry* _cache_heads[CACHE_BUCKETS] = { NULL };
-static CRITICAL_SECTION _cs_use_cache;
+static CRITICAL_SECTION _cs_use_cache;			// protects _use_cache, the lists, and the statistics
 static int _run = 0;
 static int _use_cache = 1;
+static long _cache_hits = 0;
+static long _cache_misses = 0;
 
 void remove_impulse_cache_tail(size_t bucket)
 {
@@ -128,119 +144,136 @@ double* get_impulse_cache_entry(size_t bucket, HASH_T hash, int N)
 {
 	if (!_run) return NULL;
 
-	int use;
+	double* imp = NULL;
 	EnterCriticalSection(&_cs_use_cache);
-	use = _use_cache;
-	LeaveCriticalSection(&_cs_use_cache);
 
-	if (!use || bucket >= CACHE_BUCKETS) return NULL;
-
-	// lru, least recently used, moves cache hit to head
-	// old cache entries will move towards the tail and eventually be dumped
-	cache_entry* prev = NULL;
-	cache_entry* e = _cache_heads[bucket];
-	
-	while (e) {
-        if (e->hash == hash && e->N == N)
-        {
-			if (prev)
+	if (_use_cache && bucket < CACHE_BUCKETS)
+	{
+		// lru, least recently used, moves cache hit to head
+		// old cache entries will move towards the tail and eventually be dumped
+		cache_entry* prev = NULL;
+		cache_entry* e = _cache_heads[bucket];
+
+		while (e) {
+			if (e->hash == hash && e->N == N)
 			{
-				prev->next = e->next;
-				e->next = _cache_heads[bucket];
-				_cache_heads[bucket] = e;
+				if (prev)
+				{
+					prev->next = e->next;
+					e->next = _cache_heads[bucket];
+					_cache_heads[bucket] = e;
+				}
+				imp = (double*) malloc0(e->N * sizeof(complex));
+				memcpy(imp, e->impulse, e->N * sizeof(complex));
+				break;
 			}
-			double* imp = (double*) malloc0(e->N * sizeof(complex));
-			memcpy(imp, e->impulse, e->N * sizeof(complex));
-			return imp;
+			prev = e;
+			e = e->next;
 		}
-		prev = e;
-		e = e->next;
+
+		if (imp) _cache_hits++;
+		else     _cache_misses++;
 	}
 
-	return NULL;
+	LeaveCriticalSection(&_cs_use_cache);
+	return imp;
 }
 
 void add_impulse_to_cache(size_t bucket, HASH_T hash, int N, double* impulse)
 {
 	if (!_run) return;
 
-	int use;
 	EnterCriticalSection(&_cs_use_cache);
-	use = _use_cache;
-	LeaveCriticalSection(&_cs_use_cache);
 
-	if (!use || bucket >= CACHE_BUCKETS) return;
+	if (_use_cache && bucket < CACHE_BUCKETS)
+	{
+		if (_cache_counts[bucket] >= MAX_CACHE_ENTRIES) remove_impulse_cache_tail(bucket);
+
+		cache_entry* e = malloc0(sizeof(cache_entry));
+		e->hash = hash;
+		e->N = N;
+		e->impulse = (double *) malloc0(N * sizeof(complex));
+		memcpy(e->impulse, impulse, N * sizeof(complex));
+		e->next = _cache_heads[bucket];
+		_cache_heads[bucket] = e;
+		_cache_counts[bucket]++;
+	}
 
-	if (_cache_counts[bucket] >= MAX_CACHE_ENTRIES) remove_impulse_cache_tail(bucket);
+	LeaveCriticalSection(&_cs_use_cache);
+}
 
-	cache_entry* e = malloc0(sizeof(cache_entry));
-	e->hash = hash;
-	e->N = N;
-	e->impulse = (double *) malloc0(N * sizeof(complex));
-	memcpy(e->impulse, impulse, N * sizeof(complex));
-	e->next = _cache_heads[bucket];
-	_cache_heads[bucket] = e;
-	_cache_counts[bucket]++;
+// fwrite/fread that also update a running FNV-1a checksum
+static void cache_sum(const void* data, size_t len, uint32_t* sum)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < len; i++) {
+		*sum ^= bytes[i];
+		*sum *= 16777619U;				// FNV-1a 32-bit prime
+	}
 }
 
-PORT
-int save_impulse_cache(const char* path)
+static int cache_write(FILE* fp, const void* data, size_t size, size_t n, uint32_t* sum)
 {
-	if (!_run) return 0;
+	cache_sum(data, size * n, sum);
+	return fwrite(data, size, n, fp) == n ? 0 : -1;
+}
 
-	int use;
-	EnterCriticalSection(&_cs_use_cache);
-	use = _use_cache;
-	LeaveCriticalSection(&_cs_use_cache);
-	if (!use) return 0;
+static int cache_read(FILE* fp, void* data, size_t size, size_t n, uint32_t* sum)
+{
+	if (fread(data, size, n, fp) != n) return -1;
+	cache_sum(data, size * n, sum);
+	return 0;
+}
 
-	FILE* fp = fopen(path, "wb");
-	if (!fp) return -1;
-	uint32_t buckets = CACHE_BUCKETS;
-	if (fwrite(&buckets, sizeof(buckets), 1, fp) != 1) { fclose(fp); return -1; }
+static void cache_header(uint32_t* header)
+{
+	header[0] = IMPULSE_CACHE_MAGIC;
+	header[1] = IMPULSE_CACHE_VERSION;
+	header[2] = (uint32_t)GetWDSPVersion();
+	header[3] = (uint32_t)sizeof(HASH_T);
+	header[4] = CACHE_BUCKETS;
+}
+
+static int write_impulse_cache(FILE* fp)
+{
+	uint32_t header[5];
+	uint32_t sum = IMPULSE_CACHE_SUM_INIT;
+	cache_header(header);
+	if (fwrite(header, sizeof(header), 1, fp) != 1) return -1;
 	for (size_t b = 0; b < CACHE_BUCKETS; b++) {
 		uint32_t count = 0;
 		for (cache_entry* e = _cache_heads[b]; e; e = e->next) count++;
-		if (fwrite(&count, sizeof(count), 1, fp) != 1) { fclose(fp); return -1; }
+		if (cache_write(fp, &count, sizeof(count), 1, &sum)) return -1;
 		for (cache_entry* e = _cache_heads[b]; e; e = e->next) {
-			if (fwrite(&e->hash, sizeof(HASH_T), 1, fp) != 1) { fclose(fp); return -1; }
-			if (fwrite(&e->N, sizeof(e->N), 1, fp) != 1) { fclose(fp); return -1; }
-			if (fwrite(e->impulse, sizeof(complex), e->N, fp) != (size_t)e->N) { fclose(fp); return -1; }
+			if (cache_write(fp, &e->hash, sizeof(HASH_T), 1, &sum)) return -1;
+			if (cache_write(fp, &e->N, sizeof(e->N), 1, &sum)) return -1;
+			if (cache_write(fp, e->impulse, sizeof(complex), e->N, &sum)) return -1;
 		}
 	}
-	fclose(fp);
+	if (fwrite(&sum, sizeof(sum), 1, fp) != 1) return -1;
 	return 0;
 }
 
-PORT
-int read_impulse_cache(const char* path)
+static int parse_impulse_cache(FILE* fp)
 {
-	if (!_run) return 0;
-
-	free_impulse_cache();
-
-	int use;
-	EnterCriticalSection(&_cs_use_cache);
-	use = _use_cache;
-	LeaveCriticalSection(&_cs_use_cache);
-	if (!use) return 0;
-
-	FILE* fp = fopen(path, "rb");
-	if (!fp) return -1;
-	uint32_t buckets;
-	if (fread(&buckets, sizeof(buckets), 1, fp) != 1) { fclose(fp); return -1; }
-	if (buckets != CACHE_BUCKETS) { fclose(fp); return -1; }
-	for (size_t b = 0; b < buckets; b++) {
+	uint32_t header[5], expected[5];
+	uint32_t sum = IMPULSE_CACHE_SUM_INIT, stored;
+	cache_header(expected);
+	if (fread(header, sizeof(header), 1, fp) != 1) return -1;
+	if (memcmp(header, expected, sizeof(header))) return -1;
+	for (size_t b = 0; b < CACHE_BUCKETS; b++) {
 		uint32_t count;
-		if (fread(&count, sizeof(count), 1, fp) != 1) { fclose(fp); return -1; }
+		if (cache_read(fp, &count, sizeof(count), 1, &sum)) return -1;
+		if (count > MAX_CACHE_ENTRIES) return -1;
 		cache_entry* tail = NULL;
 		for (uint32_t i = 0; i < count; i++) {
 			HASH_T hash;
 			int    N;
-			if (fread(&hash, sizeof(HASH_T), 1, fp) != 1) { fclose(fp); return -1; }
-			if (fread(&N, sizeof(N), 1, fp) != 1) { fclose(fp); return -1; }
+			if (cache_read(fp, &hash, sizeof(HASH_T), 1, &sum)) return -1;
+			if (cache_read(fp, &N, sizeof(N), 1, &sum)) return -1;
+			if (N <= 0 || N > IMPULSE_CACHE_MAX_N) return -1;
 			double* data = (double*)malloc0(N * sizeof(complex));
-			if (fread(data, sizeof(complex), N, fp) != (size_t)N) { _aligned_free(data); fclose(fp); return -1; }
+			if (cache_read(fp, data, sizeof(complex), N, &sum)) { _aligned_free(data); return -1; }
 			cache_entry* e = (cache_entry*)malloc0(sizeof(cache_entry));
 			e->hash = hash;
 			e->N = N;
@@ -254,8 +287,70 @@ int read_impulse_cache(const char* path)
 			_cache_counts[b]++;
 		}
 	}
-	fclose(fp);
-	return 0;
+	if (fread(&stored, sizeof(stored), 1, fp) != 1) return -1;
+	return stored == sum ? 0 : -1;
+}
+
+PORT
+int save_impulse_cache(const char* path)
+{
+	if (!_run) return 0;
+
+	int rc = 0;
+	EnterCriticalSection(&_cs_use_cache);
+	if (_use_cache)
+	{
+		FILE* fp = fopen(path, "wb");
+		if (fp)
+		{
+			rc = write_impulse_cache(fp);
+			if (fclose(fp)) rc = -1;
+			// do not leave a truncated file behind
+			if (rc) remove(path);
+		}
+		else
+			rc = -1;
+	}
+	LeaveCriticalSection(&_cs_use_cache);
+	return rc;
+}
+
+PORT
+int read_impulse_cache(const char* path)
+{
+	if (!_run) return 0;
+
+	int rc = 0;
+	EnterCriticalSection(&_cs_use_cache);
+	free_impulse_cache();
+	if (_use_cache)
+	{
+		FILE* fp = fopen(path, "rb");
+		if (fp)
+		{
+			rc = parse_impulse_cache(fp);
+			fclose(fp);
+			// a partially read, outdated, or corrupt file leaves an empty cache
+			if (rc) free_impulse_cache();
+		}
+		else
+			rc = -1;
+	}
+	LeaveCriticalSection(&_cs_use_cache);
+	return rc;
+}
+
+PORT
+void get_impulse_cache_stats(int* entries, long* hits, long* misses)
+{
+	int n = 0;
+	if (_run) EnterCriticalSection(&_cs_use_cache);
+	for (size_t b = 0; b < CACHE_BUCKETS; b++)
+		n += (int)_cache_counts[b];
+	*entries = n;
+	*hits = _cache_hits;
+	*misses = _cache_misses;
+	if (_run) LeaveCriticalSection(&_cs_use_cache);
 }
 
 PORT
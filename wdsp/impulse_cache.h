@@ -77,6 +77,7 @@ void add_impulse_to_cache(size_t bucket, HASH_T hash, int N, double* impulse);
 __declspec (dllexport) int save_impulse_cache(const char* path);
 __declspec (dllexport) int read_impulse_cache(const char* path);
 __declspec (dllexport) void use_impulse_cache(int use);
+__declspec (dllexport) void get_impulse_cache_stats(int* entries, long* hits, long* misses);
 
 __declspec (dllexport) void init_impulse_cache(int use);
 __declspec (dllexport) void destroy_impulse_cache(void);
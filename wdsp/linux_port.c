@@ -38,10 +38,92 @@ john.d.melton@googlemail.com
 
 #if defined(linux) || defined(__APPLE__)
 
+//
+// QueueUserWorkItem is served by a fixed-size pool of worker threads.
+// It is used by the spectrum dispatcher (sendbuf) to hand over the
+// FFT for each (stitch, LO) sub-span, and formerly created (and joined)
+// a new thread for every single FFT.
+// The pool is created upon first use, work items are queued in
+// a fixed-size circular buffer. Should the queue ever overflow,
+// the work item is executed synchronously by the caller, which is
+// what the old implementation always did.
+//
+// Note that _beginthread() is NOT routed through the pool: it is used
+// for long-running threads (channel main loops, display dispatchers,
+// PureSignal calculations) that must not occupy a pool worker.
+//
+
+#define WORK_QUEUE_SIZE  1024
+#define MAX_POOL_WORKERS 8
+
+typedef DWORD (*WORK_FUNCTION)(void *);
+
+typedef struct _work_item {
+    WORK_FUNCTION function;
+    void *context;
+} WORK_ITEM;
+
+static WORK_ITEM work_queue[WORK_QUEUE_SIZE];
+static int work_head = 0;                 // next item to be executed
+static int work_count = 0;                // number of items queued
+static pthread_mutex_t work_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t work_once = PTHREAD_ONCE_INIT;
+static int work_workers = 0;
+
+static void *pool_worker(void *arg) {
+    for (;;) {
+        WORK_ITEM item;
+        pthread_mutex_lock(&work_mutex);
+        while (work_count == 0) {
+            pthread_cond_wait(&work_cond, &work_mutex);
+        }
+        item = work_queue[work_head];
+        work_head = (work_head + 1) % WORK_QUEUE_SIZE;
+        work_count--;
+        pthread_mutex_unlock(&work_mutex);
+        (void) item.function(item.context);
+    }
+    return NULL;
+}
+
+static void pool_init() {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 2) ncpu = 2;
+    if (ncpu > MAX_POOL_WORKERS) ncpu = MAX_POOL_WORKERS;
+    for (int i = 0; i < ncpu; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, pool_worker, NULL) != 0) {
+            perror("WDSP:QueueUserWorkItem:pthread_create");
+            break;
+        }
+        pthread_detach(t);
+#ifndef __APPLE__
+        char tname[16];
+        snprintf(tname, sizeof(tname), "WFFT%d", i);
+        (void) pthread_setname_np(t, tname);
+#endif
+        work_workers++;
+    }
+}
+
 void QueueUserWorkItem(void *function,void *context,int flags) {
-    pthread_t t;
-    pthread_create(&t, NULL, function, context);
-    pthread_join(t, NULL);
+    WORK_FUNCTION func = (WORK_FUNCTION) function;
+    pthread_once(&work_once, pool_init);
+    pthread_mutex_lock(&work_mutex);
+    if (work_workers == 0 || work_count >= WORK_QUEUE_SIZE) {
+        //
+        // No pool, or queue full: run it here
+        //
+        pthread_mutex_unlock(&work_mutex);
+        (void) func(context);
+        return;
+    }
+    work_queue[(work_head + work_count) % WORK_QUEUE_SIZE].function = func;
+    work_queue[(work_head + work_count) % WORK_QUEUE_SIZE].context = context;
+    work_count++;
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&work_mutex);
 }
 
 void InitializeCriticalSectionAndSpinCount(pthread_mutex_t *mutex,int count) {
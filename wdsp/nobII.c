@@ -60,6 +60,19 @@ void init_nob (NOB a)
     flush_nob (a);
 }
 
+void calc_nob (NOB a)
+{
+	// per-buffer magnitudes and impulse flags for the first pass of xnob()
+	a->mag = (double *)malloc0 (a->buffsize * sizeof (double));
+	a->flag = (int *)malloc0 (a->buffsize * sizeof (int));
+}
+
+void decalc_nob (NOB a)
+{
+	_aligned_free (a->flag);
+	_aligned_free (a->mag);
+}
+
 PORT
 NOB create_nob (
 	int run,
@@ -119,6 +132,7 @@ NOB create_nob (
 	InitializeCriticalSectionAndSpinCount (&a->cs_update, 2500);
 	init_nob (a);
 
+	calc_nob (a);
 	a->legacy = (double *) malloc0 (2048 * sizeof (complex));														/////////////// legacy interface - remove
 	return a;
 }
@@ -127,6 +141,7 @@ PORT
 void destroy_nob (NOB a)
 {
 	_aligned_free (a->legacy);																					   ///////////////  remove
+	decalc_nob (a);
 	_aligned_free (a->fcoefs);
 	_aligned_free (a->ffbuff);
 	_aligned_free (a->bfbuff);
@@ -158,7 +173,7 @@ PORT
 void xnob (NOB a)
 {
 	double scale;
-    double mag;
+    double avg;
     int bf_idx;
     int ff_idx;
     int lidx, tidx;
@@ -172,16 +187,22 @@ void xnob (NOB a)
 	EnterCriticalSection (&a->cs_update);
     if (a->run)
 	{
+		// pass 1:  magnitudes (no loop-carried dependency), then average and impulse flags
+		for (i = 0; i < a->buffsize; i++)
+			a->mag[i] = sqrt (a->in[2 * i + 0] * a->in[2 * i + 0] + a->in[2 * i + 1] * a->in[2 * i + 1]);
+		avg = a->avg;
+		for (i = 0; i < a->buffsize; i++)
+		{
+			avg = a->backmult * avg + a->ombackmult * a->mag[i];
+			a->flag[i] = a->mag[i] > avg * a->threshold;
+		}
+		a->avg = avg;
+		// pass 2:  delayed copy, the state machine is only entered around impulses
 		for (i = 0; i < a->buffsize; i++)
 		{
 			a->dline[2 * a->in_idx + 0] = a->in[2 * i + 0];
 			a->dline[2 * a->in_idx + 1] = a->in[2 * i + 1];
-			mag = sqrt(a->dline[2 * a->in_idx + 0] * a->dline[2 * a->in_idx + 0] + a->dline[2 * a->in_idx + 1] * a->dline[2 * a->in_idx + 1]);
-			a->avg = a->backmult * a->avg + a->ombackmult * mag;
-			if (mag > (a->avg * a->threshold))
-				a->imp[a->in_idx] = 1;
-			else
-				a->imp[a->in_idx] = 0;
+			a->imp[a->in_idx] = a->flag[i];
 			if ((bf_idx = a->out_idx + a->adv_slew_count) >= a->dline_size) bf_idx -= a->dline_size;
 			if (a->imp[bf_idx] == 0)
 			{
@@ -190,6 +211,12 @@ void xnob (NOB a)
 				a->bfbuff[2 * a->bfb_in_idx + 1] = a->dline[2 * bf_idx + 1];
 			}
 
+			if (a->state == 0 && a->imp[a->scan_idx] == 0)
+			{
+				a->out[2 * i + 0] = a->Ilast = a->dline[2 * a->out_idx + 0];
+				a->out[2 * i + 1] = a->Qlast = a->dline[2 * a->out_idx + 1];
+			}
+			else    // impulse in sight or blanking in progress
 			switch (a->state)
 			{
 				case 0:     // normal output & impulse setup
@@ -507,7 +534,9 @@ void setSamplerate_nob (NOB a, int rate)
 
 void setSize_nob (NOB a, int size)
 {
+	decalc_nob (a);
 	a->buffsize = size;
+	calc_nob (a);
 	flush_nob (a);
 }
 
@@ -537,7 +566,9 @@ PORT
 void pSetRCVRNOBBuffsize (NOB a, int size)
 {
 	EnterCriticalSection (&a->cs_update);
+	decalc_nob (a);
 	a->buffsize = size;
+	calc_nob (a);
 	LeaveCriticalSection (&a->cs_update);
 }
 
@@ -668,7 +699,9 @@ void SetEXTNOBBuffsize (int id, int size)
 {
 	NOB a = pnob[id];
 	EnterCriticalSection (&a->cs_update);
+	decalc_nob (a);
 	a->buffsize = size;
+	calc_nob (a);
 	LeaveCriticalSection (&a->cs_update);
 }
 
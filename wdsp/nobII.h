@@ -74,6 +74,8 @@ typedef struct _nob
 	double deltaI, deltaQ;
 	double Inext, Qnext;
 	int overflow;
+	double *mag;					// input magnitudes of the current buffer
+	int *flag;						// impulse flags of the current buffer
 	CRITICAL_SECTION cs_update;
 	double *legacy;																										////////////  legacy interface - remove
 } nob, *NOB;
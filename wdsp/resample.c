@@ -64,14 +64,15 @@ void calc_resample (RESAMPLE a)
 	if (a->ncoef == 0) a->ncoef = (int)(140.0 * full_rate / min_rate);
 	a->ncoef = (a->ncoef / a->L + 1) * a->L;
 	a->cpp = a->ncoef / a->L;
-	a->h = (double *)malloc0(a->ncoef * sizeof(double));
+	a->h = (WDSP_REAL *)malloc0(a->ncoef * sizeof(WDSP_REAL));
 	impulse = fir_bandpass(a->ncoef, fc_norm_low, fc_norm_high, 1.0, 1, 0, a->gain * (double)a->L);
 	i = 0;
 	for (j = 0; j < a->L; j++)
 		for (k = 0; k < a->ncoef; k += a->L)
-			a->h[i++] = impulse[j + k];
+			a->h[i++] = (WDSP_REAL)impulse[j + k];
 	a->ringsize = a->cpp;
-	a->ring = (double *)malloc0(a->ringsize * sizeof(complex));
+	// the ring is mirrored: every sample is stored at idx and idx + ringsize
+	a->ring = (WDSP_REAL *)malloc0(2 * a->ringsize * 2 * sizeof(WDSP_REAL));
 	a->idx_in = a->ringsize - 1;
 	a->phnum = 0;
 	_aligned_free(impulse);
@@ -112,57 +113,117 @@ void destroy_resample (RESAMPLE a)
 PORT
 void flush_resample (RESAMPLE a)
 {
-	memset (a->ring, 0, a->ringsize * sizeof (complex));
+	memset (a->ring, 0, 2 * a->ringsize * 2 * sizeof (WDSP_REAL));
 	a->idx_in = a->ringsize - 1;
 	a->phnum = 0;
 }
 
-PORT
-int xresample (RESAMPLE a)
+/*
+ * Dot products of the polyphase filter. Since the ring is mirrored, the
+ * n samples starting at x are contiguous. Two partial sums per output are
+ * used, such that the loops vectorize (also without -ffast-math).
+ */
+static inline void dot_resample (const WDSP_REAL* restrict h, const WDSP_REAL* restrict x, int n, double* I, double* Q)
 {
-	int outsamps = 0;
-	if (a->run)
+	int j;
+	WDSP_REAL acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+	for (j = 0; j < n - 1; j += 2)
+	{
+		acc[0] += h[j + 0] * x[2 * j + 0];
+		acc[1] += h[j + 0] * x[2 * j + 1];
+		acc[2] += h[j + 1] * x[2 * j + 2];
+		acc[3] += h[j + 1] * x[2 * j + 3];
+	}
+	if (j < n)
 	{
-		int i, j, n;
-		int idx_out;
-		double I, Q;
+		acc[0] += h[j] * x[2 * j + 0];
+		acc[1] += h[j] * x[2 * j + 1];
+	}
+	*I = acc[0] + acc[2];
+	*Q = acc[1] + acc[3];
+}
 
-		int cpp = a->cpp;
-		int idx_in = a->idx_in;
-		int ringsize = a->ringsize;
-		double* h = a->h;
-		double* ring = a->ring;
+static inline double dot_resampleF (const WDSP_REAL* restrict h, const WDSP_REAL* restrict x, int n)
+{
+	int j;
+	WDSP_REAL acc[2] = { 0.0, 0.0 };
+	for (j = 0; j < n - 1; j += 2)
+	{
+		acc[0] += h[j + 0] * x[j + 0];
+		acc[1] += h[j + 1] * x[j + 1];
+	}
+	if (j < n)
+		acc[0] += h[j] * x[j];
+	return acc[0] + acc[1];
+}
 
-		for (i = 0; i < a->size; i++)
+/*
+ * Push one buffer of input samples through the ring. If rotate is set, every
+ * input sample is multiplied with the NCO (cos_phase, sin_phase), which is
+ * advanced by (cos_delta, sin_delta) per sample, as it enters the ring.
+ * Since this is inlined with a constant rotate, xresample() carries no mixer.
+ */
+static inline int run_resample (RESAMPLE a, int rotate,
+	double cos_phase, double sin_phase, double cos_delta, double sin_delta)
+{
+	int outsamps = 0;
+	int i;
+	double I, Q, t;
+
+	int cpp = a->cpp;
+	int idx_in = a->idx_in;
+	int ringsize = a->ringsize;
+	WDSP_REAL* h = a->h;
+	WDSP_REAL* ring = a->ring;
+
+	for (i = 0; i < a->size; i++)
+	{
+		I = a->in[2 * i + 0];
+		Q = a->in[2 * i + 1];
+		if (rotate)
 		{
-			ring[2 * idx_in + 0] = a->in[2 * i + 0];
-			ring[2 * idx_in + 1] = a->in[2 * i + 1];
-			while (a->phnum < a->L)
-			{
-				I = 0.0;
-				Q = 0.0;
-				n = cpp * a->phnum;
-				for (j = 0; j < cpp; j++)
-				{
-					if ((idx_out = idx_in + j) >= ringsize) idx_out -= ringsize;
-					I += h[n + j] * ring[2 * idx_out + 0];
-					Q += h[n + j] * ring[2 * idx_out + 1];
-				}
-				a->out[2 * outsamps + 0] = I;
-				a->out[2 * outsamps + 1] = Q;
-				outsamps++;
-				a->phnum += a->M;
-			}
-			a->phnum -= a->L;
-			if (--idx_in < 0) idx_in = a->ringsize - 1;
+			t = I;
+			I = t * cos_phase - Q * sin_phase;
+			Q = t * sin_phase + Q * cos_phase;
+			t = cos_phase;
+			cos_phase = t * cos_delta - sin_phase * sin_delta;
+			sin_phase = t * sin_delta + sin_phase * cos_delta;
 		}
-		a->idx_in = idx_in;
+		ring[2 * idx_in + 0] = ring[2 * (idx_in + ringsize) + 0] = (WDSP_REAL)I;
+		ring[2 * idx_in + 1] = ring[2 * (idx_in + ringsize) + 1] = (WDSP_REAL)Q;
+		while (a->phnum < a->L)
+		{
+			dot_resample (&h[cpp * a->phnum], &ring[2 * idx_in], cpp, &I, &Q);
+			a->out[2 * outsamps + 0] = I;
+			a->out[2 * outsamps + 1] = Q;
+			outsamps++;
+			a->phnum += a->M;
+		}
+		a->phnum -= a->L;
+		if (--idx_in < 0) idx_in = a->ringsize - 1;
 	}
+	a->idx_in = idx_in;
+	return outsamps;
+}
+
+PORT
+int xresample (RESAMPLE a)
+{
+	int outsamps = 0;
+	if (a->run)
+		outsamps = run_resample (a, 0, 1.0, 0.0, 1.0, 0.0);
 	else if (a->in != a->out)
 		memcpy (a->out, a->in, a->size * sizeof (complex));
 	return outsamps;
 }
 
+// xresample() with a frequency shift applied to the input on the fly, such
+// that the (high-rate) input buffer is read once and never written back.
+int xresample_rotate (RESAMPLE a, double cos_phase, double sin_phase, double cos_delta, double sin_delta)
+{
+	return run_resample (a, 1, cos_phase, sin_phase, cos_delta, sin_delta);
+}
+
 void setBuffers_resample(RESAMPLE a, double* in, double* out)
 {
 	a->in = in;
@@ -272,14 +333,15 @@ RESAMPLEF create_resampleF ( int run, int size, float* in, float* out, int in_ra
 	a->ncoef = (int)(60.0 / fc_norm);
 	a->ncoef = (a->ncoef / a->L + 1) * a->L;
 	a->cpp = a->ncoef / a->L;
-	a->h = (double *) malloc0 (a->ncoef * sizeof (double));
+	a->h = (WDSP_REAL *) malloc0 (a->ncoef * sizeof (WDSP_REAL));
 	impulse = fir_bandpass (a->ncoef, -fc_norm, +fc_norm, 1.0, 1, 0, (double)a->L);
 	i = 0;
 	for (j = 0; j < a->L; j ++)
 		for (k = 0; k < a->ncoef; k += a->L)
-			a->h[i++] = impulse[j + k];
+			a->h[i++] = (WDSP_REAL)impulse[j + k];
 	a->ringsize = a->cpp;
-	a->ring = (double *) malloc0 (a->ringsize * sizeof (double));
+	// the ring is mirrored: every sample is stored at idx and idx + ringsize
+	a->ring = (WDSP_REAL *) malloc0 (2 * a->ringsize * sizeof (WDSP_REAL));
 	a->idx_in = a->ringsize - 1;
 	a->phnum = 0;
 	_aligned_free (impulse);
@@ -295,7 +357,7 @@ void destroy_resampleF (RESAMPLEF a)
 
 void flush_resampleF (RESAMPLEF a)
 {
-	memset (a->ring, 0, a->ringsize * sizeof (double));
+	memset (a->ring, 0, 2 * a->ringsize * sizeof (WDSP_REAL));
 	a->idx_in = a->ringsize - 1;
 	a->phnum = 0;
 }
@@ -305,24 +367,15 @@ int xresampleF (RESAMPLEF a)
 	int outsamps = 0;
 	if (a->run)
 	{
-		int i, j, n;
-		int idx_out;
-		double I;
+		int i;
 
 		for (i = 0; i < a->size; i++)
 		{
-			a->ring[a->idx_in] = (double)a->in[i];
+			a->ring[a->idx_in] = a->ring[a->idx_in + a->ringsize] = (WDSP_REAL)a->in[i];
 
 			while (a->phnum < a->L)
 			{
-				I = 0.0;
-				n = a->cpp * a->phnum;
-				for (j = 0; j < a->cpp; j++)
-				{
-					if ((idx_out = a->idx_in + j) >= a->ringsize) idx_out -= a->ringsize;
-					I += a->h[n + j] * a->ring[idx_out];
-				}
-				a->out[outsamps] = (float)I;
+				a->out[outsamps] = (float)dot_resampleF (&a->h[a->cpp * a->phnum], &a->ring[a->idx_in], a->cpp);
 
 				outsamps++;
 				a->phnum += a->M;
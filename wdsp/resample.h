@@ -50,9 +50,9 @@ typedef struct _resample
 	int ncoef;			// number of coefficients
 	int L;				// interpolation factor
 	int M;				// decimation factor
-	double* h;			// coefficients
-	int ringsize;		// number of complex pairs the ring buffer holds
-	double* ring;		// ring buffer
+	WDSP_REAL* h;		// coefficients
+	int ringsize;		// number of complex pairs the ring buffer holds (allocated twice, mirrored)
+	WDSP_REAL* ring;	// ring buffer
 	int cpp;			// coefficients of the phase
 	int phnum;			// phase number
 } resample, *RESAMPLE;
@@ -69,6 +69,8 @@ void flush_resample (RESAMPLE a);
 __declspec (dllexport)
 int xresample (RESAMPLE a);
 
+extern int xresample_rotate (RESAMPLE a, double cos_phase, double sin_phase, double cos_delta, double sin_delta);
+
 extern void setBuffers_resample (RESAMPLE a, double* in, double* out);
 
 extern void setSize_resample(RESAMPLE a, int size);
@@ -102,9 +104,9 @@ typedef struct _resampleF
 	int ncoef;			// number of coefficients
 	int L;				// interpolation factor
 	int M;				// decimation factor
-	double* h;			// coefficients
-	int ringsize;		// number of values the ring buffer holds
-	double* ring;		// ring buffer
+	WDSP_REAL* h;		// coefficients
+	int ringsize;		// number of values the ring buffer holds (allocated twice, mirrored)
+	WDSP_REAL* ring;	// ring buffer
 	int cpp;			// coefficients of the phase
 	int phnum;			// phase number
 } resampleF, *RESAMPLEF;
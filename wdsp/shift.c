@@ -57,14 +57,28 @@ void flush_shift (SHIFT a)
 	a->phase = 0.0;
 }
 
+/*
+ * Returns the NCO rotation for the first sample of the current buffer and
+ * advances the phase by one buffer. The cos/sin recurrence used within the
+ * buffer is thus renormalized once per buffer, and the phase is wrapped once
+ * per buffer instead of once per sample.
+ */
+void start_shift (SHIFT a, double* cos_phase, double* sin_phase)
+{
+	*cos_phase = cos (a->phase);
+	*sin_phase = sin (a->phase);
+	a->phase = fmod (a->phase + (double)a->size * a->delta, TWOPI);
+	if (a->phase < 0.0) a->phase += TWOPI;
+}
+
 void xshift (SHIFT a)
 {
 	if (a->run)
 	{
 		int i;
 		double I1, Q1, t1, t2;
-		double cos_phase = cos (a->phase);
-		double sin_phase = sin (a->phase);
+		double cos_phase, sin_phase;
+		start_shift (a, &cos_phase, &sin_phase);
 		for (i = 0; i < a->size; i++)
 		{
 			I1 = a->in[2 * i + 0];
@@ -75,9 +89,6 @@ void xshift (SHIFT a)
 			t2 = sin_phase;
 			cos_phase = t1 * a->cos_delta - t2 * a->sin_delta;
 			sin_phase = t1 * a->sin_delta + t2 * a->cos_delta;
-			a->phase += a->delta;
-			if (a->phase >= TWOPI) a->phase -= TWOPI;
-			if (a->phase <   0.0 ) a->phase += TWOPI;
 		}
 	}
 	else if (a->in != a->out)
@@ -47,6 +47,8 @@ extern void destroy_shift (SHIFT a);
 
 extern void flush_shift (SHIFT a);
 
+extern void start_shift (SHIFT a, double* cos_phase, double* sin_phase);
+
 extern void xshift (SHIFT a);
 
 extern void setBuffers_shift (SHIFT a, double* in, double* out);
@@ -0,0 +1,149 @@
+/*
+ * test_wdsp_real
+ *
+ * Regression test for "make WDSP_REAL=float". The program runs the blocks
+ * that use WDSP_REAL (the resampler and the ANR LMS filter) on a fixed,
+ * synthetic input. Built against the double library it writes the output
+ * to a reference file, built against the float library it compares its own
+ * output with that file and reports the maximum deviation.
+ *
+ * It is not part of the library. Usage:
+ *
+ *   make clean && make
+ *   gcc -O2 -pthread -o test_wdsp_real test_wdsp_real.c libwdsp.a `pkg-config --cflags --libs fftw3` -lm
+ *   ./test_wdsp_real -w reference.bin
+ *   make clean && make WDSP_REAL=float
+ *   gcc -O2 -pthread -DWDSP_REAL=float -o test_wdsp_real test_wdsp_real.c libwdsp.a `pkg-config --cflags --libs fftw3` -lm
+ *   ./test_wdsp_real -c reference.bin
+ *
+ * The input has a peak amplitude of about 1.0. The float build passes if
+ * the maximum absolute deviation from the double build stays below
+ * MAX_DEV_RESAMPLE (resampler output) and MAX_DEV_ANR (ANR output). The
+ * ANR bound is larger since the rounding errors of the adaptive weights
+ * accumulate over the run.
+ *
+ * return values of main()
+ *
+ *  0  all OK (reference written, or deviations within the bounds)
+ * -1  wrong arguments
+ * -2  error opening or reading the reference file
+ * -3  deviation exceeds the bound
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "comm.h"
+
+#define TEST_BLOCKS      200
+#define TEST_INSIZE      1024       // resampler input block, 192 kHz
+#define TEST_OUTSIZE     256        // resampler output block, 48 kHz
+#define TEST_INRATE      192000
+#define TEST_OUTRATE     48000
+#define MAX_DEV_RESAMPLE 1.0e-5
+#define MAX_DEV_ANR      1.0e-3
+
+static unsigned int seed = 12345;
+
+static double noise() {
+  seed = seed * 1103515245U + 12345U;   // same sequence in both builds
+  return (double)(seed >> 8) / 16777216.0 - 0.5;
+}
+
+int main(int argc, char **argv) {
+  int i, b, n;
+  int write_ref;
+  double *in, *out, *ref;
+  double dev_resample = 0.0, dev_anr = 0.0;
+  double phase1 = 0.0, phase2 = 0.0;
+  FILE *fp;
+  RESAMPLE rs;
+  ANR anr;
+
+  if (argc != 3 || (strcmp(argv[1], "-w") && strcmp(argv[1], "-c"))) {
+    printf("Usage: %s -w|-c reference-file\n", argv[0]);
+    return -1;
+  }
+
+  write_ref = !strcmp(argv[1], "-w");
+  fp = fopen(argv[2], write_ref ? "wb" : "rb");
+
+  if (fp == NULL) {
+    printf("Could not open file '%s'\n", argv[2]);
+    return -2;
+  }
+
+  in = (double *) malloc0(TEST_INSIZE * sizeof(complex));
+  out = (double *) malloc0(2 * TEST_OUTSIZE * sizeof(complex));
+  ref = (double *) malloc0(2 * TEST_OUTSIZE * sizeof(complex));
+  rs = create_resample(1, TEST_INSIZE, in, out, TEST_INRATE, TEST_OUTRATE, 0.0, 0, 1.0);
+  anr = create_anr(1, 0, TEST_OUTSIZE, out, out, ANR_DLINE_SIZE, 64, 16, 0.0001, 0.1,
+                   120.0, 120.0, 200.0, 0.001, 6.25e-10, 1.0, 3.0);
+  printf("WDSP_REAL is %s\n", sizeof(WDSP_REAL) == sizeof(float) ? "float" : "double");
+
+  for (b = 0; b < TEST_BLOCKS; b++) {
+    // two carriers within the 48 kHz pass band, plus noise
+    for (i = 0; i < TEST_INSIZE; i++) {
+      in[2 * i + 0] = 0.5 * cos(phase1) + 0.3 * cos(phase2) + 0.1 * noise();
+      in[2 * i + 1] = 0.5 * sin(phase1) + 0.3 * sin(phase2) + 0.1 * noise();
+      phase1 += TWOPI * 1000.0 / TEST_INRATE;
+      phase2 += TWOPI * -7300.0 / TEST_INRATE;
+    }
+
+    n = xresample(rs);
+
+    if (n != TEST_OUTSIZE) {
+      printf("Resampler produced %d instead of %d samples\n", n, TEST_OUTSIZE);
+      return -3;
+    }
+
+    for (i = 0; i < 2; i++) {
+      // pass 0: resampler output, pass 1: ANR output (in place)
+      if (i == 1) { xanr(anr, 0); }
+
+      if (write_ref) {
+        if (fwrite(out, sizeof(complex), n, fp) != (size_t) n) {
+          printf("Write error\n");
+          return -2;
+        }
+      } else {
+        double *dev = i ? &dev_anr : &dev_resample;
+
+        if (fread(ref, sizeof(complex), n, fp) != (size_t) n) {
+          printf("Read error (reference file too short?)\n");
+          return -2;
+        }
+
+        for (int k = 0; k < 2 * n; k++) {
+          double d = fabs(out[k] - ref[k]);
+
+          if (d > *dev) { *dev = d; }
+        }
+      }
+    }
+  }
+
+  fclose(fp);
+  destroy_anr(anr);
+  destroy_resample(rs);
+  _aligned_free(ref);
+  _aligned_free(out);
+  _aligned_free(in);
+
+  if (write_ref) {
+    printf("Reference written to '%s'\n", argv[2]);
+    return 0;
+  }
+
+  printf("max. deviation resampler: %.3e (bound %.1e)\n", dev_resample, MAX_DEV_RESAMPLE);
+  printf("max. deviation ANR:       %.3e (bound %.1e)\n", dev_anr, MAX_DEV_ANR);
+
+  if (dev_resample > MAX_DEV_RESAMPLE || dev_anr > MAX_DEV_ANR) {
+    printf("FAILED\n");
+    return -3;
+  }
+
+  printf("PASSED\n");
+  return 0;
+}
@@ -513,7 +513,7 @@ double* model_bandpass(int nc, double f_low, double f_high, double rate, int wty
 	double* in = (double*)malloc0(points * sizeof(complex));
 	double* out = (double*)malloc0(points * sizeof(complex));
 	memcpy(in, h, nc * sizeof(complex));
-	fftw_plan p = fftw_plan_dft_1d(points, (fftw_complex*)in, (fftw_complex*)out, FFTW_FORWARD, FFTW_PATIENT);
+	fftw_plan p = fftw_plan_dft_1d(points, (fftw_complex*)in, (fftw_complex*)out, FFTW_FORWARD, FFTW_PLANNER);
 	fftw_execute(p);
 	fftw_destroy_plan(p);
 	double* mag = (double*)malloc0(points * sizeof(double));
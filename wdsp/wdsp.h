@@ -597,6 +597,7 @@ extern void SetTXAPHROTReverse (int channel, int reverse);
 extern int save_impulse_cache(const char* path);
 extern int read_impulse_cache(const char* path);
 extern void use_impulse_cache(int use);
+extern void get_impulse_cache_stats(int* entries, long* hits, long* misses);
 extern void init_impulse_cache(int use);
 extern void destroy_impulse_cache(void);
 
@@ -946,3 +947,5 @@ extern  void SetTXALevelerTop (int channel, double maxgain);
 
 extern char* wisdom_get_status();
 extern int WDSPwisdom (char* directory);
+extern int WDSPwisdom_quick (char* directory, char* shared);
+extern int WDSPwisdom_export (char* file);
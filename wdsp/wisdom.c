@@ -29,91 +29,142 @@ warren@wpratt.com
 
 static char status[128];
 
+// Planner rigor used for all run-time FFTW plans. This is FFTW_PATIENT
+// if PATIENT wisdom is available, and FFTW_MEASURE during a session that
+// only has the quick wisdom of WDSPwisdom_quick().
+int wisdom_planner_flags = FFTW_PATIENT;
+
 PORT
 char* wisdom_get_status()
 {
 	return status;
 }
 
+static void plan_size (int psize, int kind, int sign, unsigned flags, double* fftin, double* fftout)
+{
+	fftw_plan tplan;
+	const char* what = kind ? "REAL    FORWARD " : (sign == FFTW_FORWARD ? "COMPLEX FORWARD " : "COMPLEX BACKWARD");
+	fprintf(stdout, "Planning %s FFT size %d\n", what, psize);
+	fflush(stdout);
+	sprintf(status, "Planning %s FFT size %d\n", what, psize);
+	if (kind)
+		tplan = fftw_plan_dft_r2c_1d(psize, fftin, (fftw_complex *)fftout, flags);
+	else
+		tplan = fftw_plan_dft_1d(psize, (fftw_complex *)fftin, (fftw_complex *)fftout, sign, flags);
+	fftw_execute (tplan);
+	fftw_destroy_plan (tplan);
+}
+
+// plan all sizes used by the filters up to maxfilter, and by the displays up to maxdisplay
+static void plan_sizes (int maxfilter, int maxdisplay, unsigned flags)
+{
+	int psize;
+	const int maxsize = max (maxdisplay, maxfilter + 1);
+	double* fftin =  (double *) malloc0 (maxsize * sizeof (complex));
+	double* fftout = (double *) malloc0 (maxsize * sizeof (complex));
+	fprintf(stdout, "Optimizing FFT sizes through %d\n\n", maxsize);
+	fprintf(stdout, "Please do not close this window until wisdom plans are completed.\n\n");
+	sprintf(status, "Optimizing FFT sizes through %d", maxsize);
+	psize = 64;
+	while (psize <= maxfilter)
+	{
+		plan_size (psize,     0, FFTW_FORWARD,  flags, fftin, fftout);
+		plan_size (psize,     0, FFTW_BACKWARD, flags, fftin, fftout);
+		plan_size (psize + 1, 0, FFTW_BACKWARD, flags, fftin, fftout);
+		psize *= 2;
+	}
+	psize = 64;
+	while (psize <= maxdisplay)
+	{
+		if (psize > maxfilter)
+			plan_size (psize, 0, FFTW_FORWARD, flags, fftin, fftout);
+		plan_size (psize, 1, FFTW_FORWARD, flags, fftin, fftout);
+		psize *= 2;
+	}
+	fprintf(stdout, "\nFFTW planning complete.\n");
+	fflush(stdout);
+	sprintf(status, "\nFFTW planning complete.\n");
+	_aligned_free (fftout);
+	_aligned_free (fftin);
+}
+
+// Export the accumulated wisdom. The file is written under a temporary
+// name and then renamed, such that a concurrent reader never sees a
+// partially written file. Returns 1 on success.
+PORT
+int WDSPwisdom_export (char* file)
+{
+	char tmp_file[1040];
+	snprintf (tmp_file, sizeof (tmp_file), "%s.tmp", file);
+	if (!fftw_export_wisdom_to_filename(tmp_file))
+	{
+		remove (tmp_file);
+		return 0;
+	}
+#ifdef _WIN32
+	remove (file);
+#endif
+	if (rename (tmp_file, file))
+	{
+		remove (tmp_file);
+		return 0;
+	}
+	return 1;
+}
+
 PORT
 int WDSPwisdom (char* directory)
 {
 	int wisdom_return = 0; // 0 from existing, 1 rebuilt
-	fftw_plan tplan;
-	int psize;
 #ifdef _WIN32
 	FILE *stream;
 #endif
-	double* fftin;
-	double* fftout;
 	char wisdom_file[1024];
-	const int maxsize = max (MAX_WISDOM_SIZE_DISPLAY, MAX_WISDOM_SIZE_FILTER + 1);
 	strcpy (wisdom_file, directory);
 	strncat (wisdom_file, "wdspWisdom00", 16);
 	if(!fftw_import_wisdom_from_filename(wisdom_file))
 	{
-		fftin =  (double *) malloc0 (maxsize * sizeof (complex));
-		fftout = (double *) malloc0 (maxsize * sizeof (complex));
 #ifdef _WIN32
 		AllocConsole();								// create console
 	    freopen_s(&stream, "conout$", "w", stdout); // redirect output to console
 #endif
-		fprintf(stdout, "Optimizing FFT sizes through %d\n\n", maxsize);
-		fprintf(stdout, "Please do not close this window until wisdom plans are completed.\n\n");
-		sprintf(status, "Optimizing FFT sizes through %d", maxsize);
-		psize = 64;
-		while (psize <= MAX_WISDOM_SIZE_FILTER)
-		{
-			fprintf(stdout, "Planning COMPLEX FORWARD  FFT size %d\n", psize);
-			fflush(stdout);
-			sprintf(status, "Planning COMPLEX FORWARD  FFT size %d\n", psize);
-			tplan = fftw_plan_dft_1d(psize, (fftw_complex *)fftin, (fftw_complex *)fftout, FFTW_FORWARD, FFTW_PATIENT);
-			fftw_execute (tplan);
-			fftw_destroy_plan (tplan);
-			fprintf(stdout, "Planning COMPLEX BACKWARD FFT size %d\n", psize);
-			fflush(stdout);
-			sprintf(status, "Planning COMPLEX BACKWARD FFT size %d\n", psize);
-			tplan = fftw_plan_dft_1d(psize, (fftw_complex *)fftin, (fftw_complex *)fftout, FFTW_BACKWARD, FFTW_PATIENT);
-			fftw_execute (tplan);
-			fftw_destroy_plan (tplan);
-			fprintf(stdout, "Planning COMPLEX BACKWARD FFT size %d\n", psize + 1);
-			fflush(stdout);
-			sprintf(status, "Planning COMPLEX BACKWARD FFT size %d\n", psize + 1);
-			tplan = fftw_plan_dft_1d(psize + 1, (fftw_complex *)fftin, (fftw_complex *)fftout, FFTW_BACKWARD, FFTW_PATIENT);
-			fftw_execute (tplan);
-			fftw_destroy_plan (tplan);
-			psize *= 2;
-		}
-		psize = 64;
-		while (psize <= MAX_WISDOM_SIZE_DISPLAY)
-		{
-			if (psize > MAX_WISDOM_SIZE_FILTER)
-			{
-				fprintf(stdout, "Planning COMPLEX FORWARD  FFT size %d\n", psize);
-				fflush(stdout);
-				sprintf(status, "Planning COMPLEX FORWARD  FFT size %d\n", psize);
-				tplan = fftw_plan_dft_1d(psize, (fftw_complex *)fftin, (fftw_complex *)fftout, FFTW_FORWARD, FFTW_PATIENT);
-				fftw_execute (tplan);
-				fftw_destroy_plan (tplan);
-			}
-			fprintf(stdout, "Planning REAL    FORWARD  FFT size %d\n", psize);
-			fflush(stdout);
-			sprintf(status, "Planning REAL    FORWARD  FFT size %d\n", psize);
-			tplan = fftw_plan_dft_r2c_1d(psize, fftin, (fftw_complex *)fftout, FFTW_PATIENT);
-			fftw_execute (tplan);
-			fftw_destroy_plan (tplan);
-			psize *= 2;
-		}
-		fprintf(stdout, "\nFFTW planning complete.\n");
-		fflush(stdout);
-		sprintf(status, "\nFFTW planning complete.\n");
-		fftw_export_wisdom_to_filename(wisdom_file);
-		_aligned_free (fftout);
-		_aligned_free (fftin);
+		plan_sizes (MAX_WISDOM_SIZE_FILTER, MAX_WISDOM_SIZE_DISPLAY, FFTW_PATIENT);
+		WDSPwisdom_export (wisdom_file);
 #ifdef _WIN32
 		FreeConsole();							// dismiss console
 #endif
 		wisdom_return = 1;
 	}
+	wisdom_planner_flags = FFTW_PATIENT;
 	return wisdom_return;
 }
+
+// Tiered start-up wisdom:
+//   1. the PATIENT wisdom file in directory,
+//   2. a PATIENT wisdom file for this CPU model in a shared location
+//      (copied to directory when found),
+//   3. a quick FFTW_MEASURE pass over the commonly used sizes. The
+//      remaining sizes are measured when they are first planned.
+// Returns 0 if PATIENT wisdom is in place, and 1 if only the quick pass
+// has been done. In the latter case, the caller should arrange for
+// WDSPwisdom() to build the PATIENT wisdom file, e.g. in a background
+// process, to be used from the next start on.
+PORT
+int WDSPwisdom_quick (char* directory, char* shared)
+{
+	char wisdom_file[1024];
+	strcpy (wisdom_file, directory);
+	strncat (wisdom_file, "wdspWisdom00", 16);
+	wisdom_planner_flags = FFTW_PATIENT;
+	if (fftw_import_wisdom_from_filename(wisdom_file))
+		return 0;
+	if (shared && fftw_import_wisdom_from_filename(shared))
+	{
+		fprintf(stdout, "Imported FFTW wisdom from %s\n", shared);
+		WDSPwisdom_export (wisdom_file);
+		return 0;
+	}
+	plan_sizes (MAX_WISDOM_SIZE_QUICK, MAX_WISDOM_SIZE_QUICK, FFTW_MEASURE);
+	wisdom_planner_flags = FFTW_MEASURE;
+	return 1;
+}